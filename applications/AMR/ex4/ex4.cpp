@@ -31,6 +31,7 @@
 
 
 #include "MeshRefinement.hpp"
+#include <sstream>
 
 
 using namespace femus;
@@ -89,6 +90,10 @@ int main(int argc, char** args) {
   // erase all the coarse mesh levels
   //mlMsh.EraseCoarseLevels(numberOfUniformLevels - 3);
 
+  // the AMR levels inherit the partition of their coarse fathers, rebalanced only above 20% imbalance
+  mlMsh.SetAMRSkipRepartition(true);
+  mlMsh.SetAMRImbalanceThreshold(1.2);
+
   // print mesh info
   mlMsh.PrintInfo();
 
@@ -141,6 +146,11 @@ int main(int argc, char** args) {
 
     system.SetNumberOfSchurVariables(1);
     system.SetElementBlockNumber(4);
+
+    // timings of the solver phases and of the vtk output for this mesh
+    std::ostringstream profilerOutput;
+    profilerOutput << DEFAULT_OUTPUTDIR << "profile_mesh" << i;
+    system.SetProfilerOutput(profilerOutput.str());
    
     system.MGsolve();
     
@@ -151,7 +161,9 @@ int main(int argc, char** args) {
     variablesToBePrinted.push_back("All");
     VTKWriter vtkIO(&mlSol);
     vtkIO.SetDebugOutput(true);
+    vtkIO.SetProfiler(&system.GetProfiler());
     vtkIO.Write(DEFAULT_OUTPUTDIR, "biquadratic", variablesToBePrinted);
+    system.WriteProfilerOutput();
 
     //refine the mesh
     MeshRefinement meshcoarser(*mlMsh.GetLevel(numberOfUniformLevels-1));
@@ -6,6 +6,7 @@
 #include "Parameter.hpp"
 #include "FemusInit.hpp"
 #include "SparseMatrix.hpp"
+#include "AssemblyBuffer.hpp"
 #include "VTKWriter.hpp"
 #include "GMVWriter.hpp"
 #include "NonLinearImplicitSystem.hpp"
@@ -385,8 +386,6 @@ static unsigned counter=0;
 
 void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 
-    adept::Stack & adeptStack = FemusInit::_adeptStack;
-
     clock_t AssemblyTime=0;
     clock_t start_time, end_time;
 
@@ -408,6 +407,79 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
     const unsigned nabla_dim = 3*(dim-1);
     const unsigned max_size = static_cast< unsigned > (ceil(pow(3,dim)));
 
+    // ------------------------------------------------------------------------
+    // Physical parameters
+    double rhof	 	= ml_prob.parameters.get<Fluid>("Fluid").get_density();
+    double IRe 		= ml_prob.parameters.get<Fluid>("Fluid").get_IReynolds_number();
+    double betans	= 1.;
+
+    // gravity
+    double _gravity[3]={0.,0.,0.};
+
+    double DRe = 1+(counter*counter)*5;
+    //double DRe=150;
+    IRe =( DRe*(counter+1) < 10000 )? 1./(DRe*(counter+1)):1./10000.;
+
+
+    cout<<"iteration="<<counter<<" Reynolds Number = "<<1./IRe<<endl;
+    counter++;
+    // -----------------------------------------------------------------
+    // space discretization parameters
+    unsigned SolType2 = ml_sol->GetSolutionType(ml_sol->GetIndex("U"));
+
+    unsigned SolType1 = ml_sol->GetSolutionType(ml_sol->GetIndex("P"));
+
+    unsigned SolTypeVx = 2;
+
+    // mesh and procs
+    unsigned nel    = mymsh->GetNumberOfElements();
+    unsigned igrid  = mymsh->GetLevel();
+    unsigned iproc  = mymsh->processor_id();
+
+    //----------------------------------------------------------------------------------
+    //variable-name handling
+    const char varname[4][3] = {"U","V","W","P"};
+    vector <unsigned> indexVAR(dim+1);
+    vector <unsigned> indVAR(dim+1);
+    vector <unsigned> SolType(dim+1);
+
+    for(unsigned ivar=0; ivar<dim; ivar++) {
+      indVAR[ivar]=ml_sol->GetIndex(&varname[ivar][0]);
+      SolType[ivar]=ml_sol->GetSolutionType(&varname[ivar][0]);
+      indexVAR[ivar]=my_nnlin_impl_sys.GetSolPdeIndex(&varname[ivar][0]);
+    }
+    indVAR[dim]=ml_sol->GetIndex(&varname[3][0]);
+    SolType[dim]=ml_sol->GetSolutionType(&varname[3][0]);
+    indexVAR[dim]=my_nnlin_impl_sys.GetSolPdeIndex(&varname[3][0]);
+
+    unsigned indLmbd=ml_sol->GetIndex("lmbd");
+
+    // read-only views on the local solution and coordinate arrays, shared by the threads below
+    vector < NumericVectorLocalView > vxView(dim);
+    vector < NumericVectorLocalView > solView(dim+1);
+    for(int i=0;i<dim;i++){
+      vxView[i] = mymsh->_topology->_Sol[i]->GetLocalView();
+    }
+    for(int i=0;i<dim+1;i++){
+      solView[i] = mysolution->_Sol[indVAR[i]]->GetLocalView();
+    }
+    NumericVectorLocalView lmbdView = mysolution->_Sol[indLmbd]->GetLocalView();
+
+    //----------------------------------------------------------------------------------
+
+    start_time=clock();
+
+    myKK->zero();
+
+    // hybrid MPI+threads assembly: each thread owns its local objects, its adept stack and its staging buffer
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+
+    // call the adept stack object of this thread
+    adept::Stack & adeptStack = FemusInit::GetAdeptStack();
+
     // local objects
     vector<adept::adouble> SolVAR(dim+1);
     vector<vector<adept::adouble> > GradSolVAR(dim+1);
@@ -467,60 +539,12 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
     vector < double > Jac;
     Jac.reserve(dim*max_size*(dim+1)*dim*max_size*(dim+1));
 
-    // ------------------------------------------------------------------------
-    // Physical parameters
-    double rhof	 	= ml_prob.parameters.get<Fluid>("Fluid").get_density();
-    double IRe 		= ml_prob.parameters.get<Fluid>("Fluid").get_IReynolds_number();
-    double betans	= 1.;
-
-    // gravity
-    double _gravity[3]={0.,0.,0.};
-
-    double DRe = 1+(counter*counter)*5;
-    //double DRe=150;
-    IRe =( DRe*(counter+1) < 10000 )? 1./(DRe*(counter+1)):1./10000.;
-
-
-    cout<<"iteration="<<counter<<" Reynolds Number = "<<1./IRe<<endl;
-    counter++;
-    // -----------------------------------------------------------------
-    // space discretization parameters
-    unsigned SolType2 = ml_sol->GetSolutionType(ml_sol->GetIndex("U"));
-
-    unsigned SolType1 = ml_sol->GetSolutionType(ml_sol->GetIndex("P"));
-
-    unsigned SolTypeVx = 2;
-
-    // mesh and procs
-    unsigned nel    = mymsh->GetNumberOfElements();
-    unsigned igrid  = mymsh->GetLevel();
-    unsigned iproc  = mymsh->processor_id();
-
-    //----------------------------------------------------------------------------------
-    //variable-name handling
-    const char varname[4][3] = {"U","V","W","P"};
-    vector <unsigned> indexVAR(dim+1);
-    vector <unsigned> indVAR(dim+1);
-    vector <unsigned> SolType(dim+1);
-
-    for(unsigned ivar=0; ivar<dim; ivar++) {
-      indVAR[ivar]=ml_sol->GetIndex(&varname[ivar][0]);
-      SolType[ivar]=ml_sol->GetSolutionType(&varname[ivar][0]);
-      indexVAR[ivar]=my_nnlin_impl_sys.GetSolPdeIndex(&varname[ivar][0]);
-    }
-    indVAR[dim]=ml_sol->GetIndex(&varname[3][0]);
-    SolType[dim]=ml_sol->GetSolutionType(&varname[3][0]);
-    indexVAR[dim]=my_nnlin_impl_sys.GetSolPdeIndex(&varname[3][0]);
-
-    unsigned indLmbd=ml_sol->GetIndex("lmbd");
-
-    //----------------------------------------------------------------------------------
-
-    start_time=clock();
-
-    myKK->zero();
+    AssemblyBuffer buffer(myKK, myRES); // element blocks of this thread, added to KK and RES in a critical section
 
     // *** element loop ***
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 16)
+#endif
     for(int iel=mymsh->_elementOffset[iproc]; iel < mymsh->_elementOffset[iproc+1]; iel++) {
 
       unsigned kel        = iel;
@@ -558,7 +582,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 	unsigned inode_Metis=mymsh->GetSolutionDof(i, iel, SolTypeVx);
 	for(int j=0; j<dim; j++) {
 	  //coordinates
-	  vx[j][i]=  (*mymsh->_topology->_Sol[j])(inode_Metis);
+	  vx[j][i]=  vxView[j](inode_Metis);
 	}
       }
 
@@ -567,7 +591,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 	unsigned inode_Metis=mymsh->GetSolutionDof(i,iel,SolType2);
 	for(int j=0; j<dim; j++) {
 	  // velocity dofs
-	  Soli[indexVAR[j]][i] =  (*mysolution->_Sol[indVAR[j]])(inode_Metis);
+	  Soli[indexVAR[j]][i] =  solView[j](inode_Metis);
 	  dofsVAR[j][i] = myLinEqSolver->GetSystemDof(indVAR[j],indexVAR[j],i, iel);
 	  aRhs[indexVAR[j]][i] = 0.;
 	}
@@ -576,7 +600,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
       // Pressure dofs
       for (unsigned i=0;i<nve1;i++) {
 	unsigned inode_Metis =mymsh->GetSolutionDof(i,iel,SolType1);
-	Soli[indexVAR[dim]][i] = (*mysolution->_Sol[indVAR[dim]])(inode_Metis);
+	Soli[indexVAR[dim]][i] = solView[dim](inode_Metis);
 	dofsVAR[dim][i]=myLinEqSolver->GetSystemDof(indVAR[dim],indexVAR[dim],i, iel);
 	aRhs[indexVAR[dim]][i] = 0.;
       }
@@ -790,7 +814,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 
 	    adept::adouble deltaSupg=0.;
 
-	    double sqrtlambdak = (*mysolution->_Sol[indLmbd])(iel);
+	    double sqrtlambdak = lmbdView(iel);
 	    adept::adouble tauSupg=1. / ( sqrtlambdak*sqrtlambdak *4.*IRe);
 	    adept::adouble Rek   = aL2Norm / ( 4.*sqrtlambdak*IRe);
 
@@ -888,7 +912,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 	Rhs[indexVAR[dim]][j] = aRhs[indexVAR[dim]][j].value();
       }
       for(int i=0; i<dim+1; i++) {
-	myRES->add_vector_blocked(Rhs[indexVAR[i]],dofsVAR[i]);
+	buffer.AddVector(Rhs[indexVAR[i]],dofsVAR[i]);
       }
 
       //Store equations
@@ -905,7 +929,7 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 	   KKloc[inode*nveAll+jnode]=-Jac[jnode*nveAll+inode];
 	}
       }
-      myKK->add_matrix_blocked(KKloc,dofsAll,dofsAll);
+      buffer.AddMatrix(KKloc,dofsAll,dofsAll);
       adeptStack.clear_independents();
       adeptStack.clear_dependents();
 
@@ -913,6 +937,8 @@ void AssembleMatrixResNS(MultiLevelProblem &ml_prob){
 
     } //end list of elements loop
 
+    } //end parallel region
+
     myKK->close();
     myRES->close();
 
@@ -18,6 +18,7 @@
 #include "VTKWriter.hpp"
 #include "GMVWriter.hpp"
 #include "NonLinearImplicitSystem.hpp"
+#include "AssemblyBuffer.hpp"
 #include "adept.h"
 
 
@@ -132,9 +133,6 @@ void AssembleBoussinesqAppoximation_AD(MultiLevelProblem& ml_prob) {
   //  levelMax is the Maximum level of the MultiLevelProblem
   //  assembleMatrix is a flag that tells if only the residual or also the matrix should be assembled
 
-  // call the adept stack object
-  adept::Stack& s = FemusInit::_adeptStack;
-
   //  extract pointers to the several objects that we are going to use
   NonLinearImplicitSystem* mlPdeSys   = &ml_prob.get_system<NonLinearImplicitSystem> ("NS");   // pointer to the linear implicit system named "Poisson"
   const unsigned level = mlPdeSys->GetLevelToAssemble();
@@ -179,210 +177,241 @@ void AssembleBoussinesqAppoximation_AD(MultiLevelProblem& ml_prob) {
   unsigned solPPdeIndex;
   solPPdeIndex = mlPdeSys->GetSolPdeIndex("P");    // get the position of "P" in the pdeSys object
 
-  vector < vector < adept::adouble > >  solV(dim);    // local solution
-  vector < adept::adouble >  solP; // local solution
-
-  vector< vector < adept::adouble > > aResV(dim);    // local redidual vector
-  vector< adept::adouble > aResP; // local redidual vector
+  KK->zero(); // Set to zero all the entries of the Global Matrix
 
-  vector < vector < double > > coordX(dim);    // local coordinates
-  unsigned coordXType = 2; // get the finite element type for "x", it is always 2 (LAGRANGE QUADRATIC)
+  // read-only views on the local solution and coordinate arrays, shared by the threads below
+  vector < NumericVectorLocalView > solVView(dim);
+  vector < NumericVectorLocalView > coordXView(dim);
 
   for (unsigned  k = 0; k < dim; k++) {
-    solV[k].reserve(maxSize);
-    aResV[k].reserve(maxSize);
-    coordX[k].reserve(maxSize);
+    solVView[k] = sol->_Sol[solVIndex[k]]->GetLocalView();
+    coordXView[k] = msh->_topology->_Sol[k]->GetLocalView();
   }
 
-  solP.reserve(maxSize);
-  aResP.reserve(maxSize);
+  NumericVectorLocalView solPView = sol->_Sol[solPIndex]->GetLocalView();
 
+  // hybrid MPI+threads assembly: each thread owns its local arrays, its adept stack and its staging buffer
+#ifdef _OPENMP
+  #pragma omp parallel
+#endif
+  {
+    // call the adept stack object of this thread
+    adept::Stack& s = FemusInit::GetAdeptStack();
 
-  vector <double> phiV;  // local test function
-  vector <double> phiV_x; // local test function first order partial derivatives
-  vector <double> phiV_xx; // local test function second order partial derivatives
+    vector < vector < adept::adouble > >  solV(dim);    // local solution
+    vector < adept::adouble >  solP; // local solution
 
-  phiV.reserve(maxSize);
-  phiV_x.reserve(maxSize * dim);
-  phiV_xx.reserve(maxSize * dim2);
+    vector< vector < adept::adouble > > aResV(dim);    // local redidual vector
+    vector< adept::adouble > aResP; // local redidual vector
 
-  double* phiP;
-  double weight; // gauss point weight
+    vector < vector < double > > coordX(dim);    // local coordinates
+    vector < unsigned > coordXDof;    // local to global coordinate dofs
+    coordXDof.reserve(maxSize);
+    unsigned coordXType = 2; // get the finite element type for "x", it is always 2 (LAGRANGE QUADRATIC)
 
-  vector< int > sysDof; // local to global pdeSys dofs
-  sysDof.reserve((dim + 1) *maxSize);
+    for (unsigned  k = 0; k < dim; k++) {
+      solV[k].reserve(maxSize);
+      aResV[k].reserve(maxSize);
+      coordX[k].reserve(maxSize);
+    }
 
-  vector< double > Res; // local redidual vector
-  Res.reserve((dim + 1) *maxSize);
+    solP.reserve(maxSize);
+    aResP.reserve(maxSize);
 
-  vector < double > Jac;
-  Jac.reserve((dim + 1) *maxSize * (dim + 1) *maxSize);
 
-  KK->zero(); // Set to zero all the entries of the Global Matrix
+    vector <double> phiV;  // local test function
+    vector <double> phiV_x; // local test function first order partial derivatives
+    vector <double> phiV_xx; // local test function second order partial derivatives
 
-  // element loop: each process loops only on the elements that owns
-  for (int iel = msh->_elementOffset[iproc]; iel < msh->_elementOffset[iproc + 1]; iel++) {
+    phiV.reserve(maxSize);
+    phiV_x.reserve(maxSize * dim);
+    phiV_xx.reserve(maxSize * dim2);
 
-    short unsigned ielGeom = msh->GetElementType(iel);
+    double* phiP;
+    double weight; // gauss point weight
 
-    unsigned nDofsV = msh->GetElementDofNumber(iel, solVType);    // number of solution element dofs
-    unsigned nDofsP = msh->GetElementDofNumber(iel, solPType);    // number of solution element dofs
-    unsigned nDofsX = msh->GetElementDofNumber(iel, coordXType);    // number of coordinate element dofs
-    
-    unsigned nDofsVP = dim * nDofsV + nDofsP;
-    // resize local arrays
-    sysDof.resize(nDofsVP);
+    vector< int > sysDof; // local to global pdeSys dofs
+    sysDof.reserve((dim + 1) *maxSize);
 
-    for (unsigned  k = 0; k < dim; k++) {
-      solV[k].resize(nDofsV);
-      coordX[k].resize(nDofsX);
-    }
+    vector< double > Res; // local redidual vector
+    Res.reserve((dim + 1) *maxSize);
 
-    solP.resize(nDofsP);
+    vector < double > Jac;
+    Jac.reserve((dim + 1) *maxSize * (dim + 1) *maxSize);
 
-    for (unsigned  k = 0; k < dim; k++) {
-      aResV[k].resize(nDofsV);    //resize
-      std::fill(aResV[k].begin(), aResV[k].end(), 0);    //set aRes to zero
-    }
+    AssemblyBuffer buffer(KK, RES); // element blocks of this thread, added to KK and RES in a critical section
 
-    aResP.resize(nDofsP);    //resize
-    std::fill(aResP.begin(), aResP.end(), 0);    //set aRes to zero
+    // element loop: each process loops only on the elements that owns, shared among its threads
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 16)
+#endif
+    for (int iel = msh->_elementOffset[iproc]; iel < msh->_elementOffset[iproc + 1]; iel++) {
 
-    // local storage of global mapping and solution
-    for (unsigned i = 0; i < nDofsV; i++) {
-      unsigned solVDof = msh->GetSolutionDof(i, iel, solVType);    // global to global mapping between solution node and solution dof
+      short unsigned ielGeom = msh->GetElementType(iel);
+
+      unsigned nDofsV = msh->GetElementDofNumber(iel, solVType);    // number of solution element dofs
+      unsigned nDofsP = msh->GetElementDofNumber(iel, solPType);    // number of solution element dofs
+      unsigned nDofsX = msh->GetElementDofNumber(iel, coordXType);    // number of coordinate element dofs
+    
+      unsigned nDofsVP = dim * nDofsV + nDofsP;
+      // resize local arrays
+      sysDof.resize(nDofsVP);
 
       for (unsigned  k = 0; k < dim; k++) {
-        solV[k][i] = (*sol->_Sol[solVIndex[k]])(solVDof);      // global extraction and local storage for the solution
-        sysDof[i + k * nDofsV] = pdeSys->GetSystemDof(solVIndex[k], solVPdeIndex[k], i, iel);    // global to global mapping between solution node and pdeSys dof
+        solV[k].resize(nDofsV);
+        coordX[k].resize(nDofsX);
       }
-    }
 
-    for (unsigned i = 0; i < nDofsP; i++) {
-      unsigned solPDof = msh->GetSolutionDof(i, iel, solPType);    // global to global mapping between solution node and solution dof
-      solP[i] = (*sol->_Sol[solPIndex])(solPDof);      // global extraction and local storage for the solution
-      sysDof[i + dim * nDofsV] = pdeSys->GetSystemDof(solPIndex, solPPdeIndex, i, iel);    // global to global mapping between solution node and pdeSys dof
-    }
+      solP.resize(nDofsP);
 
-    // local storage of coordinates
-    for (unsigned i = 0; i < nDofsX; i++) {
-      unsigned coordXDof  = msh->GetSolutionDof(i, iel, coordXType);    // global to global mapping between coordinates node and coordinate dof
+      for (unsigned  k = 0; k < dim; k++) {
+        aResV[k].resize(nDofsV);    //resize
+        std::fill(aResV[k].begin(), aResV[k].end(), 0);    //set aRes to zero
+      }
 
-      for (unsigned k = 0; k < dim; k++) {
-        coordX[k][i] = (*msh->_topology->_Sol[k])(coordXDof);      // global extraction and local storage for the element coordinates
+      aResP.resize(nDofsP);    //resize
+      std::fill(aResP.begin(), aResP.end(), 0);    //set aRes to zero
+
+      // local storage of global mapping and solution
+      for (unsigned i = 0; i < nDofsV; i++) {
+        unsigned solVDof = msh->GetSolutionDof(i, iel, solVType);    // global to global mapping between solution node and solution dof
+
+        for (unsigned  k = 0; k < dim; k++) {
+          solV[k][i] = solVView[k](solVDof);      // global extraction and local storage for the solution
+          sysDof[i + k * nDofsV] = pdeSys->GetSystemDof(solVIndex[k], solVPdeIndex[k], i, iel);    // global to global mapping between solution node and pdeSys dof
+        }
       }
-    }
 
-    // start a new recording of all the operations involving adept::adouble variables
-    s.new_recording();
+      for (unsigned i = 0; i < nDofsP; i++) {
+        unsigned solPDof = msh->GetSolutionDof(i, iel, solPType);    // global to global mapping between solution node and solution dof
+        solP[i] = solPView(solPDof);      // global extraction and local storage for the solution
+        sysDof[i + dim * nDofsV] = pdeSys->GetSystemDof(solPIndex, solPPdeIndex, i, iel);    // global to global mapping between solution node and pdeSys dof
+      }
 
-    // *** Gauss point loop ***
-    for (unsigned ig = 0; ig < msh->_finiteElement[ielGeom][solVType]->GetGaussPointNumber(); ig++) {
-      // *** get gauss point weight, test function and test function partial derivatives ***
-      msh->_finiteElement[ielGeom][solVType]->Jacobian(coordX, ig, weight, phiV, phiV_x, phiV_xx);
-      phiP = msh->_finiteElement[ielGeom][solPType]->GetPhi(ig);
+      // local storage of coordinates
+      coordXDof.resize(nDofsX);
 
-      vector < adept::adouble > solV_gss(dim, 0);
-      vector < vector < adept::adouble > > gradSolV_gss(dim);
+      for (unsigned i = 0; i < nDofsX; i++) {
+        coordXDof[i]  = msh->GetSolutionDof(i, iel, coordXType);    // global to global mapping between coordinates node and coordinate dof
+      }
 
-      for (unsigned  k = 0; k < dim; k++) {
-        gradSolV_gss[k].resize(dim);
-        std::fill(gradSolV_gss[k].begin(), gradSolV_gss[k].end(), 0);
+      for (unsigned k = 0; k < dim; k++) {
+        coordXView[k].GetValues(&coordXDof[0], nDofsX, &coordX[k][0]);      // global extraction and local storage for the element coordinates
       }
 
-      for (unsigned i = 0; i < nDofsV; i++) {
+      // start a new recording of all the operations involving adept::adouble variables
+      s.new_recording();
+
+      // *** Gauss point loop ***
+      for (unsigned ig = 0; ig < msh->_finiteElement[ielGeom][solVType]->GetGaussPointNumber(); ig++) {
+        // *** get gauss point weight, test function and test function partial derivatives ***
+        msh->_finiteElement[ielGeom][solVType]->Jacobian(coordX, ig, weight, phiV, phiV_x, phiV_xx);
+        phiP = msh->_finiteElement[ielGeom][solPType]->GetPhi(ig);
+
+        vector < adept::adouble > solV_gss(dim, 0);
+        vector < vector < adept::adouble > > gradSolV_gss(dim);
+
         for (unsigned  k = 0; k < dim; k++) {
-          solV_gss[k] += phiV[i] * solV[k][i];
+          gradSolV_gss[k].resize(dim);
+          std::fill(gradSolV_gss[k].begin(), gradSolV_gss[k].end(), 0);
         }
 
-        for (unsigned j = 0; j < dim; j++) {
+        for (unsigned i = 0; i < nDofsV; i++) {
           for (unsigned  k = 0; k < dim; k++) {
-            gradSolV_gss[k][j] += phiV_x[i * dim + j] * solV[k][i];
+            solV_gss[k] += phiV[i] * solV[k][i];
+          }
+
+          for (unsigned j = 0; j < dim; j++) {
+            for (unsigned  k = 0; k < dim; k++) {
+              gradSolV_gss[k][j] += phiV_x[i * dim + j] * solV[k][i];
+            }
           }
         }
-      }
 
-      adept::adouble solP_gss = 0;
+        adept::adouble solP_gss = 0;
 
-      for (unsigned i = 0; i < nDofsP; i++) {
-        solP_gss += phiP[i] * solP[i];
-      }
+        for (unsigned i = 0; i < nDofsP; i++) {
+          solP_gss += phiP[i] * solP[i];
+        }
 
-      double nu = 1.;
+        double nu = 1.;
 
-      // *** phiV_i loop ***
-      for (unsigned i = 0; i < nDofsV; i++) {
-        vector < adept::adouble > NSV(dim, 0.);
+        // *** phiV_i loop ***
+        for (unsigned i = 0; i < nDofsV; i++) {
+          vector < adept::adouble > NSV(dim, 0.);
+
+          for (unsigned j = 0; j < dim; j++) {
+            for (unsigned  k = 0; k < dim; k++) {
+              NSV[k]   +=  nu * phiV_x[i * dim + j] * (gradSolV_gss[k][j] + gradSolV_gss[j][k]);
+              NSV[k]   +=  phiV[i] * (solV_gss[j] * gradSolV_gss[k][j]);
+            }
+          }
 
-        for (unsigned j = 0; j < dim; j++) {
           for (unsigned  k = 0; k < dim; k++) {
-            NSV[k]   +=  nu * phiV_x[i * dim + j] * (gradSolV_gss[k][j] + gradSolV_gss[j][k]);
-            NSV[k]   +=  phiV[i] * (solV_gss[j] * gradSolV_gss[k][j]);
+            NSV[k] += -solP_gss * phiV_x[i * dim + k];
           }
-        }
 
-        for (unsigned  k = 0; k < dim; k++) {
-          NSV[k] += -solP_gss * phiV_x[i * dim + k];
-        }
+          for (unsigned  k = 0; k < dim; k++) {
+            aResV[k][i] += - NSV[k] * weight;
+          }
+        } // end phiV_i loop
 
-        for (unsigned  k = 0; k < dim; k++) {
-          aResV[k][i] += - NSV[k] * weight;
-        }
-      } // end phiV_i loop
+        // *** phiP_i loop ***
+        for (unsigned i = 0; i < nDofsP; i++) {
+          for (int k = 0; k < dim; k++) {
+            aResP[i] += - (gradSolV_gss[k][k]) * phiP[i]  * weight;
+          }
+        } // end phiP_i loop
 
-      // *** phiP_i loop ***
-      for (unsigned i = 0; i < nDofsP; i++) {
-        for (int k = 0; k < dim; k++) {
-          aResP[i] += - (gradSolV_gss[k][k]) * phiP[i]  * weight;
-        }
-      } // end phiP_i loop
+      } // end gauss point loop
 
-    } // end gauss point loop
+      //--------------------------------------------------------------------------------------------------------
+      // Add the local Matrix/Vector into the global Matrix/Vector
 
-    //--------------------------------------------------------------------------------------------------------
-    // Add the local Matrix/Vector into the global Matrix/Vector
+      //copy the value of the adept::adoube aRes in double Res and store them in RES
+      Res.resize(nDofsVP);    //resize
 
-    //copy the value of the adept::adoube aRes in double Res and store them in RES
-    Res.resize(nDofsVP);    //resize
+      for (int i = 0; i < nDofsV; i++) {
+        for (unsigned  k = 0; k < dim; k++) {
+          Res[ i +  k * nDofsV ] = -aResV[k][i].value();
+        }
+      }
 
-    for (int i = 0; i < nDofsV; i++) {
-      for (unsigned  k = 0; k < dim; k++) {
-        Res[ i +  k * nDofsV ] = -aResV[k][i].value();
+      for (int i = 0; i < nDofsP; i++) {
+        Res[ i + dim * nDofsV ] = -aResP[i].value();
       }
-    }
 
-    for (int i = 0; i < nDofsP; i++) {
-      Res[ i + dim * nDofsV ] = -aResP[i].value();
-    }
+      buffer.AddVector(Res, sysDof);
 
-    RES->add_vector_blocked(Res, sysDof);
+      //Extarct and store the Jacobian
 
-    //Extarct and store the Jacobian
+      Jac.resize(nDofsVP * nDofsVP);
+      // define the dependent variables
 
-    Jac.resize(nDofsVP * nDofsVP);
-    // define the dependent variables
+      for (unsigned  k = 0; k < dim; k++) {
+        s.dependent(&aResV[k][0], nDofsV);
+      }
 
-    for (unsigned  k = 0; k < dim; k++) {
-      s.dependent(&aResV[k][0], nDofsV);
-    }
+      s.dependent(&aResP[0], nDofsP);
 
-    s.dependent(&aResP[0], nDofsP);
+      // define the independent variables
+      for (unsigned  k = 0; k < dim; k++) {
+        s.independent(&solV[k][0], nDofsV);
+      }
 
-    // define the independent variables
-    for (unsigned  k = 0; k < dim; k++) {
-      s.independent(&solV[k][0], nDofsV);
-    }
+      s.independent(&solP[0], nDofsP);
 
-    s.independent(&solP[0], nDofsP);
+      // get the and store jacobian matrix (row-major)
+      s.jacobian(&Jac[0] , true);
+      buffer.AddMatrix(Jac, sysDof, sysDof);
 
-    // get the and store jacobian matrix (row-major)
-    s.jacobian(&Jac[0] , true);
-    KK->add_matrix_blocked(Jac, sysDof, sysDof);
+      s.clear_independents();
+      s.clear_dependents();
 
-    s.clear_independents();
-    s.clear_dependents();
+    } //end element loop for each process
 
-  } //end element loop for each process
+    buffer.Flush();
+  } //end parallel region
 
   RES->close();
 
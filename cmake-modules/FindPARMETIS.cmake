@@ -0,0 +1,60 @@
+# -*- mode: cmake -*-
+#
+# ParMETIS Find Module for Femus
+#
+# Usage:
+#    Control the search through PARMETIS_DIR or let the module look into the
+#    PETSc installation (PETSC_DIR/PETSC_ARCH), where ParMETIS is installed when
+#    PETSc is configured with --download-parmetis.
+#
+#    Following variables are set:
+#    PARMETIS_FOUND            (BOOL)       Flag indicating if ParMETIS was found
+#    PARMETIS_INCLUDE_DIR      (PATH)       Path to the ParMETIS include file
+#    PARMETIS_INCLUDE_DIRS     (LIST)       List of all required include files
+#    PARMETIS_LIBRARY          (FILE)       ParMETIS library
+#    PARMETIS_LIBRARIES        (LIST)       List of all required ParMETIS libraries
+#
+# #############################################################################
+
+include(FindPackageHandleStandardArgs)
+
+if ( PARMETIS_LIBRARIES AND PARMETIS_INCLUDE_DIRS )
+
+    # Do nothing. Variables are set. No need to search again
+
+else(PARMETIS_LIBRARIES AND PARMETIS_INCLUDE_DIRS)
+
+    set(_PARMETIS_HINTS ${PARMETIS_DIR} $ENV{PARMETIS_DIR} "${PETSC_DIR}/${PETSC_ARCH}" "${PETSC_DIR}")
+
+    find_path(PARMETIS_INCLUDE_DIR
+              NAMES parmetis.h
+              HINTS ${_PARMETIS_HINTS}
+              PATH_SUFFIXES include)
+
+    find_library(PARMETIS_LIBRARY
+                 NAMES parmetis
+                 HINTS ${_PARMETIS_HINTS}
+                 PATH_SUFFIXES lib lib64)
+
+    # ParMETIS is always linked together with the serial METIS library
+    set(PARMETIS_INCLUDE_DIRS ${PARMETIS_INCLUDE_DIR})
+    set(PARMETIS_LIBRARIES    ${PARMETIS_LIBRARY} ${METIS_LIBRARIES})
+
+endif(PARMETIS_LIBRARIES AND PARMETIS_INCLUDE_DIRS)
+
+find_package_handle_standard_args(PARMETIS DEFAULT_MSG
+                                  PARMETIS_LIBRARY
+                                  PARMETIS_INCLUDE_DIR)
+
+if ( PARMETIS_LIBRARY AND PARMETIS_INCLUDE_DIR )
+    set(PARMETIS_FOUND TRUE)
+else()
+    set(PARMETIS_FOUND FALSE)
+endif()
+
+mark_as_advanced(
+  PARMETIS_INCLUDE_DIR
+  PARMETIS_INCLUDE_DIRS
+  PARMETIS_LIBRARY
+  PARMETIS_LIBRARIES
+)
@@ -30,6 +30,14 @@ IF(HDF5_FOUND)
   TARGET_LINK_LIBRARIES(${appname} ${HDF5_LIBRARIES})
 ENDIF(HDF5_FOUND)
 
+IF(PARMETIS_FOUND)
+  TARGET_LINK_LIBRARIES(${appname} ${PARMETIS_LIBRARIES})
+ENDIF(PARMETIS_FOUND)
+
+IF(ZLIB_FOUND)
+  TARGET_LINK_LIBRARIES(${appname} ${ZLIB_LIBRARIES})
+ENDIF(ZLIB_FOUND)
+
 FILE(MAKE_DIRECTORY ${PROJECT_BINARY_DIR}/output/)
 FILE(MAKE_DIRECTORY ${PROJECT_BINARY_DIR}/input/)
 FILE(MAKE_DIRECTORY ${PROJECT_BINARY_DIR}/save/)
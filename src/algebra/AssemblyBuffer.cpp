@@ -0,0 +1,98 @@
+/*=========================================================================
+
+Program: FEMuS
+Module: AssemblyBuffer
+Authors: Eugenio Aulisa
+
+Copyright (c) FEMuS
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "AssemblyBuffer.hpp"
+#include "SparseMatrix.hpp"
+#include "NumericVector.hpp"
+
+
+namespace femus {
+
+//----------------------------------------------------------------------------
+AssemblyBuffer::AssemblyBuffer(SparseMatrix* KK, NumericVector* RES, const unsigned &capacity) :
+  _KK(KK), _RES(RES), _capacity(capacity) {
+  _vectorOffset.assign(1, 0);
+  _matrixOffset.assign(3, 0);
+}
+
+//----------------------------------------------------------------------------
+AssemblyBuffer::~AssemblyBuffer() {
+  Flush();
+}
+
+//----------------------------------------------------------------------------
+void AssemblyBuffer::AddVector(const std::vector< double > &values, const std::vector< int > &dofs) {
+  _vectorValues.insert(_vectorValues.end(), values.begin(), values.end());
+  _vectorDofs.insert(_vectorDofs.end(), dofs.begin(), dofs.end());
+  _vectorOffset.push_back(_vectorValues.size());
+
+  if(_vectorValues.size() + _matrixValues.size() > _capacity) Flush();
+}
+
+//----------------------------------------------------------------------------
+void AssemblyBuffer::AddMatrix(const std::vector< double > &values, const std::vector< int > &rows, const std::vector< int > &cols) {
+  _matrixValues.insert(_matrixValues.end(), values.begin(), values.end());
+  _matrixRows.insert(_matrixRows.end(), rows.begin(), rows.end());
+  _matrixCols.insert(_matrixCols.end(), cols.begin(), cols.end());
+  _matrixOffset.push_back(_matrixRows.size());
+  _matrixOffset.push_back(_matrixCols.size());
+  _matrixOffset.push_back(_matrixValues.size());
+
+  if(_vectorValues.size() + _matrixValues.size() > _capacity) Flush();
+}
+
+//----------------------------------------------------------------------------
+void AssemblyBuffer::Flush() {
+
+  if(_vectorOffset.size() == 1 && _matrixOffset.size() == 3) return;
+
+  // PETSc objects are not thread safe: only one buffer at a time is moved into them
+#ifdef _OPENMP
+  #pragma omp critical (femus_assembly_buffer_flush)
+#endif
+  {
+    if(_RES) {
+      for(unsigned i = 0; i + 1 < _vectorOffset.size(); i++) {
+        _blockValues.assign(_vectorValues.begin() + _vectorOffset[i], _vectorValues.begin() + _vectorOffset[i + 1]);
+        _blockRows.assign(_vectorDofs.begin() + _vectorOffset[i], _vectorDofs.begin() + _vectorOffset[i + 1]);
+        _RES->add_vector_blocked(_blockValues, _blockRows);
+      }
+    }
+
+    if(_KK) {
+      for(unsigned i = 3; i < _matrixOffset.size(); i += 3) {
+        _blockRows.assign(_matrixRows.begin() + _matrixOffset[i - 3], _matrixRows.begin() + _matrixOffset[i]);
+        _blockCols.assign(_matrixCols.begin() + _matrixOffset[i - 2], _matrixCols.begin() + _matrixOffset[i + 1]);
+        _blockValues.assign(_matrixValues.begin() + _matrixOffset[i - 1], _matrixValues.begin() + _matrixOffset[i + 2]);
+        _KK->add_matrix_blocked(_blockValues, _blockRows, _blockCols);
+      }
+    }
+  }
+
+  _vectorValues.clear();
+  _vectorDofs.clear();
+  _vectorOffset.assign(1, 0);
+
+  _matrixValues.clear();
+  _matrixRows.clear();
+  _matrixCols.clear();
+  _matrixOffset.assign(3, 0);
+}
+
+
+} //end namespace femus
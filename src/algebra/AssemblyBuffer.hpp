@@ -0,0 +1,84 @@
+/*=========================================================================
+
+Program: FEMuS
+Module: AssemblyBuffer
+Authors: Eugenio Aulisa
+
+Copyright (c) FEMuS
+All rights reserved.
+
+This software is distributed WITHOUT ANY WARRANTY; without even
+the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_algebra_AssemblyBuffer_hpp__
+#define __femus_algebra_AssemblyBuffer_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include <vector>
+
+
+namespace femus {
+
+class SparseMatrix;
+class NumericVector;
+
+/**
+ * Thread-local staging area for element contributions. Each thread of a threaded
+ * assembly loop owns one buffer, stores its element blocks in it and flushes them
+ * into the shared PETSc objects, one thread at a time, when the buffer is full or
+ * when the loop is over. PETSc insertion is not thread safe, so only the element
+ * evaluation runs concurrently: the flushes are serialized, whatever the element order.
+ */
+class AssemblyBuffer {
+
+public:
+
+    /** Constructor, KK or RES can be NULL. The buffer is flushed when it holds more than capacity values */
+    AssemblyBuffer(SparseMatrix* KK, NumericVector* RES, const unsigned &capacity = 1048576u);
+
+    /** Destructor, flushes the remaining blocks */
+    ~AssemblyBuffer();
+
+    /** Stores an element residual block, to be added with add_vector_blocked */
+    void AddVector(const std::vector< double > &values, const std::vector< int > &dofs);
+
+    /** Stores an element matrix block, to be added with add_matrix_blocked */
+    void AddMatrix(const std::vector< double > &values, const std::vector< int > &rows, const std::vector< int > &cols);
+
+    /** Adds all the stored blocks to KK and RES and empties the buffer */
+    void Flush();
+
+private:
+
+    SparseMatrix* _KK;
+    NumericVector* _RES;
+    unsigned _capacity;
+
+    /** vector blocks: dofs and values of block i are in [_vectorOffset[i], _vectorOffset[i+1]) */
+    std::vector< double > _vectorValues;
+    std::vector< int > _vectorDofs;
+    std::vector< unsigned > _vectorOffset;
+
+    /** matrix blocks: rows, cols and values of block i start at _matrixOffset[3*i], [3*i+1], [3*i+2] */
+    std::vector< double > _matrixValues;
+    std::vector< int > _matrixRows;
+    std::vector< int > _matrixCols;
+    std::vector< unsigned > _matrixOffset;
+
+    /** scratch vectors used to call the blocked PETSc interface */
+    std::vector< double > _blockValues;
+    std::vector< int > _blockRows;
+    std::vector< int > _blockCols;
+};
+
+
+} //end namespace femus
+
+
+
+#endif
@@ -271,10 +271,12 @@ namespace femus {
     PetscLogDouble t2;
     PetscTime(&t1);
 
+    SparseMatrix* A = (_matrixFreeJacobian) ? static_cast< SparseMatrix* >(_matrixFreeJacobian) : _KK;
+
     if(ksp_clean) {
       Mat KK = (static_cast< PetscMatrix* >(_KK))->mat();
 
-      KSPSetOperators(_ksp, KK, KK);
+      KSPSetOperators(_ksp, (static_cast< PetscMatrix* >(A))->mat(), KK);
       
       KSPSetTolerances(_ksp, _rtol, _abstol, _dtol, _maxits);
 
@@ -287,17 +289,23 @@ namespace femus {
       KSPSetUp(_ksp);
 
     }
+    else {
+      // the tolerances can change between two solves with the same operators, e.g. in inexact Newton
+      KSPSetTolerances(_ksp, _rtol, _abstol, _dtol, _maxits);
+    }
 
     ZerosBoundaryResiduals();
     KSPSolve(_ksp, (static_cast< PetscVector* >(_RES))->vec(), (static_cast< PetscVector* >(_EPSC))->vec());
 
-    _RESC->matrix_mult(*_EPSC, *_KK);
+    _RESC->matrix_mult(*_EPSC, *A);
     *_RES -= *_RESC;
     *_EPS += *_EPSC;
 
+    int its;
+    KSPGetIterationNumber(_ksp, &its);
+    _mgSolveIterations = its;
+
     if(_printSolverInfo) {
-      int its;
-      KSPGetIterationNumber(_ksp, &its);
 
       KSPConvergedReason reason;
       KSPGetConvergedReason(_ksp, &reason);
@@ -315,6 +323,25 @@ namespace femus {
 
   // ================================================
 
+  void GmresPetscLinearEquationSolver::SetMatrixFreeJacobian(void (*residualFunction)(void *context), void *context) {
+
+    if(_matrixFreeJacobian) {
+      delete _matrixFreeJacobian;
+      _matrixFreeJacobian = NULL;
+    }
+
+    if(residualFunction) {
+      std::vector < unsigned > solType(_SolPdeIndex.size());
+      for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
+        solType[k] = _SolType[_SolPdeIndex[k]];
+      }
+      // _bdcIndex is filled by the first MGSetLevel, the shell only keeps a reference to it
+      _matrixFreeJacobian = new PetscMatrixFreeJacobian(*this, _SolPdeIndex, solType, _bdcIndex, residualFunction, context);
+    }
+  }
+
+  // ================================================
+
   void GmresPetscLinearEquationSolver::RemoveNullSpace() {
 
     if( _msh->GetLevel() != 0) {
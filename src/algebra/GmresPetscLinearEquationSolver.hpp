@@ -28,6 +28,7 @@
 // includes :
 //----------------------------------------------------------------------------
 #include "LinearEquationSolver.hpp"
+#include "PetscMatrixFreeJacobian.hpp"
 
 namespace femus {
 
@@ -78,6 +79,16 @@ namespace femus {
 
       void MGSolve(const bool ksp_clean);
 
+      void SetMatrixFreeJacobian(void (*residualFunction)(void *context), void *context);
+
+      void UpdateMatrixFreeJacobian() {
+        _matrixFreeJacobian->UpdateBase();
+      }
+
+      unsigned GetMGSolveIterationNumber() {
+        return _mgSolveIterations;
+      }
+
       inline void MGClear() {
         KSPDestroy(&_ksp);
       }
@@ -114,6 +125,11 @@ namespace femus {
       
       double _richardsonScaleFactor;
 
+      unsigned _mgSolveIterations;
+
+      /** Krylov operator of MGSolve in place of _KK, if not NULL */
+      PetscMatrixFreeJacobian *_matrixFreeJacobian;
+
   };
 
   // =============================================
@@ -136,6 +152,8 @@ namespace femus {
     _maxits = 1000;
     _restart = 30;
     _richardsonScaleFactor = 0.5;
+    _mgSolveIterations = 0;
+    _matrixFreeJacobian = NULL;
 
     _bdcIndexIsInitialized = 0;
     
@@ -160,6 +178,11 @@ namespace femus {
       KSPDestroy(&_ksp);
     }
 
+    if(_matrixFreeJacobian) {
+      delete _matrixFreeJacobian;
+      _matrixFreeJacobian = NULL;
+    }
+
 
   }
 
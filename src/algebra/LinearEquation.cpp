@@ -44,6 +44,8 @@ LinearEquation::LinearEquation(Solution *other_solution){
   _RESC = NULL;
   _KK = NULL;
   _KKamr = NULL;
+  _elementSystemDofStart = 0;
+  _elementSystemDofEnd = 0;
 }
 
 //--------------------------------------------------------------------------------
@@ -68,6 +70,12 @@ unsigned LinearEquation::GetSystemDof(const unsigned &index_sol, const unsigned
 				      const unsigned &i, const unsigned &iel) const {
 
   unsigned soltype =  _SolType[index_sol];
+
+  if( _elementSystemDof.size() != 0 && soltype == _SolType[_SolPdeIndex[kkindex_sol]] &&
+      iel >= _elementSystemDofStart && iel < _elementSystemDofEnd ) {
+    return GetElementSystemDof(kkindex_sol, iel)[i];
+  }
+
   unsigned idof= _msh->GetSolutionDof(i, iel, soltype);
 
   unsigned isubdom = _msh->IsdomBisectionSearch(idof, soltype);
@@ -96,6 +104,49 @@ unsigned LinearEquation::GetSystemDof(const unsigned &index_sol, const unsigned
 }
 
 
+//--------------------------------------------------------------------------------
+void LinearEquation::BuildElementSystemDofTable() {
+
+  ClearElementSystemDofTable();
+
+  unsigned nel_loc = _msh->_elementOffset[_iproc + 1] - _msh->_elementOffset[_iproc];
+
+  vector < vector < unsigned > > elementSystemDof(_SolPdeIndex.size());
+  vector < vector < unsigned > > elementSystemDofOffset(_SolPdeIndex.size());
+
+  for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
+    unsigned soltype = _SolType[_SolPdeIndex[k]];
+
+    elementSystemDofOffset[k].resize(nel_loc + 1);
+    elementSystemDofOffset[k][0] = 0;
+    for(unsigned iel = _msh->_elementOffset[_iproc]; iel < _msh->_elementOffset[_iproc + 1]; iel++) {
+      unsigned jel = iel - _msh->_elementOffset[_iproc];
+      elementSystemDofOffset[k][jel + 1] = elementSystemDofOffset[k][jel] + _msh->GetElementDofNumber(iel, soltype);
+    }
+
+    elementSystemDof[k].resize(elementSystemDofOffset[k][nel_loc]);
+    for(unsigned iel = _msh->_elementOffset[_iproc]; iel < _msh->_elementOffset[_iproc + 1]; iel++) {
+      unsigned jel = iel - _msh->_elementOffset[_iproc];
+      unsigned nDofs = elementSystemDofOffset[k][jel + 1] - elementSystemDofOffset[k][jel];
+      for(unsigned i = 0; i < nDofs; i++) {
+        elementSystemDof[k][elementSystemDofOffset[k][jel] + i] = GetSystemDof(_SolPdeIndex[k], k, i, iel);
+      }
+    }
+  }
+
+  // the tables are swapped in only after they are complete, since GetSystemDof uses them as soon as they exist
+  _elementSystemDofStart = _msh->_elementOffset[_iproc];
+  _elementSystemDofEnd = _msh->_elementOffset[_iproc + 1];
+  _elementSystemDof.swap(elementSystemDof);
+  _elementSystemDofOffset.swap(elementSystemDofOffset);
+}
+
+//--------------------------------------------------------------------------------
+void LinearEquation::ClearElementSystemDofTable() {
+  _elementSystemDof.resize(0);
+  _elementSystemDofOffset.resize(0);
+}
+
 //--------------------------------------------------------------------------------
 void LinearEquation::InitPde(const vector <unsigned> &SolPdeIndex_other, const  vector <int> &SolType_other,
 		     const vector <char*> &SolName_other, vector <NumericVector*> *Bdc_other,
@@ -185,6 +236,7 @@ void LinearEquation::InitPde(const vector <unsigned> &SolPdeIndex_other, const
   _RESC = NumericVector::build().release();
   _RESC->init(*_EPS);
 
+  BuildElementSystemDofTable();
 
   GetSparsityPatternSize();
 
@@ -246,8 +298,17 @@ void LinearEquation::DeletePde() {
   if(_RESC)
     delete _RESC;
 
+  ClearElementSystemDofTable();
+
 }
 
+  //--------------------------------------------------------------------------------
+  void LinearEquation::SortAndCompress(vector < unsigned long long > &pattern) {
+    std::sort(pattern.begin(), pattern.end());
+    pattern.erase(std::unique(pattern.begin(), pattern.end()), pattern.end());
+  }
+
+  //--------------------------------------------------------------------------------
   void LinearEquation::GetSparsityPatternSize() {
 
     unsigned SolPdeSize=_SolPdeIndex.size();
@@ -286,14 +347,15 @@ void LinearEquation::DeletePde() {
     int IndexEnd  = KKoffset[KKIndex.size()-1][this_proc];
     int owned_dofs    = IndexEnd-IndexStart;
 
-    vector < std::map < int, bool > > BlgToMe_d(owned_dofs);
-    vector < std::map < int, bool > > BlgToMe_o(owned_dofs);
-    std::map < int, std::map <int, bool > > DnBlgToMe_o;
-    std::map < int, std::map <int, bool > > DnBlgToMe_d;
+    // the (row, column) couplings are stored as 64-bit keys (row << 32 | column) in flat arrays,
+    // which are periodically sorted and compressed, instead of one std::map node per coupling
+    vector < unsigned long long > BlgToMe;   // owned rows: local row index, global column index
+    vector < unsigned long long > DnBlgToMe; // rows owned by other procs: global row and column indexes
+    unsigned long long compactBlgToMe = 1u << 20;
+    unsigned long long compactDnBlgToMe = 1u << 16;
 
     for(int kel=_msh->_elementOffset[this_proc]; kel < _msh->_elementOffset[this_proc+1]; kel++) {
 
-      short int kelt = _msh->GetElementType(kel);
       vector < int > nve(_SolPdeIndex.size());
       for(int i=0;i<_SolPdeIndex.size();i++){
 	nve[i] = _msh->GetElementDofNumber(kel,_SolType[_SolPdeIndex[i]]);
@@ -303,10 +365,9 @@ void LinearEquation::DeletePde() {
       }
 
       for(int i=0; i<_SolPdeIndex.size(); i++) {
-	int ThisSolType=_SolType[_SolPdeIndex[i]];
+	const unsigned *elementSystemDof = GetElementSystemDof(i, kel);
 	for (int j=0;j<nve[i];j++) {
-          int inode=_msh->GetSolutionDof(j, kel, ThisSolType);
-	  dofsVAR[i][j]= GetSystemDof(_SolPdeIndex[i],i,j,kel);
+	  dofsVAR[i][j]= elementSystemDof[j];
 	}
       }
       for(int i=0;i<_SolPdeIndex.size();i++){
@@ -315,55 +376,72 @@ void LinearEquation::DeletePde() {
 	  for(int j=0;j<_SolPdeIndex.size();j++){
 	    if(_SparsityPattern[_SolPdeIndex.size()*i+j]){
 	      for(int jnode=0;jnode<nve[j];jnode++){
-	        int jdof_local=dofsVAR[j][jnode] - IndexStart;
-
-		if(idof_local >= 0){ // i-row belogns to this proc
-		  if(jdof_local >= 0){ // j-row belongs to this proc (diagonal)
-		    BlgToMe_d[ idof_local ][ jdof_local ] = 1;
-		  }
-		  else { // j-row does not belong to this proc (off-diagonal)
-		    BlgToMe_o[ idof_local ][ dofsVAR[j][jnode] ]=1;
-		  }
+		if(idof_local >= 0 && idof_local < owned_dofs){ // i-row belogns to this proc
+		  BlgToMe.push_back( ( static_cast < unsigned long long > (idof_local) << 32 ) | dofsVAR[j][jnode] );
 		}
 		else{ // i-row does not belong to this proc
-		  // identify the process the i-row belogns to
-		  int iproc=0;
-		  while (dofsVAR[i][inode] >= KKoffset[KKIndex.size()-1][iproc]) iproc++;
-
-		  // identify the process the j-column belogns to
-		  int jproc=0;
-		  while (dofsVAR[j][jnode] >= KKoffset[KKIndex.size()-1][jproc]) jproc++;
-		  if (iproc != jproc){ // if diagonal
-		    DnBlgToMe_o[dofsVAR[i][inode]][dofsVAR[j][jnode]]=1;
-		  }
-		  else if (iproc == jproc){ // if off-diagonal
-		    DnBlgToMe_d[dofsVAR[i][inode]][dofsVAR[j][jnode]]=1;
-		  }
+		  DnBlgToMe.push_back( ( static_cast < unsigned long long > (dofsVAR[i][inode]) << 32 ) | dofsVAR[j][jnode] );
 		}
 	      }
 	    }
 	  }
 	}
       }
+
+      if( BlgToMe.size() > compactBlgToMe ){
+        SortAndCompress(BlgToMe);
+        compactBlgToMe = std::max( compactBlgToMe, 2 * static_cast < unsigned long long > (BlgToMe.size()) );
+      }
+      if( DnBlgToMe.size() > compactDnBlgToMe ){
+        SortAndCompress(DnBlgToMe);
+        compactDnBlgToMe = std::max( compactDnBlgToMe, 2 * static_cast < unsigned long long > (DnBlgToMe.size()) );
+      }
     }
 
+    SortAndCompress(BlgToMe);
+    SortAndCompress(DnBlgToMe);
+
+    // count the couplings of the rows owned by other procs, split in diagonal and off-diagonal blocks
     NumericVector  *sizeDnBM_o = NumericVector::build().release();
     sizeDnBM_o->init(*_EPS);
     sizeDnBM_o->zero();
-    for (std::map < int, std::map <int, bool > >::iterator it=DnBlgToMe_o.begin(); it!=DnBlgToMe_o.end(); ++it){
-      sizeDnBM_o->add(it->first,it->second.size());
-    }
-    sizeDnBM_o->close();
-
 
     NumericVector  *sizeDnBM_d = NumericVector::build().release();
     sizeDnBM_d->init(*_EPS);
     sizeDnBM_d->zero();
-    for (std::map < int, std::map <int, bool > >::iterator it=DnBlgToMe_d.begin(); it!=DnBlgToMe_d.end(); ++it){
-      sizeDnBM_d->add(it->first,it->second.size());
+
+    const vector < unsigned > &KKend = KKoffset[KKIndex.size()-1];
+    for(unsigned k = 0; k < DnBlgToMe.size(); ) {
+      unsigned irow = static_cast < unsigned > (DnBlgToMe[k] >> 32);
+      // identify the process the i-row belogns to
+      unsigned iproc = std::upper_bound(KKend.begin(), KKend.end(), irow) - KKend.begin();
+      int counter_d = 0;
+      int counter_o = 0;
+      for( ; k < DnBlgToMe.size() && static_cast < unsigned > (DnBlgToMe[k] >> 32) == irow; k++) {
+        unsigned jcol = static_cast < unsigned > (DnBlgToMe[k] & 0xFFFFFFFFull);
+        // identify the process the j-column belogns to
+        if( jcol >= ( (iproc == 0) ? 0u : KKend[iproc-1] ) && jcol < KKend[iproc] ) counter_d++;
+        else counter_o++;
+      }
+      if(counter_d) sizeDnBM_d->add(irow, counter_d);
+      if(counter_o) sizeDnBM_o->add(irow, counter_o);
     }
+    sizeDnBM_o->close();
     sizeDnBM_d->close();
 
+    vector < unsigned long long > ().swap(DnBlgToMe);
+
+    // count the couplings of the owned rows
+    vector < int > BlgToMe_d(owned_dofs, 0);
+    vector < int > BlgToMe_o(owned_dofs, 0);
+    for(unsigned k = 0; k < BlgToMe.size(); k++) {
+      unsigned irow = static_cast < unsigned > (BlgToMe[k] >> 32);
+      int jcol = static_cast < int > (BlgToMe[k] & 0xFFFFFFFFull);
+      if( jcol >= IndexStart && jcol < IndexEnd ) BlgToMe_d[irow]++; // diagonal block
+      else BlgToMe_o[irow]++; // off-diagonal block
+    }
+
+    vector < unsigned long long > ().swap(BlgToMe);
 
     d_nnz.resize(owned_dofs);
     o_nnz.resize(owned_dofs);
@@ -372,9 +450,9 @@ void LinearEquation::DeletePde() {
     int o_max=KKIndex[KKIndex.size()-1u]-owned_dofs;
 
     for(int i=0; i<owned_dofs;i++){
-     d_nnz[i]=static_cast <int> ((*sizeDnBM_d)(IndexStart+i))+BlgToMe_d[i].size();
+     d_nnz[i]=static_cast <int> ((*sizeDnBM_d)(IndexStart+i))+BlgToMe_d[i];
      if (d_nnz[i] > d_max) d_nnz[i] = d_max;
-     o_nnz[i]=static_cast <int> ((*sizeDnBM_o)(IndexStart+i))+BlgToMe_o[i].size();
+     o_nnz[i]=static_cast <int> ((*sizeDnBM_o)(IndexStart+i))+BlgToMe_o[i];
      if (o_nnz[i] > o_max) o_nnz[i] = o_max;
     }
 
@@ -71,6 +71,23 @@ public:
 			
   unsigned GetSystemDof(const unsigned &soltype, const unsigned &kkindex_sol,
 			const unsigned &i, const unsigned &iel, const vector < vector <unsigned> > &otherKKoffset) const;
+
+  /** Build the element-to-system-dof tables of the owned elements for all the PDE variables */
+  void BuildElementSystemDofTable();
+
+  /** Free the element-to-system-dof tables */
+  void ClearElementSystemDofTable();
+
+  /** Returns true if the element-to-system-dof tables have been built */
+  bool HasElementSystemDofTable() const {
+    return _elementSystemDof.size() != 0;
+  }
+
+  /** Returns the contiguous system dofs of the owned element iel for the PDE variable kkindex_sol:
+   *  the number of entries is _msh->GetElementDofNumber(iel, soltype) */
+  const unsigned* GetElementSystemDof(const unsigned &kkindex_sol, const unsigned &iel) const {
+    return &_elementSystemDof[kkindex_sol][ _elementSystemDofOffset[kkindex_sol][iel - _elementSystemDofStart] ];
+  }
 			
 
   /** To be Added */
@@ -114,6 +131,9 @@ protected:
   /** To be Added */
   unsigned GetIndex(const char name[]);
 
+  /** Sort the (row << 32 | column) sparsity pattern keys and remove the duplicates */
+  static void SortAndCompress(vector < unsigned long long > &pattern);
+
   // member data
   vector <unsigned> _SolPdeIndex;
   vector <int> _SolType;
@@ -121,6 +141,13 @@ protected:
   const vector <NumericVector*> *_Bdc;
   vector <bool> _SparsityPattern;
 
+  /** element-to-system-dof tables: for each PDE variable the system dofs of the owned elements
+   *  are stored contiguously, and _elementSystemDofOffset gives the start of each element */
+  vector < vector < unsigned > > _elementSystemDof;
+  vector < vector < unsigned > > _elementSystemDofOffset;
+  unsigned _elementSystemDofStart;
+  unsigned _elementSystemDofEnd;
+
 };
 
 } //end namespace femus
@@ -96,6 +96,24 @@ namespace femus {
                               ) = 0;
 
       virtual void MGSolve(const bool ksp_clean) = 0;
+
+      /** Use the matrix-free Jacobian of residualFunction(context) as the operator of MGSolve, _KK is kept as preconditioner.
+       * A NULL residualFunction restores _KK as operator */
+      virtual void SetMatrixFreeJacobian(void (*residualFunction)(void *context), void *context) {
+        std::cout << "Warning SetMatrixFreeJacobian(...) is not available for this smoother\n";
+        abort();
+      }
+
+      /** Set _RES, just assembled at the current solution, as base point of the matrix-free Jacobian */
+      virtual void UpdateMatrixFreeJacobian() {
+        std::cout << "Warning UpdateMatrixFreeJacobian() is not available for this smoother\n";
+        abort();
+      }
+
+      /** Number of outer Krylov iterations of the last MGSolve */
+      virtual unsigned GetMGSolveIterationNumber() {
+        return 0;
+      }
       
       virtual void SetRichardsonScaleFactor(const double & richardsonScaleFactor) = 0; 
 
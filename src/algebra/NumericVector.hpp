@@ -42,6 +42,61 @@ class DenseVector;
 class DenseSubVector;
 class SparseMatrix;
 
+/**
+ * Read-only view on the local values (owned dofs followed by ghost dofs) of a NumericVector.
+ * Ghost dofs are resolved through a flat table of sorted global indices, so reading element
+ * values is a plain indexed load. The view is valid until the vector is modified, closed or destroyed.
+ */
+class NumericVectorLocalView {
+
+public:
+
+  NumericVectorLocalView() :
+    _values(NULL), _first(0), _last(0), _ghostGlobal(NULL), _ghostLocal(NULL), _nGhost(0) {}
+
+  NumericVectorLocalView(const double* values, const int &first, const int &last,
+                         const int* ghostGlobal, const int* ghostLocal, const unsigned &nGhost) :
+    _values(values), _first(first), _last(last), _ghostGlobal(ghostGlobal), _ghostLocal(ghostLocal), _nGhost(nGhost) {}
+
+  /** @returns the position of the global dof \p i in the local array */
+  int LocalIndex(const int &i) const {
+    if(i >= _first && i < _last) return i - _first;
+
+    unsigned lo = 0;
+    unsigned hi = _nGhost;
+    while(lo < hi) {
+      unsigned mid = (lo + hi) >> 1;
+      if(_ghostGlobal[mid] < i) lo = mid + 1;
+      else hi = mid;
+    }
+    if(lo == _nGhost || _ghostGlobal[lo] != i) {
+      std::cout << "Error in NumericVectorLocalView::LocalIndex: the global dof " << i
+                << " is neither owned nor a ghost of this process" << std::endl;
+      abort();
+    }
+    return (_last - _first) + _ghostLocal[lo];
+  }
+
+  /** @returns the value of the global dof \p i */
+  double operator() (const int &i) const {
+    return _values[LocalIndex(i)];
+  }
+
+  /** Gathers the values of the \p n global dofs \p dofs into \p out */
+  void GetValues(const unsigned* dofs, const unsigned &n, double* out) const {
+    for(unsigned j = 0; j < n; j++) out[j] = _values[LocalIndex(dofs[j])];
+  }
+
+private:
+
+  const double* _values;
+  int _first;
+  int _last;
+  const int* _ghostGlobal;
+  const int* _ghostLocal;
+  unsigned _nGhost;
+};
+
 /**
  * Numeric vector. Provides a uniform interface
  * to vector storage schemes for different linear
@@ -234,6 +289,31 @@ public:
    */
   virtual void get(const std::vector< int>& index, std::vector<double>& values) const;
 
+  /**
+   * Gathers the values of the \p n global dofs \p dofs into \p out.
+   * The default implementation calls \p operator() for each index.
+   */
+  virtual void GetElementValues(const unsigned* dofs, const unsigned &n, double* out) const {
+    for(unsigned j = 0; j < n; j++) out[j] = (*this)(dofs[j]);
+  }
+
+  /** @returns a read-only view on the local values, see NumericVectorLocalView */
+  virtual NumericVectorLocalView GetLocalView() const = 0;
+
+  /**
+   * @returns a writable pointer to the owned values, valid until close() or UpdateGhostsBegin().
+   * The ghost copies on the other processes are not updated by writing through it.
+   */
+  virtual double* GetOwnedArray() = 0;
+
+  /**
+   * Sends the owned values to their ghost copies. It replaces close() after GetOwnedArray() and
+   * it is split in two phases, so that the communication of several vectors can overlap, as long as
+   * they do not share a ghost scatter (see PetscVector::UpdateGhostsBegin).
+   */
+  virtual void UpdateGhostsBegin() = 0;
+  virtual void UpdateGhostsEnd() = 0;
+
   // =====================================
   // algebra FUNCTIONS
   // =====================================
@@ -0,0 +1,197 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: PetscMatrixFreeJacobian
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "FemusConfig.hpp"
+
+#ifdef HAVE_PETSC
+
+#include "PetscMatrixFreeJacobian.hpp"
+#include "PetscVector.hpp"
+#include "LinearEquation.hpp"
+#include "Solution.hpp"
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace femus {
+
+  // ==============================================
+  PetscMatrixFreeJacobian::PetscMatrixFreeJacobian(LinearEquation& lspde, const std::vector < unsigned >& solIndex,
+      const std::vector < unsigned >& solType, const std::vector < PetscInt >& identityRows,
+      void (*residualFunction)(void *context), void *context) :
+    PetscMatrix(CreateShell(lspde)),
+    _lspde(lspde),
+    _solIndex(solIndex),
+    _solType(solType),
+    _identityRows(identityRows),
+    _residualFunction(residualFunction),
+    _context(context),
+    _solutionNorm(0.) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    _offset = lspde.KKoffset[0][iproc];
+
+    int ierr = 0;
+    ierr = MatShellSetContext(this->mat(), this);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = MatShellSetOperation(this->mat(), MATOP_MULT, (void (*)(void)) Mult);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+
+    ierr = VecDuplicate((static_cast< PetscVector* >(lspde._RES))->vec(), &_residual0);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+
+    _residualWork = NumericVector::build().release();
+    _residualWork->init(*lspde._RES);
+
+    _solutionBackup.resize(_solIndex.size());
+  }
+
+  // ==============================================
+  PetscMatrixFreeJacobian::~PetscMatrixFreeJacobian() {
+    VecDestroy(&_residual0);
+    delete _residualWork;
+    Mat shell = this->mat();
+    MatDestroy(&shell);
+  }
+
+  // ==============================================
+  Mat PetscMatrixFreeJacobian::CreateShell(const LinearEquation& lspde) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    int n = lspde.KKIndex[lspde.KKIndex.size() - 1u];
+    int n_loc = lspde.KKoffset[lspde.KKIndex.size() - 1][iproc] - lspde.KKoffset[0][iproc];
+
+    Mat shell;
+    int ierr = MatCreateShell(MPI_COMM_WORLD, n_loc, n_loc, n, n, PETSC_NULL, &shell);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    return shell;
+  }
+
+  // ==============================================
+  void PetscMatrixFreeJacobian::UpdateBase() {
+    VecCopy((static_cast< PetscVector* >(_lspde._RES))->vec(), _residual0);
+
+    double norm2 = 0.;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      double norm = _lspde._solution->_Sol[_solIndex[k]]->l2_norm();
+      norm2 += norm * norm;
+    }
+    _solutionNorm = sqrt(norm2);
+  }
+
+  // ==============================================
+  void PetscMatrixFreeJacobian::AddToSolution(const double& a, Vec v, const bool& backup) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    PetscScalar* va;
+    VecGetArray(v, &va);
+
+    Solution* solution = _lspde._solution;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      unsigned indexSol = _solIndex[k];
+      unsigned ownSize = _lspde._msh->_ownSize[_solType[k]][iproc];
+      int localOffset = _lspde.KKoffset[k][iproc] - _offset;
+
+      double* sol = solution->_Sol[indexSol]->GetOwnedArray();
+      if(backup) _solutionBackup[k].assign(sol, sol + ownSize);
+      for(unsigned i = 0; i < ownSize; i++) {
+        sol[i] += a * va[localOffset + i];
+      }
+    }
+
+    VecRestoreArray(v, &va);
+
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      solution->_Sol[_solIndex[k]]->UpdateGhostsBegin();
+    }
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      solution->_Sol[_solIndex[k]]->UpdateGhostsEnd();
+    }
+  }
+
+  // ==============================================
+  void PetscMatrixFreeJacobian::RestoreSolution() {
+
+    Solution* solution = _lspde._solution;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      double* sol = solution->_Sol[_solIndex[k]]->GetOwnedArray();
+      std::copy(_solutionBackup[k].begin(), _solutionBackup[k].end(), sol);
+    }
+
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      solution->_Sol[_solIndex[k]]->UpdateGhostsBegin();
+    }
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      solution->_Sol[_solIndex[k]]->UpdateGhostsEnd();
+    }
+  }
+
+  // ==============================================
+  void PetscMatrixFreeJacobian::Apply(Vec v, Vec y) {
+
+    PetscReal vNorm;
+    VecNorm(v, NORM_2, &vNorm);
+    if(vNorm == 0.) {
+      VecZeroEntries(y);
+      return;
+    }
+
+    // differencing parameter of Pernice and Walker
+    double h = 1.e-8 * sqrt(1. + _solutionNorm) / vNorm;
+
+    AddToSolution(h, v, true);
+
+    // the perturbed residual is assembled in _residualWork, so the right hand side in _RES is untouched
+    std::swap(_lspde._RES, _residualWork);
+    _residualFunction(_context);
+    std::swap(_lspde._RES, _residualWork);
+
+    RestoreSolution();
+
+    // y = - (RES(x + h v) - RES(x)) / h
+    VecWAXPY(y, -1., (static_cast< PetscVector* >(_residualWork))->vec(), _residual0);
+    VecScale(y, 1. / h);
+
+    PetscScalar* ya;
+    PetscScalar* va;
+    VecGetArray(y, &ya);
+    VecGetArray(v, &va);
+    for(unsigned i = 0; i < _identityRows.size(); i++) {
+      ya[_identityRows[i] - _offset] = va[_identityRows[i] - _offset];
+    }
+    VecRestoreArray(v, &va);
+    VecRestoreArray(y, &ya);
+  }
+
+  // ==============================================
+  PetscErrorCode PetscMatrixFreeJacobian::Mult(Mat A, Vec v, Vec y) {
+    void* ctx;
+    MatShellGetContext(A, &ctx);
+    static_cast< PetscMatrixFreeJacobian* >(ctx)->Apply(v, y);
+    return 0;
+  }
+
+} //end namespace femus
+
+#endif
@@ -0,0 +1,103 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: PetscMatrixFreeJacobian
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_algebra_PetscMatrixFreeJacobian_hpp__
+#define __femus_algebra_PetscMatrixFreeJacobian_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "FemusConfig.hpp"
+
+#ifdef HAVE_PETSC
+
+#include "PetscMatrix.hpp"
+
+#include <vector>
+
+namespace femus {
+
+//------------------------------------------------------------------------------
+// Forward declarations
+//------------------------------------------------------------------------------
+class LinearEquation;
+class NumericVector;
+
+/**
+ * Matrix-free Jacobian for Jacobian-free Newton-Krylov. The PETSc shell matrix applies the forward
+ * finite difference of the residual assembly, J v = - (RES(x + h v) - RES(x)) / h, where RES = -F is
+ * the residual assembled in lspde._RES by residualFunction at the current solution. The Dirichlet rows
+ * are the identity, as they are in _KK after SetPenalty. Only the matrix-vector product is available.
+ */
+
+class PetscMatrixFreeJacobian : public PetscMatrix {
+
+public:
+
+  /** Constructor: residualFunction(context) has to assemble the residual of lspde at its current solution,
+   * the pde variables solIndex of FE type solType are perturbed in the order of the system numbering,
+   * identityRows are the Dirichlet rows of lspde in the system numbering */
+  PetscMatrixFreeJacobian(LinearEquation &lspde, const std::vector < unsigned > &solIndex, const std::vector < unsigned > &solType,
+                          const std::vector < PetscInt > &identityRows, void (*residualFunction)(void *context), void *context);
+
+  /** Destructor */
+  ~PetscMatrixFreeJacobian();
+
+  /** Store lspde._RES, just assembled at the current solution x, as base point RES(x) of the finite differences */
+  void UpdateBase();
+
+private:
+
+  /** Shell operation */
+  static PetscErrorCode Mult(Mat A, Vec v, Vec y);
+
+  /** y = J v */
+  void Apply(Vec v, Vec y);
+
+  /** Add a * v to the owned values of the pde solutions and update their ghosts,
+   * if backup is true the current owned values are saved first */
+  void AddToSolution(const double &a, Vec v, const bool &backup);
+
+  /** Restore the owned values saved by AddToSolution */
+  void RestoreSolution();
+
+  /** Create the shell with the system layout */
+  static Mat CreateShell(const LinearEquation &lspde);
+
+  LinearEquation &_lspde;
+  std::vector < unsigned > _solIndex;
+  std::vector < unsigned > _solType;
+  const std::vector < PetscInt > &_identityRows;
+  void (*_residualFunction)(void *context);
+  void *_context;
+
+  int _offset;
+
+  /** RES(x) and the residual assembled at the perturbed solution */
+  Vec _residual0;
+  NumericVector *_residualWork;
+
+  /** l2 norm of the pde solutions at the base point */
+  double _solutionNorm;
+
+  /** owned values of the pde solutions before the perturbation */
+  std::vector < std::vector < double > > _solutionBackup;
+};
+
+} //end namespace femus
+
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: PetscMatrixFreeProlongation
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "FemusConfig.hpp"
+
+#ifdef HAVE_PETSC
+
+#include "PetscMatrixFreeProlongation.hpp"
+#include "LinearEquation.hpp"
+#include "Mesh.hpp"
+#include "ElemType.hpp"
+
+#include <algorithm>
+
+namespace femus {
+
+  // ==============================================
+  PetscMatrixFreeProlongation::PetscMatrixFreeProlongation(const LinearEquation& lspdef, const LinearEquation& lspdec,
+      const std::vector < unsigned >& solIndex, const std::vector < unsigned >& solType) :
+    PetscMatrix(CreateShell(lspdef, lspdec)),
+    _lspdef(lspdef),
+    _lspdec(lspdec),
+    _solIndex(solIndex),
+    _solType(solType) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    _fineOffset = lspdef.KKoffset[0][iproc];
+    _fineOffsetp1 = lspdef.KKoffset[lspdef.KKIndex.size() - 1][iproc];
+    _coarseOffset = lspdec.KKoffset[0][iproc];
+    _coarseOffsetp1 = lspdec.KKoffset[lspdec.KKIndex.size() - 1][iproc];
+
+    int ierr = 0;
+    ierr = MatShellSetContext(this->mat(), this);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = MatShellSetOperation(this->mat(), MATOP_MULT, (void (*)(void)) Mult);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = MatShellSetOperation(this->mat(), MATOP_MULT_ADD, (void (*)(void)) MultAdd);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = MatShellSetOperation(this->mat(), MATOP_MULT_TRANSPOSE, (void (*)(void)) MultTranspose);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = MatShellSetOperation(this->mat(), MATOP_MULT_TRANSPOSE_ADD, (void (*)(void)) MultTransposeAdd);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+
+    // coarse columns of the owned coarse elements stored on other processes
+    Mesh* mshc = lspdec._msh;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      for(int iel = mshc->_elementOffset[iproc]; iel < mshc->_elementOffset[iproc + 1]; iel++) {
+        GetElementStencil(k, iel);
+        for(unsigned j = 0; j < _cols.size(); j++) {
+          if(_cols[j] < _coarseOffset || _cols[j] >= _coarseOffsetp1) {
+            _ghostColumns.push_back(_cols[j]);
+          }
+        }
+      }
+    }
+    std::sort(_ghostColumns.begin(), _ghostColumns.end());
+    _ghostColumns.erase(std::unique(_ghostColumns.begin(), _ghostColumns.end()), _ghostColumns.end());
+
+    int nf_loc = _fineOffsetp1 - _fineOffset;
+    int nc_loc = _coarseOffsetp1 - _coarseOffset;
+    int nghost = _ghostColumns.size();
+
+    ierr = VecCreateMPI(MPI_COMM_WORLD, nf_loc, PETSC_DETERMINE, &_fineWork);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = VecCreateMPI(MPI_COMM_WORLD, nc_loc, PETSC_DETERMINE, &_coarseWork);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = VecCreateSeq(PETSC_COMM_SELF, nghost, &_coarseGhost);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+
+    IS isFrom, isTo;
+    ierr = ISCreateGeneral(PETSC_COMM_SELF, nghost, (nghost > 0) ? &_ghostColumns[0] : PETSC_NULL, PETSC_COPY_VALUES, &isFrom);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = ISCreateStride(PETSC_COMM_SELF, nghost, 0, 1, &isTo);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = VecScatterCreate(_coarseWork, isFrom, _coarseGhost, isTo, &_scatter);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = ISDestroy(&isFrom);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    ierr = ISDestroy(&isTo);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+
+    _fineMask.assign(nf_loc, true);
+    _coarseMask.assign(nc_loc, true);
+    _visited.resize(nf_loc);
+  }
+
+  // ==============================================
+  PetscMatrixFreeProlongation::~PetscMatrixFreeProlongation() {
+    VecScatterDestroy(&_scatter);
+    VecDestroy(&_fineWork);
+    VecDestroy(&_coarseWork);
+    VecDestroy(&_coarseGhost);
+    Mat shell = this->mat();
+    MatDestroy(&shell);
+  }
+
+  // ==============================================
+  Mat PetscMatrixFreeProlongation::CreateShell(const LinearEquation& lspdef, const LinearEquation& lspdec) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    int nf = lspdef.KKIndex[lspdef.KKIndex.size() - 1u];
+    int nc = lspdec.KKIndex[lspdec.KKIndex.size() - 1u];
+    int nf_loc = lspdef.KKoffset[lspdef.KKIndex.size() - 1][iproc] - lspdef.KKoffset[0][iproc];
+    int nc_loc = lspdec.KKoffset[lspdec.KKIndex.size() - 1][iproc] - lspdec.KKoffset[0][iproc];
+
+    Mat shell;
+    int ierr = MatCreateShell(MPI_COMM_WORLD, nf_loc, nc_loc, nf, nc, PETSC_NULL, &shell);
+    CHKERRABORT(MPI_COMM_WORLD, ierr);
+    return shell;
+  }
+
+  // ==============================================
+  void PetscMatrixFreeProlongation::ZeroRowsAndColumns(const std::vector < int >& fineRows, const std::vector < int >& coarseColumns) {
+    for(unsigned i = 0; i < fineRows.size(); i++) {
+      _fineMask[fineRows[i] - _fineOffset] = false;
+    }
+    for(unsigned j = 0; j < coarseColumns.size(); j++) {
+      _coarseMask[coarseColumns[j] - _coarseOffset] = false;
+    }
+  }
+
+  // ==============================================
+  void PetscMatrixFreeProlongation::GetElementStencil(const unsigned& k, const int& iel) {
+    Mesh* mshc = _lspdec._msh;
+    short unsigned ielt = mshc->GetElementType(iel);
+    mshc->_finiteElement[ielt][_solType[k]]->GetProlongationStencil(_lspdef, _lspdec, iel, _solIndex[k], k,
+        _rows, _cols, _stencilIndex, _stencilValue);
+  }
+
+  // ==============================================
+  unsigned PetscMatrixFreeProlongation::GhostPosition(const int& icol) const {
+    return std::lower_bound(_ghostColumns.begin(), _ghostColumns.end(), icol) - _ghostColumns.begin();
+  }
+
+  // ==============================================
+  void PetscMatrixFreeProlongation::Prolongate(Vec xc, Vec yf) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    // zero the masked coarse columns on a copy of xc, then gather the ghost values
+    PetscScalar *x, *w, *g, *y;
+    VecGetArray(xc, &x);
+    VecGetArray(_coarseWork, &w);
+    for(unsigned j = 0; j < _coarseMask.size(); j++) {
+      w[j] = (_coarseMask[j]) ? x[j] : 0.;
+    }
+    VecRestoreArray(_coarseWork, &w);
+    VecRestoreArray(xc, &x);
+
+    VecScatterBegin(_scatter, _coarseWork, _coarseGhost, INSERT_VALUES, SCATTER_FORWARD);
+    VecScatterEnd(_scatter, _coarseWork, _coarseGhost, INSERT_VALUES, SCATTER_FORWARD);
+
+    VecGetArray(_coarseWork, &w);
+    VecGetArray(_coarseGhost, &g);
+    VecGetArray(yf, &y);
+
+    for(unsigned i = 0; i < _fineMask.size(); i++) y[i] = 0.;
+
+    Mesh* mshc = _lspdec._msh;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      for(int iel = mshc->_elementOffset[iproc]; iel < mshc->_elementOffset[iproc + 1]; iel++) {
+        GetElementStencil(k, iel);
+        for(unsigned i = 0; i < _rows.size(); i++) {
+          int irow = _rows[i];
+          if(irow < _fineOffset || irow >= _fineOffsetp1 || !_fineMask[irow - _fineOffset]) continue;
+
+          double value = 0.;
+          const double* weight = _stencilValue[i];
+          for(const int* j = _stencilIndex[i]; j < _stencilIndex[i + 1]; j++, weight++) {
+            int icol = _cols[*j];
+            value += *weight * ((icol >= _coarseOffset && icol < _coarseOffsetp1) ? w[icol - _coarseOffset] : g[GhostPosition(icol)]);
+          }
+          y[irow - _fineOffset] = value;
+        }
+      }
+    }
+
+    VecRestoreArray(yf, &y);
+    VecRestoreArray(_coarseGhost, &g);
+    VecRestoreArray(_coarseWork, &w);
+  }
+
+  // ==============================================
+  void PetscMatrixFreeProlongation::Restrict(Vec xf, Vec yc) {
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+
+    VecSet(_coarseGhost, 0.);
+
+    PetscScalar *x, *g, *y;
+    VecGetArray(xf, &x);
+    VecGetArray(_coarseGhost, &g);
+    VecGetArray(yc, &y);
+
+    for(unsigned j = 0; j < _coarseMask.size(); j++) y[j] = 0.;
+
+    // each owned fine row is shared by several coarse elements: its transposed stencil is added once
+    _visited.assign(_visited.size(), false);
+
+    Mesh* mshc = _lspdec._msh;
+    for(unsigned k = 0; k < _solIndex.size(); k++) {
+      for(int iel = mshc->_elementOffset[iproc]; iel < mshc->_elementOffset[iproc + 1]; iel++) {
+        GetElementStencil(k, iel);
+        for(unsigned i = 0; i < _rows.size(); i++) {
+          int irow = _rows[i];
+          if(irow < _fineOffset || irow >= _fineOffsetp1) continue;
+
+          int iloc = irow - _fineOffset;
+          if(_visited[iloc] || !_fineMask[iloc]) continue;
+          _visited[iloc] = true;
+
+          double value = x[iloc];
+          const double* weight = _stencilValue[i];
+          for(const int* j = _stencilIndex[i]; j < _stencilIndex[i + 1]; j++, weight++) {
+            int icol = _cols[*j];
+            if(icol >= _coarseOffset && icol < _coarseOffsetp1) y[icol - _coarseOffset] += *weight * value;
+            else g[GhostPosition(icol)] += *weight * value;
+          }
+        }
+      }
+    }
+
+    VecRestoreArray(yc, &y);
+    VecRestoreArray(_coarseGhost, &g);
+    VecRestoreArray(xf, &x);
+
+    // send the ghost contributions to the owning processes
+    VecScatterBegin(_scatter, _coarseGhost, yc, ADD_VALUES, SCATTER_REVERSE);
+    VecScatterEnd(_scatter, _coarseGhost, yc, ADD_VALUES, SCATTER_REVERSE);
+
+    VecGetArray(yc, &y);
+    for(unsigned j = 0; j < _coarseMask.size(); j++) {
+      if(!_coarseMask[j]) y[j] = 0.;
+    }
+    VecRestoreArray(yc, &y);
+  }
+
+  // ==============================================
+  PetscErrorCode PetscMatrixFreeProlongation::Mult(Mat A, Vec xc, Vec yf) {
+    void* ctx;
+    MatShellGetContext(A, &ctx);
+    static_cast< PetscMatrixFreeProlongation* >(ctx)->Prolongate(xc, yf);
+    return 0;
+  }
+
+  // ==============================================
+  PetscErrorCode PetscMatrixFreeProlongation::MultAdd(Mat A, Vec xc, Vec zf, Vec yf) {
+    void* ctx;
+    MatShellGetContext(A, &ctx);
+    PetscMatrixFreeProlongation* P = static_cast< PetscMatrixFreeProlongation* >(ctx);
+    P->Prolongate(xc, P->_fineWork);
+    if(zf != yf) VecCopy(zf, yf);
+    VecAXPY(yf, 1., P->_fineWork);
+    return 0;
+  }
+
+  // ==============================================
+  PetscErrorCode PetscMatrixFreeProlongation::MultTranspose(Mat A, Vec xf, Vec yc) {
+    void* ctx;
+    MatShellGetContext(A, &ctx);
+    static_cast< PetscMatrixFreeProlongation* >(ctx)->Restrict(xf, yc);
+    return 0;
+  }
+
+  // ==============================================
+  PetscErrorCode PetscMatrixFreeProlongation::MultTransposeAdd(Mat A, Vec xf, Vec zc, Vec yc) {
+    void* ctx;
+    MatShellGetContext(A, &ctx);
+    PetscMatrixFreeProlongation* P = static_cast< PetscMatrixFreeProlongation* >(ctx);
+    P->Restrict(xf, P->_coarseWork);
+    if(zc != yc) VecCopy(zc, yc);
+    VecAXPY(yc, 1., P->_coarseWork);
+    return 0;
+  }
+
+} //end namespace femus
+
+#endif
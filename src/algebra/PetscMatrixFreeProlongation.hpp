@@ -0,0 +1,110 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: PetscMatrixFreeProlongation
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_algebra_PetscMatrixFreeProlongation_hpp__
+#define __femus_algebra_PetscMatrixFreeProlongation_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "FemusConfig.hpp"
+
+#ifdef HAVE_PETSC
+
+#include "PetscMatrix.hpp"
+
+#include <vector>
+
+namespace femus {
+
+//------------------------------------------------------------------------------
+// Forward declarations
+//------------------------------------------------------------------------------
+class LinearEquation;
+
+/**
+ * Matrix-free coarse-to-fine prolongation. The PETSc shell matrix applies the reference element
+ * stencils of elem_type on the owned coarse elements every time it is multiplied, so neither the
+ * prolongator nor the restriction P^T are ever stored. It can be used wherever the assembled _PP is,
+ * apart from the Galerkin products PtAP and RAP that need the explicit entries.
+ */
+
+class PetscMatrixFreeProlongation : public PetscMatrix {
+
+public:
+
+  /** Constructor: lspdef and lspdec are the fine and coarse equations, the stencils are applied to the
+   * pde variables solIndex of FE type solType, in the order of the system numbering */
+  PetscMatrixFreeProlongation(const LinearEquation &lspdef, const LinearEquation &lspdec,
+                              const std::vector < unsigned > &solIndex, const std::vector < unsigned > &solType);
+
+  /** Destructor */
+  ~PetscMatrixFreeProlongation();
+
+  /** Zero the owned rows fineRows and the owned columns coarseColumns (system numbering), as
+   * mat_zero_rows does on the assembled prolongator and on its transpose */
+  void ZeroRowsAndColumns(const std::vector < int > &fineRows, const std::vector < int > &coarseColumns);
+
+private:
+
+  /** Shell operations */
+  static PetscErrorCode Mult(Mat A, Vec xc, Vec yf);
+  static PetscErrorCode MultAdd(Mat A, Vec xc, Vec zf, Vec yf);
+  static PetscErrorCode MultTranspose(Mat A, Vec xf, Vec yc);
+  static PetscErrorCode MultTransposeAdd(Mat A, Vec xf, Vec zc, Vec yc);
+
+  /** yf = P xc */
+  void Prolongate(Vec xc, Vec yf);
+  /** yc = P^T xf */
+  void Restrict(Vec xf, Vec yc);
+
+  /** Position of the coarse system dof icol, not owned, in the ghost array */
+  unsigned GhostPosition(const int &icol) const;
+
+  /** Fill the stencil buffers of the pde variable k on the coarse element iel */
+  void GetElementStencil(const unsigned &k, const int &iel);
+
+  /** Create the shell with the fine and coarse system layouts */
+  static Mat CreateShell(const LinearEquation &lspdef, const LinearEquation &lspdec);
+
+  const LinearEquation &_lspdef;
+  const LinearEquation &_lspdec;
+  std::vector < unsigned > _solIndex;
+  std::vector < unsigned > _solType;
+
+  int _fineOffset, _fineOffsetp1;
+  int _coarseOffset, _coarseOffsetp1;
+
+  /** sorted coarse system dofs, not owned, touched by the owned coarse elements */
+  std::vector < PetscInt > _ghostColumns;
+  /** gathers the _ghostColumns entries of a coarse vector into _coarseGhost */
+  VecScatter _scatter;
+  Vec _coarseWork, _coarseGhost, _fineWork;
+
+  /** false on the zeroed rows and columns */
+  std::vector < bool > _fineMask, _coarseMask;
+
+  /** element stencil buffers */
+  std::vector < int > _rows, _cols;
+  std::vector < const int* > _stencilIndex;
+  std::vector < const double* > _stencilValue;
+  std::vector < bool > _visited;
+};
+
+} //end namespace femus
+
+#endif
+
+#endif
@@ -428,7 +428,7 @@ PetscVector& PetscVector::operator = (const PetscVector& v) {
   assert(this->_type == v._type);
   assert(this->size() == (int)v.size());
   assert(this->local_size() == v.local_size());
-  assert(this->_global_to_local_map == v._global_to_local_map);
+  assert(this->_ghost_global_index == v._ghost_global_index);
   if ((int)v.size() != 0)    {
     int ierr = 0;
     if (this->type() != GHOSTED)  {
@@ -26,6 +26,7 @@
 // C++ includes
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <cstdio>
 // Local includes
 #include "NumericVector.hpp"
@@ -188,6 +189,26 @@ public:
   /// operator() individually for each index.
   void get(const std::vector<int>& index, std::vector<double>& values) const;
 
+  /// Gathers the values of the \p n global dofs \p dofs into \p out.
+  void GetElementValues(const unsigned* dofs, const unsigned &n, double* out) const {
+    this->GetLocalView().GetValues(dofs, n, out);
+  }
+
+  /// Queries the array from Petsc and returns a read-only view on the local values.
+  NumericVectorLocalView GetLocalView() const;
+
+  /// Queries the array from Petsc and returns a writable pointer to the owned values.
+  double* GetOwnedArray();
+
+  /**
+   * Restores the array to Petsc and scatters the owned values to the ghost copies.
+   * A vector made with init(other) or VecDuplicate shares the ghost scatter of other: the updates
+   * of such vectors must not overlap, each UpdateGhostsEnd() has to come before the next UpdateGhostsBegin().
+   * Only vectors with distinct scatters, e.g. the _Sol of different variables, can be updated together.
+   */
+  void UpdateGhostsBegin();
+  void UpdateGhostsEnd();
+
   // ===========================
   // ALGEBRA FUNCTIONS
   // ===========================
@@ -296,11 +317,14 @@ private:
   /// doublehis pointer is only valid if \p _array_is_present is \p true.
   mutable PetscScalar* _values;
 
-  /// doubleype for map that maps global to local ghost cells.
-  typedef std::map<int,int> GlobalToLocalMap;
+  /// Sorted global indices of the ghost cells (empty if not in ghost cell mode)
+  std::vector<int> _ghost_global_index;
 
-  /// Map that maps global to local ghost cells (will be empty if not in ghost cell mode
-  GlobalToLocalMap _global_to_local_map;
+  /// Position in the ghost part of the local form of the ghost cells in \p _ghost_global_index
+  std::vector<int> _ghost_local_index;
+
+  /// Fills the flat global-to-local ghost table, \p ghost[i] being the i-th ghost cell
+  void _build_ghost_table(const std::vector<int>& ghost);
 
   /// doublehis boolean value should only be set to false
   /// for the constructor which takes a PETSc Vec object.
@@ -324,7 +348,8 @@ inline PetscVector::PetscVector (const ParallelType type)
   : _array_is_present(false),
     _local_form(NULL),
     _values(NULL),
-    _global_to_local_map(),
+    _ghost_global_index(),
+    _ghost_local_index(),
     _destroy_vec_on_exit(true) {
   this->_type = type;
 }
@@ -333,7 +358,8 @@ inline PetscVector::PetscVector (const int n,const ParallelType type)
   : _array_is_present(false),
     _local_form(NULL),
     _values(NULL),
-    _global_to_local_map(),
+    _ghost_global_index(),
+    _ghost_local_index(),
     _destroy_vec_on_exit(true) {
   this->init(n, n, false, type);
 }
@@ -344,7 +370,8 @@ inline PetscVector::PetscVector (const int n,
   : _array_is_present(false),
     _local_form(NULL),
     _values(NULL),
-    _global_to_local_map(),
+    _ghost_global_index(),
+    _ghost_local_index(),
     _destroy_vec_on_exit(true) {
   this->init(n, n_local, false, type);
 }
@@ -356,7 +383,8 @@ inline PetscVector::PetscVector (const int n,
   : _array_is_present(false),
     _local_form(NULL),
     _values(NULL),
-    _global_to_local_map(),
+    _ghost_global_index(),
+    _ghost_local_index(),
     _destroy_vec_on_exit(true) {
   this->init(n, n_local, ghost, false, type);
 }
@@ -365,7 +393,8 @@ inline PetscVector::PetscVector (Vec v)
   : _array_is_present(false),
     _local_form(NULL),
     _values(NULL),
-    _global_to_local_map(),
+    _ghost_global_index(),
+    _ghost_local_index(),
     _destroy_vec_on_exit(false) {
   this->_vec = v;
   this->_is_closed = true;
@@ -409,7 +438,6 @@ inline PetscVector::PetscVector (Vec v)
 
     // If is a sparsely stored vector, set up our new mapping
     if (mapping) {
-      const unsigned int local_size = static_cast<unsigned int>(petsc_local_size);
       const unsigned int ghost_begin = static_cast<unsigned int>(petsc_local_size);
 #if PETSC_VERSION_RELEASE && PETSC_VERSION_LESS_THAN(3,4,0)
       const numeric_index_type ghost_end = static_cast<numeric_index_type>(mapping->n);
@@ -426,8 +454,8 @@ inline PetscVector::PetscVector (Vec v)
       ierr = ISLocalToGlobalMappingGetIndices(mapping,&indices);
       CHKERRABORT(MPI_COMM_WORLD,ierr);
 #endif
-      for(unsigned int i=ghost_begin; i<ghost_end; i++)
-        _global_to_local_map[indices[i]] = i-local_size;
+      std::vector<int> ghost(indices + ghost_begin, indices + ghost_end);
+      _build_ghost_table(ghost);
       this->_type = GHOSTED;
 #if !PETSC_VERSION_RELEASE || !PETSC_VERSION_LESS_THAN(3,1,1)
       ierr = ISLocalToGlobalMappingRestoreIndices(mapping, &indices);
@@ -539,10 +567,8 @@ inline void PetscVector::init (const int n,
   assert(type == AUTOMATIC || type == GHOSTED);
   this->_type = GHOSTED;
 
-  /* Make the global-to-local ghost cell map.  */
-  for (int i=0; i<(int)ghost.size(); i++){
-    _global_to_local_map[ghost[i]] = i;
-  }
+  /* Make the global-to-local ghost cell table.  */
+  _build_ghost_table(ghost);
 
   /* Create vector.  */
   ierr = VecCreateGhost (MPI_COMM_WORLD, petsc_n_local, petsc_n,
@@ -568,7 +594,8 @@ inline void PetscVector::init(const NumericVector& other, const bool fast) {
     v._restore_array();
   }
 
-  this->_global_to_local_map = v._global_to_local_map;
+  this->_ghost_global_index = v._ghost_global_index;
+  this->_ghost_local_index = v._ghost_local_index;
   this->_is_closed      = v._is_closed;
   this->_is_initialized = v._is_initialized;
   this->_type = v._type;
@@ -607,7 +634,8 @@ inline void PetscVector::clear () {
     CHKERRABORT(MPI_COMM_WORLD,ierr);
   }
   this->_is_closed = this->_is_initialized = false;
-  _global_to_local_map.clear();
+  _ghost_global_index.clear();
+  _ghost_local_index.clear();
 }
 
 
@@ -692,9 +720,9 @@ inline int PetscVector::map_global_to_local_index (const int i) const {
     return i-first;
   }
 
-  GlobalToLocalMap::const_iterator it = _global_to_local_map.find(i);
-  assert (it!=_global_to_local_map.end());
-  return it->second+last-first;
+  std::vector<int>::const_iterator it = std::lower_bound(_ghost_global_index.begin(), _ghost_global_index.end(), i);
+  assert (it!=_ghost_global_index.end() && *it == i);
+  return _ghost_local_index[it - _ghost_global_index.begin()]+last-first;
 }
 
 
@@ -756,13 +784,66 @@ inline void PetscVector::swap (NumericVector &other) {
   PetscVector& v = libmeshM_cast_ref<PetscVector&>(other);
   std::swap(_vec, v._vec);
   std::swap(_destroy_vec_on_exit, v._destroy_vec_on_exit);
-  std::swap(_global_to_local_map, v._global_to_local_map);
+  std::swap(_ghost_global_index, v._ghost_global_index);
+  std::swap(_ghost_local_index, v._ghost_local_index);
   std::swap(_array_is_present, v._array_is_present);
   std::swap(_local_form, v._local_form);
   std::swap(_values, v._values);
 }
 
 
+inline NumericVectorLocalView PetscVector::GetLocalView() const {
+  this->_get_array();
+
+  int ierr=0, petsc_first=0, petsc_last=0;
+  ierr = VecGetOwnershipRange (_vec, &petsc_first, &petsc_last);
+  CHKERRABORT(MPI_COMM_WORLD,ierr);
+
+  const unsigned n_ghost = _ghost_global_index.size();
+  return NumericVectorLocalView(reinterpret_cast<const double*>(_values), petsc_first, petsc_last,
+                                (n_ghost > 0) ? &_ghost_global_index[0] : NULL,
+                                (n_ghost > 0) ? &_ghost_local_index[0] : NULL, n_ghost);
+}
+
+
+inline void PetscVector::_build_ghost_table(const std::vector<int>& ghost) {
+  std::vector< std::pair<int,int> > table(ghost.size());
+  for (unsigned i=0; i<ghost.size(); i++) {
+    table[i] = std::make_pair(ghost[i], static_cast<int>(i));
+  }
+  std::sort(table.begin(), table.end());
+
+  _ghost_global_index.resize(table.size());
+  _ghost_local_index.resize(table.size());
+  for (unsigned i=0; i<table.size(); i++) {
+    _ghost_global_index[i] = table[i].first;
+    _ghost_local_index[i] = table[i].second;
+  }
+}
+
+
+inline double* PetscVector::GetOwnedArray() {
+  this->_get_array();
+  return _values;
+}
+
+
+inline void PetscVector::UpdateGhostsBegin() {
+  this->_restore_array();
+  if (this->type() == GHOSTED) {
+    int ierr = VecGhostUpdateBegin(_vec,INSERT_VALUES,SCATTER_FORWARD);  	CHKERRABORT(MPI_COMM_WORLD,ierr);
+  }
+}
+
+
+inline void PetscVector::UpdateGhostsEnd() {
+  if (this->type() == GHOSTED) {
+    int ierr = VecGhostUpdateEnd(_vec,INSERT_VALUES,SCATTER_FORWARD);  	CHKERRABORT(MPI_COMM_WORLD,ierr);
+  }
+  this->_is_closed = true;
+}
+
+
 inline void PetscVector::_get_array(void) const {
   assert (this->initialized());
   if (!_array_is_present) {
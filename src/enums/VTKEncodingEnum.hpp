@@ -0,0 +1,9 @@
+#ifndef __femus_enums_VTKEncodingEnum_hpp__
+#define __femus_enums_VTKEncodingEnum_hpp__
+
+enum  VTKEncodingEnum {VTK_BASE64=0,   // inline base64 data arrays
+                       VTK_RAW,        // appended raw binary data arrays
+                       VTK_ZLIB };     // appended zlib compressed data arrays
+
+
+#endif
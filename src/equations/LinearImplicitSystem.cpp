@@ -18,10 +18,23 @@
 #include "SparseMatrix.hpp"
 #include "NumericVector.hpp"
 #include "ElemType.hpp"
+#include "PetscMatrixFreeProlongation.hpp"
 #include <iomanip>
+#include <sstream>
 
 namespace femus {
 
+  namespace {
+
+    /** Profiler phase of a multigrid level */
+    std::string LevelPhase(const char phase[], const unsigned &level) {
+      std::ostringstream name;
+      name << phase << " level " << level;
+      return name.str();
+    }
+
+  }
+
   // ********************************************
 
   LinearImplicitSystem::LinearImplicitSystem(MultiLevelProblem& ml_probl,
@@ -41,6 +54,12 @@ namespace femus {
     _SmootherType(smoother_type),
     _MGmatrixFineReuse(false),
     _MGmatrixCoarseReuse(false),
+    _matrixFreeProlongation(false),
+    _rtol(1.e-5),
+    _atol(1.e-50),
+    _divtol(1.e+5),
+    _maxits(1000),
+    _restart(30),
     _printSolverInfo(false),
     _assembleMatrix(true) {
     _SparsityPattern.resize(0);
@@ -90,6 +109,8 @@ namespace femus {
 
   void LinearImplicitSystem::init() {
 
+    _profiler.Start("sparsity setup");
+
     _LinSolver.resize(_gridn);
 
     _LinSolver[0] = LinearEquationSolver::build(0, _solution[0], GMRES_SMOOTHER).release();
@@ -103,6 +124,9 @@ namespace femus {
                              _ml_sol->GetSolName(), &_solution[i]->_Bdc, _gridn, _SparsityPattern);
     }
 
+    _profiler.Stop("sparsity setup");
+    _profiler.Start("prolongator setup");
+
     _PP.resize(_gridn);
     _RR.resize(_gridn);
     for(unsigned i = 0; i < _gridn; i++) {
@@ -110,6 +134,17 @@ namespace femus {
       _RR[i] = NULL;
     }
 
+    if(_matrixFreeProlongation) {
+      bool homogeneous = !_AMRtest;
+      for(unsigned ig = 0; ig < _gridn; ig++) {
+        if(!_ml_msh->GetLevel(ig)->GetIfHomogeneous()) homogeneous = false;
+      }
+      if(!homogeneous) {
+        std::cout << "Warning! Matrix free prolongation is not available with AMR, the prolongators are assembled" << std::endl;
+        _matrixFreeProlongation = false;
+      }
+    }
+
     for(unsigned ig = 1; ig < _gridn; ig++) {
       BuildProlongatorMatrix(ig);
     }
@@ -135,6 +170,7 @@ namespace femus {
       ZeroInterpolatorDirichletNodes(ig);
     }
 
+    _profiler.Stop("prolongator setup");
 
     _NSchurVar_test = 0;
     _numblock_test = 0;
@@ -149,7 +185,7 @@ namespace femus {
 
   void LinearImplicitSystem::solve(const MgSmootherType& mgSmootherType) {
 
-    clock_t start_mg_time = clock();
+    _profiler.Start("linear solve");
 
     unsigned grid0;
 
@@ -176,7 +212,7 @@ namespace femus {
 
       if(ThisIsAMR) _solution[igridn]->InitAMREps();
 
-      clock_t start_assembly_time = clock();
+      _profiler.Start("assembly");
 
       _levelToAssemble = igridn; //Be carefull!!!! this is needed in the _assemble_function
       _LinSolver[igridn]->SetResZero();
@@ -197,11 +233,13 @@ namespace femus {
           _LinSolver[igridn]->_KK->matrix_ABC(*_RRamr[igridn], *_LinSolver[igridn]->_KKamr, *_PPamr[igridn], false);
         }
       }
+      double assemblyTime = _profiler.Stop("assembly");
 
-
+      _profiler.Start("coarse operators");
       _MGmatrixFineReuse = false;
       _MGmatrixCoarseReuse = (igridn - grid0 > 0) ?  true : _MGmatrixFineReuse;
-      for(unsigned i = igridn; i > 0; i--) {
+      if(_matrixFreeProlongation) AssembleCoarseOperators(igridn);
+      else for(unsigned i = igridn; i > 0; i--) {
         if(_RR[i]) {
           if(i == igridn)
             _LinSolver[i - 1u]->_KK->matrix_ABC(*_RR[i], *_LinSolver[i]->_KK, *_PP[i], _MGmatrixFineReuse);
@@ -226,9 +264,12 @@ namespace femus {
         }
       }
 
-      std::cout << std::endl << " ****** Level Max " << igridn + 1 << " ASSEMBLY TIME:\t" << static_cast<double>((clock() - start_assembly_time)) / CLOCKS_PER_SEC << std::endl;
+      assemblyTime += _profiler.Stop("coarse operators");
+
+      std::cout << std::endl << " ****** Level Max " << igridn + 1 << " ASSEMBLY TIME:\t" << assemblyTime << std::endl;
 
       if(_MGsolver) {
+        _profiler.Start("KSP setup");
         _LinSolver[igridn]->MGInit(mgSmootherType, igridn + 1, _outer_ksp_solver.c_str());
 
         for(unsigned i = 0; i < igridn + 1; i++) {
@@ -237,6 +278,7 @@ namespace femus {
           else
             _LinSolver[i]->MGSetLevel(_LinSolver[igridn], igridn, _VariablesToBeSolvedIndex, _PP[i], _PP[i], _npre, _npost);
         }
+        _profiler.Stop("KSP setup");
 
         MGVcycle(igridn, mgSmootherType);
 
@@ -256,8 +298,20 @@ namespace femus {
 
     }
 
+    double solveTime = _profiler.Stop("linear solve");
     std::cout << std::endl << " *** Linear " << _solverType << " TIME: " << std::setw(11) << std::setprecision(6) << std::fixed
-              << static_cast<double>((clock() - start_mg_time)) / CLOCKS_PER_SEC << std::endl;
+              << solveTime << std::endl;
+
+    WriteProfilerOutput();
+  }
+
+  // ********************************************
+
+  void LinearImplicitSystem::WriteProfilerOutput() const {
+    if(_profilerOutput.empty()) return;
+    _profiler.PrintSummary();
+    _profiler.WriteJson(_profilerOutput + ".json");
+    _profiler.WriteCsv(_profilerOutput + ".csv");
   }
 
   // ********************************************
@@ -304,7 +358,7 @@ namespace femus {
 
   bool LinearImplicitSystem::MGVcycle(const unsigned& level, const MgSmootherType& mgSmootherType) {
 
-    clock_t start_mg_time = clock();
+    _profiler.Start("linear cycle");
 
     _LinSolver[level]->SetEpsZero();
 
@@ -314,7 +368,9 @@ namespace femus {
 
       std::cout << "       *************** Linear iteration " << linearIterator + 1 << " ***********" << std::endl;
       bool ksp_clean = !linearIterator * _assembleMatrix;
+      _profiler.Start("KSP solve");
       _LinSolver[level]->MGSolve(ksp_clean);
+      _profiler.Stop("KSP solve");
       _solution[level]->UpdateRes(_SolSystemPdeIndex, _LinSolver[level]->_RES, _LinSolver[level]->KKoffset);
       linearIsConverged = IsLinearConverged(level);
 
@@ -325,10 +381,13 @@ namespace femus {
       (_LinSolver[level]->_EPSC)->matrix_mult(*_LinSolver[level]->_EPS, *_PPamr[level]);
       *(_LinSolver[level]->_EPS) = *(_LinSolver[level]->_EPSC);
     }
+    _profiler.Start("UpdateSol");
     _solution[level]->UpdateSol(_SolSystemPdeIndex, _LinSolver[level]->_EPS, _LinSolver[level]->KKoffset);
+    _profiler.Stop("UpdateSol");
 
+    double cycleTime = _profiler.Stop("linear cycle");
     std::cout << "       *************** Linear-Cycle TIME:\t" << std::setw(11) << std::setprecision(6) << std::fixed
-              << static_cast<double>((clock() - start_mg_time)) / CLOCKS_PER_SEC << std::endl;
+              << cycleTime << std::endl;
     return linearIsConverged;
   }
 
@@ -336,7 +395,7 @@ namespace femus {
 
   bool LinearImplicitSystem::MLVcycle(const unsigned& level) {
 
-    clock_t start_mg_time = clock();
+    _profiler.Start("linear cycle");
 
     _LinSolver[level]->SetEpsZero();
 
@@ -350,24 +409,34 @@ namespace femus {
 
       for(unsigned ig = level; ig > 0; ig--) {
         // ============== Presmoothing ==============
+        _profiler.Start(LevelPhase("smoothing", ig));
         for(unsigned k = 0; k < _npre; k++) {
           _LinSolver[ig]->Solve(_VariablesToBeSolvedIndex, ksp_clean * (!k));
         }
+        _profiler.Stop(LevelPhase("smoothing", ig));
         // ============== Restriction ==============
+        _profiler.Start(LevelPhase("restriction", ig));
         Restrictor(ig);
+        _profiler.Stop(LevelPhase("restriction", ig));
       }
 
       // ============== Direct Solver ==============
+      _profiler.Start("coarse solve");
       _LinSolver[0]->Solve(_VariablesToBeSolvedIndex, ksp_clean);
+      _profiler.Stop("coarse solve");
 
       for(unsigned ig = 1; ig <= level; ig++) {
         // ============== Prolongation ==============
+        _profiler.Start(LevelPhase("prolongation", ig));
         Prolongator(ig);
+        _profiler.Stop(LevelPhase("prolongation", ig));
 
         // ============== PostSmoothing ==============
+        _profiler.Start(LevelPhase("smoothing", ig));
         for(unsigned k = 0; k < _npost; k++) {
           _LinSolver[ig]->Solve(_VariablesToBeSolvedIndex, ksp_clean * (!_npre) * (!k));
         }
+        _profiler.Stop(LevelPhase("smoothing", ig));
       }
 
       // ============== Update Fine Residual ==============
@@ -381,10 +450,13 @@ namespace femus {
       (_LinSolver[level]->_EPSC)->matrix_mult(*_LinSolver[level]->_EPS, *_PPamr[level]);
       *(_LinSolver[level]->_EPS) = *(_LinSolver[level]->_EPSC);
     }
+    _profiler.Start("UpdateSol");
     _solution[level]->UpdateSol(_SolSystemPdeIndex, _LinSolver[level]->_EPS, _LinSolver[level]->KKoffset);
+    _profiler.Stop("UpdateSol");
 
+    double cycleTime = _profiler.Stop("linear cycle");
     std::cout << "\n ************ Linear-Cycle TIME:\t" << std::setw(11) << std::setprecision(6) << std::fixed
-              << static_cast<double>((clock() - start_mg_time)) / CLOCKS_PER_SEC << std::endl;
+              << cycleTime << std::endl;
 
     return linearIsConverged;
   }
@@ -560,6 +632,15 @@ namespace femus {
       exit(0);
     }
 
+    if(_matrixFreeProlongation) {
+      vector <unsigned> solType(_SolSystemPdeIndex.size());
+      for(unsigned k = 0; k < _SolSystemPdeIndex.size(); k++) {
+        solType[k] = _ml_sol->GetSolutionType(_SolSystemPdeIndex[k]);
+      }
+      _PP[gridf] = new PetscMatrixFreeProlongation(*_LinSolver[gridf], *_LinSolver[gridf - 1], _SolSystemPdeIndex, solType);
+      return;
+    }
+
     int iproc;
     MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
 
@@ -770,15 +851,22 @@ namespace femus {
     dirichletNodeIndex.resize(count);
     std::vector < PetscInt >(dirichletNodeIndex).swap(dirichletNodeIndex);
     std::sort(dirichletNodeIndex.begin(), dirichletNodeIndex.end());
-    _PP[level]->mat_zero_rows(dirichletNodeIndex, 0);
 
-    if(_RR[level]) {
-      SparseMatrix *RRt;
-      RRt = SparseMatrix::build().release();
-      _RR[level]->get_transpose(*RRt);
-      RRt->mat_zero_rows(dirichletNodeIndex, 0);
-      RRt->get_transpose(*_RR[level]);
-      delete RRt;
+    std::vector < int > fineDirichletNodeIndex;
+    if(_matrixFreeProlongation) {
+      fineDirichletNodeIndex.swap(dirichletNodeIndex);
+    }
+    else {
+      _PP[level]->mat_zero_rows(dirichletNodeIndex, 0);
+
+      if(_RR[level]) {
+        SparseMatrix *RRt;
+        RRt = SparseMatrix::build().release();
+        _RR[level]->get_transpose(*RRt);
+        RRt->mat_zero_rows(dirichletNodeIndex, 0);
+        RRt->get_transpose(*_RR[level]);
+        delete RRt;
+      }
     }
 
     // Delete the Dirichlet nodes of the coarse level (level-1):
@@ -812,6 +900,11 @@ namespace femus {
     std::vector < PetscInt >(dirichletNodeIndex).swap(dirichletNodeIndex);
     std::sort(dirichletNodeIndex.begin(), dirichletNodeIndex.end());
 
+    if(_matrixFreeProlongation) {
+      static_cast< PetscMatrixFreeProlongation* >(_PP[level])->ZeroRowsAndColumns(fineDirichletNodeIndex, dirichletNodeIndex);
+      return;
+    }
+
     SparseMatrix *PPt;
     PPt = SparseMatrix::build().release();
     _PP[level]->get_transpose(*PPt);
@@ -827,6 +920,19 @@ namespace femus {
 
   // ********************************************
 
+  void LinearImplicitSystem::AssembleCoarseOperators(const unsigned &igridn) {
+
+    // the Galerkin products need the entries of the prolongators, the coarse operators are rediscretized instead
+    for(unsigned i = 0; i < igridn; i++) {
+      _levelToAssemble = i;
+      _LinSolver[i]->SetResZero();
+      _assemble_system_function(_equation_systems);
+    }
+    _levelToAssemble = igridn;
+  }
+
+  // ********************************************
+
   void LinearImplicitSystem::SetDirichletBCsHandling(const DirichletBCType DirichletMode) {
 
     if(DirichletMode == PENALTY) {
@@ -25,6 +25,7 @@
 #include "DirichletBCTypeEnum.hpp"
 #include "MgSmootherEnum.hpp"
 #include "FemusDefault.hpp"
+#include "Profiler.hpp"
 
 #include <petscksp.h>
 
@@ -179,6 +180,12 @@ namespace femus {
         _npost = npost;
       };
 
+      /** Apply the prolongators and their transposes matrix free instead of assembling them: the coarse operators
+       * are then rediscretized on each level. To be set before init(), it is ignored on AMR hierarchies */
+      void SetMatrixFreeProlongation(const bool &matrixFreeProlongation = true) {
+        _matrixFreeProlongation = matrixFreeProlongation;
+      };
+
       /** enforce sparcity pattern for setting uncoupled variables and save on memory allocation **/
       void SetSparsityPattern(vector < bool > other_sparcity_pattern);
 
@@ -196,6 +203,22 @@ namespace femus {
         return _RR;
       }
 
+      /** Wall-clock timers of the solver phases: setup, assembly, coarse operators, KSP setup and solve,
+       * smoothing, restriction and prolongation per level, solution update */
+      Profiler &GetProfiler() {
+        return _profiler;
+      }
+
+      /** At the end of every MGsolve print the profiler summary and write it to filename.json and filename.csv,
+       * an empty filename (default) disables the output */
+      void SetProfilerOutput(const std::string &filename) {
+        _profilerOutput = filename;
+      }
+
+      /** Print and write the profiler summary if SetProfilerOutput has been called, e.g. again after the
+       * output phases timed by Writer::SetProfiler (collective) */
+      void WriteProfilerOutput() const;
+
     protected:
 
       vector < SparseMatrix* > _PP, _RR; 
@@ -222,6 +245,9 @@ namespace femus {
       virtual void BuildProlongatorMatrix(unsigned gridf);
       virtual void BuildAmrProlongatorMatrix( unsigned level);
       void ZeroInterpolatorDirichletNodes(const unsigned &level);
+
+      /** Assemble the operators of the levels coarser than igridn, in place of the Galerkin products */
+      void AssembleCoarseOperators(const unsigned &igridn);
       
       // member data
       /** The number of linear iterations required to solve the linear system Ax=b. */
@@ -252,6 +278,7 @@ namespace femus {
       MgSmoother _SmootherType;
       bool _MGmatrixFineReuse;
       bool _MGmatrixCoarseReuse;
+      bool _matrixFreeProlongation;
 
       /** To be Added */
       vector <unsigned> _VariablesToBeSolvedIndex;
@@ -282,6 +309,9 @@ namespace femus {
       double _richardsonScaleFactor;
       bool _richardsonScaleFactorIsSet;
 
+      Profiler _profiler;
+      std::string _profilerOutput;
+
   };
 
 } //end namespace femus
@@ -56,6 +56,9 @@ namespace femus {
       exit(0);
     }
 
+    // the solid/fluid coupled prolongator and restrictor are always assembled
+    _matrixFreeProlongation = false;
+
     int iproc;
     MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
 
@@ -17,6 +17,7 @@
 #include "LinearEquationSolver.hpp"
 #include "NumericVector.hpp"
 #include "iomanip"
+#include <cmath>
 
 namespace femus {
 
@@ -31,7 +32,16 @@ namespace femus {
     _n_max_nonlinear_iterations(15),
     _final_nonlinear_residual(1.e20),
     _max_nonlinear_convergence_tolerance(1.e-6),
-    _maxNumberOfResidualUpdateIterations(1)
+    _maxNumberOfResidualUpdateIterations(1),
+    _jacobianLag(1),
+    _coarseOperatorLag(1),
+    _linearIterationGrowth(0.),
+    _inexactNewton(false),
+    _eta0(0.5),
+    _etaMax(0.9),
+    _lineSearch(false),
+    _maxLineSearchIterations(5),
+    _jacobianFreeNewton(false)
   {
 
   }
@@ -84,9 +94,41 @@ namespace femus {
 
   // ********************************************
 
+  void NonLinearImplicitSystem::AssembleResidual(const unsigned &igridn) {
+
+    {
+      ScopedTimer timer(_profiler, "residual assembly");
+      _levelToAssemble = igridn;
+      _LinSolver[igridn]->SetResZero();
+      _assembleMatrix = false;
+      _assemble_system_function(_equation_systems);
+    }
+
+    if(!_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
+      if(!_RRamr[igridn]) {
+        (_LinSolver[igridn]->_RESC)->matrix_mult_transpose(*_LinSolver[igridn]->_RES, *_PPamr[igridn]);
+      }
+      else {
+        (_LinSolver[igridn]->_RESC)->matrix_mult(*_LinSolver[igridn]->_RES, *_RRamr[igridn]);
+      }
+      *(_LinSolver[igridn]->_RES) = *(_LinSolver[igridn]->_RESC);
+    }
+  }
+
+  // ********************************************
+
+  void NonLinearImplicitSystem::MatrixFreeResidual(void *system) {
+    NonLinearImplicitSystem* nonLinearSystem = static_cast< NonLinearImplicitSystem* >(system);
+    bool assembleMatrix = nonLinearSystem->_assembleMatrix;
+    nonLinearSystem->AssembleResidual(nonLinearSystem->_levelToAssemble);
+    nonLinearSystem->_assembleMatrix = assembleMatrix;
+  }
+
+  // ********************************************
+
   void NonLinearImplicitSystem::solve(const MgSmootherType& mgSmootherType) {
 
-    clock_t start_mg_time = clock();
+    _profiler.Start("nonlinear solve");
 
     double totalAssembyTime = 0.;
 
@@ -105,24 +147,63 @@ namespace femus {
       abort();
     }
 
+    // the line search scales the correction stored in _Eps, which is the whole Newton step only if the residual
+    // is not updated inside the nonlinear iteration
+    bool lineSearch = _lineSearch;
+    if(lineSearch && _maxNumberOfResidualUpdateIterations > 1) {
+      std::cout << "Warning: the line search is disabled, it requires a single residual update per nonlinear iteration" << std::endl;
+      lineSearch = false;
+    }
+
     unsigned AMRCounter = 0;
 
     for(unsigned igridn = grid0; igridn < _gridn; igridn++) {     //_igridn
       std::cout << std::endl << "   ****** Start Level Max " << igridn + 1 << " ******" << std::endl;
-      clock_t start_nl_time = clock();
+      _profiler.Start("nonlinear cycle");
 
       bool ThisIsAMR = (_mg_type == F_CYCLE && _AMRtest &&  AMRCounter < _maxAMRlevels && igridn == _gridn - 1u) ? 1 : 0;
 
       if(ThisIsAMR) _solution[igridn]->InitAMREps();
 
+      // nonlinear iterations since the last Jacobian assembly and Jacobian assemblies since the last coarse operator rebuild
+      unsigned jacobianAge = 0;
+      unsigned coarseOperatorAge = 0;
+      unsigned referenceLinearIterations = 0;
+      bool forceRebuild = false;
+      bool mgIsInitialized = false;
+
+      // Eisenstat-Walker forcing term and residual norm of the previous nonlinear iteration
+      double eta = _eta0;
+      double residualNormOld = 0.;
+      const double linearAbsoluteConvergenceTolerance = _linearAbsoluteConvergenceTolerance;
+
+      bool jacobianFreeNewton = _jacobianFreeNewton && _MGsolver && _ml_msh->GetLevel(igridn)->GetIfHomogeneous();
+      if(jacobianFreeNewton) {
+        _LinSolver[igridn]->SetMatrixFreeJacobian(MatrixFreeResidual, this);
+      }
+      else if(_jacobianFreeNewton) {
+        std::cout << "   ********* Level Max " << igridn + 1 << " Jacobian-free Newton-Krylov skipped, the assembled Jacobian is used" << std::endl;
+      }
+
       for(unsigned nonLinearIterator = 0; nonLinearIterator < _n_max_nonlinear_iterations; nonLinearIterator++) {
 
         std::cout << std::endl << "   ********* Nonlinear iteration " << nonLinearIterator + 1 << " *********" << std::endl;
 
-        clock_t start_assembly_time = clock();
+        bool fullRebuild = (0 == nonLinearIterator || forceRebuild);
+        bool assembleJacobian = _buildSolver && (fullRebuild || jacobianAge >= _jacobianLag);
+        bool buildCoarseOperators = assembleJacobian && (fullRebuild || coarseOperatorAge + 1 >= _coarseOperatorLag);
+        forceRebuild = false;
+
+        if(assembleJacobian) {
+          jacobianAge = 0;
+          coarseOperatorAge = (buildCoarseOperators) ? 0 : coarseOperatorAge + 1;
+        }
+        jacobianAge++;
+
+        _profiler.Start("assembly");
         _levelToAssemble = igridn; //Be carefull!!!! this is needed in the _assemble_function
         _LinSolver[igridn]->SetResZero();
-        _assembleMatrix = _buildSolver;
+        _assembleMatrix = assembleJacobian;
         _assemble_system_function(_equation_systems);
 
         if(!_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
@@ -134,12 +215,14 @@ namespace femus {
           }
           *(_LinSolver[igridn]->_RES) = *(_LinSolver[igridn]->_RESC);
         }
+        double assemblyTime = _profiler.Stop("assembly");
 
-        if(_buildSolver) {
+        if(assembleJacobian) {
 
           _MGmatrixFineReuse = (0 == nonLinearIterator) ? false : true;
           _MGmatrixCoarseReuse = (igridn - grid0 > 0) ?  true : _MGmatrixFineReuse;
 
+          _profiler.Start("coarse operators");
           if(!_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
             _LinSolver[igridn]->SwapMatrices();
             if(!_RRamr[igridn]) {
@@ -150,52 +233,94 @@ namespace femus {
             }
           }
 
-          clock_t mg_proj_mat_time = clock();
-          for(unsigned i = igridn; i > 0; i--) {
-            if(_RR[i]) {
-              if(i == igridn)
-                _LinSolver[i - 1u]->_KK->matrix_ABC(*_RR[i], *_LinSolver[i]->_KK, *_PP[i], _MGmatrixFineReuse);
-              else {
-                _LinSolver[i - 1u]->_KK->matrix_ABC(*_RR[i], *_LinSolver[i]->_KK, *_PP[i], _MGmatrixCoarseReuse);
-                if(_LinSolver[i - 1u]->_KKamr) {
-                  delete _LinSolver[i - 1u]->_KKamr;
-                  _LinSolver[i - 1u]->_KKamr = NULL;
+          if(buildCoarseOperators) {
+            if(_matrixFreeProlongation) AssembleCoarseOperators(igridn);
+            else for(unsigned i = igridn; i > 0; i--) {
+              if(_RR[i]) {
+                if(i == igridn)
+                  _LinSolver[i - 1u]->_KK->matrix_ABC(*_RR[i], *_LinSolver[i]->_KK, *_PP[i], _MGmatrixFineReuse);
+                else {
+                  _LinSolver[i - 1u]->_KK->matrix_ABC(*_RR[i], *_LinSolver[i]->_KK, *_PP[i], _MGmatrixCoarseReuse);
+                  if(_LinSolver[i - 1u]->_KKamr) {
+                    delete _LinSolver[i - 1u]->_KKamr;
+                    _LinSolver[i - 1u]->_KKamr = NULL;
+                  }
                 }
               }
-            }
-            else {
-              if(i == igridn)
-                _LinSolver[i - 1u]->_KK->matrix_PtAP(*_PP[i], *_LinSolver[i]->_KK, _MGmatrixFineReuse);
               else {
-                _LinSolver[i - 1u]->_KK->matrix_PtAP(*_PP[i], *_LinSolver[i]->_KK, _MGmatrixCoarseReuse);
-                if(_LinSolver[i - 1u]->_KKamr) {
-                  delete _LinSolver[i - 1u]->_KKamr;
-                  _LinSolver[i - 1u]->_KKamr = NULL;
+                if(i == igridn)
+                  _LinSolver[i - 1u]->_KK->matrix_PtAP(*_PP[i], *_LinSolver[i]->_KK, _MGmatrixFineReuse);
+                else {
+                  _LinSolver[i - 1u]->_KK->matrix_PtAP(*_PP[i], *_LinSolver[i]->_KK, _MGmatrixCoarseReuse);
+                  if(_LinSolver[i - 1u]->_KKamr) {
+                    delete _LinSolver[i - 1u]->_KKamr;
+                    _LinSolver[i - 1u]->_KKamr = NULL;
+                  }
                 }
               }
             }
           }
+          double coarseOperatorsTime = _profiler.Stop("coarse operators");
+          assemblyTime += coarseOperatorsTime;
           std::cout << "   ********* Level Max " << igridn + 1 << " MG PROJECTION MATRICES TIME:\t" \
-                    << static_cast<double>((clock() - mg_proj_mat_time)) / CLOCKS_PER_SEC << std::endl;
+                    << coarseOperatorsTime << std::endl;
 
-          clock_t mg_init_time = clock();
+          _profiler.Start("KSP setup");
           if(_MGsolver) {
-            _LinSolver[igridn]->MGInit(mgSmootherType, igridn + 1, _outer_ksp_solver.c_str());
+            // with lagged coarse operators the KSP and the coarse level solvers are kept, only the finest level is reset
+            unsigned levelStart = igridn;
+            if(buildCoarseOperators || !mgIsInitialized) {
+              if(mgIsInitialized) _LinSolver[igridn]->MGClear();
+              _LinSolver[igridn]->MGInit(mgSmootherType, igridn + 1, _outer_ksp_solver.c_str());
+              mgIsInitialized = true;
+              levelStart = 0;
+            }
 
-            for(unsigned i = 0; i <= igridn; i++) {
+            for(unsigned i = levelStart; i <= igridn; i++) {
               if(_RR[i])
                 _LinSolver[i]->MGSetLevel(_LinSolver[igridn], igridn, _VariablesToBeSolvedIndex, _PP[i], _RR[i], _npre, _npost);
               else
                 _LinSolver[i]->MGSetLevel(_LinSolver[igridn], igridn, _VariablesToBeSolvedIndex, _PP[i], _PP[i], _npre, _npost);
             }
           }
+          double kspSetupTime = _profiler.Stop("KSP setup");
+          assemblyTime += kspSetupTime;
           std::cout << "   ********* Level Max " << igridn + 1 << " MGINIT TIME:\t" \
-                    << static_cast<double>((clock() - mg_init_time)) / CLOCKS_PER_SEC << std::endl;
+                    << kspSetupTime << std::endl;
+        }
+        else if(_buildSolver && !_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
+          _LinSolver[igridn]->SwapMatrices();
         }
-        totalAssembyTime += static_cast<double>((clock() - start_assembly_time)) / CLOCKS_PER_SEC;
+        totalAssembyTime += assemblyTime;
         std::cout << "   ********* Level Max " << igridn + 1 << " ASSEMBLY TIME:\t" << \
-                  static_cast<double>((clock() - start_assembly_time)) / CLOCKS_PER_SEC << std::endl;
-        clock_t startUpdateResidualTime = clock();
+                  assemblyTime << std::endl;
+
+        if(jacobianFreeNewton) _LinSolver[igridn]->UpdateMatrixFreeJacobian();
+
+        double residualNorm = 0.;
+        if(_inexactNewton || lineSearch) {
+          residualNorm = _LinSolver[igridn]->_RES->l2_norm();
+        }
+
+        if(_inexactNewton) {
+          if(nonLinearIterator > 0 && residualNormOld > 0.) {
+            const double gamma = 0.9;
+            const double alpha = 0.5 * (1. + sqrt(5.));
+            double etaSafeguard = gamma * pow(eta, alpha);
+            eta = gamma * pow(residualNorm / residualNormOld, alpha);
+            if(etaSafeguard > 0.1 && etaSafeguard > eta) eta = etaSafeguard;
+            if(eta > _etaMax) eta = _etaMax;
+          }
+          if(eta < _rtol) eta = _rtol;
+          residualNormOld = residualNorm;
+
+          _LinSolver[igridn]->SetTolerances(eta, _atol, _divtol, _maxits, _restart);
+          _linearAbsoluteConvergenceTolerance = (eta * residualNorm > linearAbsoluteConvergenceTolerance) ?
+                                                eta * residualNorm : linearAbsoluteConvergenceTolerance;
+          std::cout << "   ********* Level Max " << igridn + 1 << " Eisenstat-Walker linear relative tolerance:\t" << eta << std::endl;
+        }
+
+        _profiler.Start("linear cycle + residual update");
 
         for(unsigned updateResidualIterator = 0; updateResidualIterator < _maxNumberOfResidualUpdateIterations; updateResidualIterator++) {
 
@@ -208,56 +333,84 @@ namespace femus {
 
           if(thisIsConverged || updateResidualIterator == _maxNumberOfResidualUpdateIterations - 1) break;
 
-          _LinSolver[igridn]->SetResZero();
-          _assembleMatrix = false;
-          _assemble_system_function(_equation_systems);
-          if(!_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
-            if(!_RRamr[igridn]) {
-              (_LinSolver[igridn]->_RESC)->matrix_mult_transpose(*_LinSolver[igridn]->_RES, *_PPamr[igridn]);
-            }
-            else {
-              (_LinSolver[igridn]->_RESC)->matrix_mult(*_LinSolver[igridn]->_RES, *_RRamr[igridn]);
-            }
-            *(_LinSolver[igridn]->_RES) = *(_LinSolver[igridn]->_RESC);
-          }
-
+          AssembleResidual(igridn);
+          if(jacobianFreeNewton) _LinSolver[igridn]->UpdateMatrixFreeJacobian();
         }
 
         if(_buildSolver) {
           if(!_ml_msh->GetLevel(igridn)->GetIfHomogeneous()) {
             _LinSolver[igridn]->SwapMatrices();
           }
-          if(_MGsolver) {
-            _LinSolver[igridn]->MGClear();
+          if(_MGsolver && _linearIterationGrowth > 0.) {
+            unsigned linearIterations = _LinSolver[igridn]->GetMGSolveIterationNumber();
+            if(buildCoarseOperators) referenceLinearIterations = linearIterations;
+            else if(linearIterations > _linearIterationGrowth * referenceLinearIterations) forceRebuild = true;
+          }
+        }
+
+        if(lineSearch) {
+          // backtracking on the residual norm with the quadratic model of ||F(x + lambda dx)||^2
+          _profiler.Start("line search");
+          double lambda = 1.;
+          for(unsigned lineSearchIterator = 0; lineSearchIterator < _maxLineSearchIterations; lineSearchIterator++) {
+            AssembleResidual(igridn);
+            double lineSearchNorm = _LinSolver[igridn]->_RES->l2_norm();
+            std::cout << "     ********* Line search lambda = " << lambda << " Res_l2norm = " << lineSearchNorm << std::endl;
+            if(lineSearchNorm <= (1. - 1.e-4 * lambda) * residualNorm) break;
+
+            double phi0 = residualNorm * residualNorm;
+            double lambdaNew = phi0 * lambda * lambda / (lineSearchNorm * lineSearchNorm - phi0 + 2. * phi0 * lambda);
+            if(lambdaNew < 0.1 * lambda) lambdaNew = 0.1 * lambda;
+            if(lambdaNew > 0.5 * lambda) lambdaNew = 0.5 * lambda;
+
+            _solution[igridn]->ScaleSolUpdate(_SolSystemPdeIndex, lambdaNew / lambda);
+            lambda = lambdaNew;
           }
+          _profiler.Stop("line search");
         }
 
         double nonLinearEps;
         bool nonLinearIsConverged = IsNonLinearConverged(igridn, nonLinearEps);
 
+        double updateResidualTime = _profiler.Stop("linear cycle + residual update");
         std::cout << "     ********* Linear Cycle + Residual Update-Cycle TIME:\t" << std::setw(11) << std::setprecision(6) << std::fixed
-                  << static_cast<double>((clock() - startUpdateResidualTime)) / CLOCKS_PER_SEC << std::endl;
+                  << updateResidualTime << std::endl;
 
         if(nonLinearIsConverged) break;
 
       }
 
+      if(mgIsInitialized) {
+        _LinSolver[igridn]->MGClear();
+      }
+
+      if(jacobianFreeNewton) {
+        _LinSolver[igridn]->SetMatrixFreeJacobian(NULL, NULL);
+      }
+
+      if(_inexactNewton) {
+        _LinSolver[igridn]->SetTolerances(_rtol, _atol, _divtol, _maxits, _restart);
+        _linearAbsoluteConvergenceTolerance = linearAbsoluteConvergenceTolerance;
+      }
+
       if(igridn + 1 < _gridn) ProlongatorSol(igridn + 1);
 
       if(ThisIsAMR) AddAMRLevel(AMRCounter);
 
 
+      double nonLinearTime = _profiler.Stop("nonlinear cycle");
       std::cout << std::endl << "   ****** Nonlinear-Cycle TIME: " << std::setw(11) << std::setprecision(6) << std::fixed
-                << static_cast<double>((clock() - start_nl_time)) / CLOCKS_PER_SEC << std::endl;
+                << nonLinearTime << std::endl;
 
       std::cout << std::endl << "   ****** End Level Max " << igridn + 1 << " ******" << std::endl;
     }
 
-    double totalSolverTime = static_cast<double>((clock() - start_mg_time)) / CLOCKS_PER_SEC;
+    double totalSolverTime = _profiler.Stop("nonlinear solve");
     std::cout << std::endl << "   *** Nonlinear " << _solverType << " TIME: " << std::setw(11) << std::setprecision(6) << std::fixed
               << totalSolverTime <<  " = assembly TIME( " << totalAssembyTime << " ) + "
               << " solver TIME( " << totalSolverTime - totalAssembyTime << " ) " << std::endl;
 
+    WriteProfilerOutput();
   }
 
 
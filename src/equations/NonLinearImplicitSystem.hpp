@@ -85,6 +85,43 @@ public:
       _linearAbsoluteConvergenceTolerance = tolerance;
     }
 
+    /** Lag the Jacobian and the Galerkin coarse operators across the nonlinear iterations: the fine Jacobian is
+     * assembled every jacobianLag iterations and the coarse operators are rebuilt every coarseOperatorLag Jacobian
+     * assemblies, keeping the multigrid KSP alive in between. Everything is rebuilt at the next iteration as soon as
+     * the outer Krylov iterations exceed linearIterationGrowth times those after the last full rebuild (0 disables it) */
+    void SetJacobianLagging(const unsigned &jacobianLag, const unsigned &coarseOperatorLag = 1, const double &linearIterationGrowth = 0.) {
+      _jacobianLag = (jacobianLag > 0) ? jacobianLag : 1;
+      _coarseOperatorLag = (coarseOperatorLag > 0) ? coarseOperatorLag : 1;
+      _linearIterationGrowth = linearIterationGrowth;
+    }
+
+    /** Inexact Newton: the relative tolerance of the linear solver is set at every nonlinear iteration with the
+     * Eisenstat-Walker formula (choice 2), starting from eta0, bounded from above by etaMax and from below by the rtol of SetTolerances */
+    void SetInexactNewton(const bool &inexactNewton = true, const double &eta0 = 0.5, const double &etaMax = 0.9) {
+      _inexactNewton = inexactNewton;
+      _eta0 = eta0;
+      _etaMax = etaMax;
+    }
+
+    /** Jacobian-free Newton-Krylov: the outer Krylov operator on the finest level is the finite-difference action of the
+     * residual assembly, so the matrix assembled by the assemble function is only used to build the multigrid preconditioner
+     * and can be a cheaper approximation of the Jacobian, e.g. a Picard or Oseen operator. It needs the MG solver and is
+     * skipped on the non-homogeneous AMR levels */
+    void SetJacobianFreeNewton(const bool &jacobianFreeNewton = true) {
+      _jacobianFreeNewton = jacobianFreeNewton;
+    }
+
+    bool GetJacobianFreeNewton() const {
+      return _jacobianFreeNewton;
+    }
+
+    /** Backtracking line search on the residual l2 norm, with at most maxIterations residual-only assemblies per Newton step.
+     * It is ignored if SetMaxNumberOfResidualUpdatesForNonlinearIteration is greater than one */
+    void SetLineSearch(const bool &lineSearch = true, const unsigned &maxIterations = 5) {
+      _lineSearch = lineSearch;
+      _maxLineSearchIterations = maxIterations;
+    }
+
 protected:
 
     /** The final residual for the nonlinear system R(x) */
@@ -98,6 +135,21 @@ protected:
 
     unsigned _maxNumberOfResidualUpdateIterations;
 
+    /** Jacobian and coarse operator lagging, see SetJacobianLagging */
+    unsigned _jacobianLag;
+    unsigned _coarseOperatorLag;
+    double _linearIterationGrowth;
+
+    /** Eisenstat-Walker forcing and line search, see SetInexactNewton and SetLineSearch */
+    bool _inexactNewton;
+    double _eta0;
+    double _etaMax;
+    bool _lineSearch;
+    unsigned _maxLineSearchIterations;
+
+    /** Jacobian-free Newton-Krylov, see SetJacobianFreeNewton */
+    bool _jacobianFreeNewton;
+
     /** Solves the system. */
     virtual void solve (const MgSmootherType& mgSmootherType = MULTIPLICATIVE);
 
@@ -106,6 +158,12 @@ private:
     /** To be Added */
     void CreateSystemPDEStructure();
 
+    /** Assembles only the residual on the level igridn, projected on the AMR constraints */
+    void AssembleResidual(const unsigned &igridn);
+
+    /** Residual callback of the matrix-free Jacobian, system is the NonLinearImplicitSystem */
+    static void MatrixFreeResidual(void *system);
+
 };
 
 
@@ -22,6 +22,7 @@
 #include "FETypeEnum.hpp"
 #include "Elem.hpp"
 #include "NumericVector.hpp"
+#include <algorithm>
 
 using std::cout;
 using std::endl;
@@ -37,6 +38,7 @@ namespace femus {
 //   Constructor
   elem_type::elem_type(const char* geom_elem, const char* order_gauss) : _gauss(geom_elem, order_gauss) {
     isMpGDAllocated = false;
+    _sumFactorized = false;
   }
 
 
@@ -245,6 +247,44 @@ namespace femus {
   }
 
 
+  void elem_type::GetProlongationStencil(const LinearEquation& lspdef, const LinearEquation& lspdec, const int& ielc,
+                                         const unsigned& index_sol, const unsigned& kkindex_sol,
+                                         vector < int >& rows, vector < int >& cols,
+                                         vector < const int* >& stencilIndex, vector < const double* >& stencilValue) const {
+
+    // identity stencils of a coarse element that is not refined: row i takes the coarse node i with weight 1
+    static const int identityIndex[28] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27};
+    static const double one = 1.;
+
+    cols.resize(_nc);
+    for(int j = 0; j < _nc; j++) {
+      cols[j] = lspdec.GetSystemDof(index_sol, kkindex_sol, j, ielc);
+    }
+
+    if(lspdec._msh->GetRefinedElementIndex(ielc)) {  // coarse2fine prolongation
+      rows.resize(_nf);
+      stencilIndex.resize(_nf + 1);
+      stencilValue.resize(_nf);
+      for(int i = 0; i < _nf; i++) {
+        rows[i] = lspdef.GetSystemDof(index_sol, kkindex_sol, ielc, _KVERT_IND[i][0], _KVERT_IND[i][1], lspdec._msh);
+        stencilIndex[i] = _prol_ind[i];
+        stencilValue[i] = _prol_val[i];
+      }
+      stencilIndex[_nf] = _prol_ind[_nf];
+    }
+    else {
+      rows.resize(_nc);
+      stencilIndex.resize(_nc + 1);
+      stencilValue.assign(_nc, &one);
+      for(int i = 0; i < _nc; i++) {
+        rows[i] = lspdef.GetSystemDof(index_sol, kkindex_sol, ielc, 0, i, lspdec._msh);
+        stencilIndex[i] = identityIndex + i;
+      }
+      stencilIndex[_nc] = identityIndex + _nc;
+    }
+  }
+
+
   void elem_type::BuildRestrictionTranspose(const LinearEquation& lspdef, const LinearEquation& lspdec, const int& ielc, SparseMatrix* Projmat,
       const unsigned& index_sol, const unsigned& kkindex_sol,
       const unsigned& index_pair_sol, const unsigned& kkindex_pair_sol) const {
@@ -457,6 +497,240 @@ namespace femus {
 //END prolungator for solution printing
 //----------------------------------------------------------------------------------------------------
 
+//----------------------------------------------------------------------------------------------------
+//BEGIN sum factorization
+//----------------------------------------------------------------------------------------------------
+
+  void elem_type::InitSumFactorization(const bool &tensorProductBasis) {
+
+    _sumFactorized = false;
+    if(!tensorProductBasis) return;
+
+    const double tolerance = 1.0e-12;
+    unsigned ng = _gauss.GetGaussPointsNumber();
+    const double* gaussPoints = _gauss.GetGaussWeightsPointer() + ng;
+
+    // 1D Gauss points and 1D node indices along each direction, a single dummy entry in the missing directions
+    std::vector < double > xg[3];
+    std::vector < int > ind[3];
+    for(unsigned d = 0; d < 3; d++) {
+      if(d < _dim) {
+        for(unsigned ig = 0; ig < ng; ig++) {
+          double x = gaussPoints[d * ng + ig];
+          unsigned i = 0;
+          while(i < xg[d].size() && fabs(xg[d][i] - x) > tolerance) i++;
+          if(i == xg[d].size()) xg[d].push_back(x);
+        }
+        for(int inode = 0; inode < _nc; inode++) {
+          if(std::find(ind[d].begin(), ind[d].end(), _IND[inode][d]) == ind[d].end()) ind[d].push_back(_IND[inode][d]);
+        }
+        std::sort(xg[d].begin(), xg[d].end());
+        std::sort(ind[d].begin(), ind[d].end());
+      }
+      else {
+        xg[d].assign(1, 0.);
+        ind[d].assign(1, 0);
+      }
+      _q1d[d] = xg[d].size();
+      _n1d[d] = ind[d].size();
+    }
+
+    if(_q1d[0] * _q1d[1] * _q1d[2] != ng || _n1d[0] * _n1d[1] * _n1d[2] != _nc) return;
+
+    // lexicographic tensor index of every Gauss point and node
+    std::vector < unsigned > gaussIndex(3 * ng, 0);
+    _tensorGauss.assign(ng, ng);
+    for(unsigned ig = 0; ig < ng; ig++) {
+      for(unsigned d = 0; d < _dim; d++) {
+        double x = gaussPoints[d * ng + ig];
+        while(fabs(xg[d][gaussIndex[3 * ig + d]] - x) > tolerance) gaussIndex[3 * ig + d]++;
+      }
+      unsigned index = gaussIndex[3 * ig] + _q1d[0] * (gaussIndex[3 * ig + 1] + _q1d[1] * gaussIndex[3 * ig + 2]);
+      if(_tensorGauss[index] != ng) return;
+      _tensorGauss[index] = ig;
+    }
+
+    std::vector < unsigned > nodeIndex(3 * _nc, 0);
+    _tensorNode.assign(_nc, _nc);
+    for(int inode = 0; inode < _nc; inode++) {
+      for(unsigned d = 0; d < _dim; d++) {
+        nodeIndex[3 * inode + d] = std::find(ind[d].begin(), ind[d].end(), _IND[inode][d]) - ind[d].begin();
+      }
+      unsigned index = nodeIndex[3 * inode] + _n1d[0] * (nodeIndex[3 * inode + 1] + _n1d[1] * nodeIndex[3 * inode + 2]);
+      if(_tensorNode[index] != _nc) return;
+      _tensorNode[index] = inode;
+    }
+
+    // 1D basis along d: the other directions are frozen at node 0, where their 1D bases are one
+    const double* x0 = _pt_basis->GetXcoarse(0);
+    for(unsigned d = 0; d < 3; d++) {
+      _phi1d[d].resize(_n1d[d] * _q1d[d]);
+      _dphi1d[d].resize(_n1d[d] * _q1d[d]);
+      if(d >= _dim) {
+        _phi1d[d][0] = 1.;
+        _dphi1d[d][0] = 0.;
+        continue;
+      }
+      for(unsigned a = 0; a < _n1d[d]; a++) {
+        for(unsigned i = 0; i < _q1d[d]; i++) {
+          int I[3];
+          double x[3];
+          for(unsigned dd = 0; dd < _dim; dd++) {
+            I[dd] = _IND[0][dd];
+            x[dd] = x0[dd];
+          }
+          I[d] = ind[d][a];
+          x[d] = xg[d][i];
+          _phi1d[d][a * _q1d[d] + i] = _pt_basis->eval_phi(I, x);
+          _dphi1d[d][a * _q1d[d] + i] = (d == 0) ? _pt_basis->eval_dphidx(I, x) :
+                                        (d == 1) ? _pt_basis->eval_dphidy(I, x) : _pt_basis->eval_dphidz(I, x);
+        }
+      }
+    }
+
+    // the 1D tables have to reproduce the reference derivatives at the Gauss points
+    for(unsigned ig = 0; ig < ng; ig++) {
+      for(unsigned d = 0; d < _dim; d++) {
+        const double* dphi = (d == 0) ? GetDPhiDXi(ig) : (d == 1) ? GetDPhiDEta(ig) : GetDPhiDZeta(ig);
+        for(int inode = 0; inode < _nc; inode++) {
+          double value = 1.;
+          for(unsigned dd = 0; dd < _dim; dd++) {
+            const std::vector < double > &table = (dd == d) ? _dphi1d[dd] : _phi1d[dd];
+            value *= table[nodeIndex[3 * inode + dd] * _q1d[dd] + gaussIndex[3 * ig + dd]];
+          }
+          if(fabs(value - dphi[inode]) > 1.0e-10) return;
+        }
+      }
+    }
+
+    _sumFactorized = true;
+  }
+
+  unsigned elem_type::GetBatchJacobianMatrixWorkSize(const unsigned &nel) const {
+    if(!_sumFactorized) return 0;
+    return (2 * _q1d[0] * _n1d[1] * _n1d[2] + 3 * _q1d[0] * _q1d[1] * _n1d[2]) * nel;
+  }
+
+  unsigned elem_type::GetJacobianBatchWorkSize(const unsigned &nel) const {
+    // jac at all the Gauss points and the inverse Jacobian at one Gauss point, then the sum factorization scratch
+    unsigned ng = _gauss.GetGaussPointsNumber();
+    return (ng + 1) * _dim * _dim * nel + GetBatchJacobianMatrixWorkSize(nel);
+  }
+
+  void elem_type::BatchJacobianMatrix(const unsigned &nel, const double *vt, double *jac, double *work) const {
+
+    unsigned ng = _gauss.GetGaussPointsNumber();
+
+    if(!_sumFactorized) {
+      for(unsigned ig = 0; ig < ng; ig++) {
+        for(unsigned i = 0; i < _dim; i++) {
+          const double* dphi = (i == 0) ? GetDPhiDXi(ig) : (i == 1) ? GetDPhiDEta(ig) : GetDPhiDZeta(ig);
+          for(unsigned k = 0; k < _dim; k++) {
+            double* J = jac + ((ig * _dim + i) * _dim + k) * nel;
+            for(unsigned e = 0; e < nel; e++) J[e] = 0.;
+            for(int inode = 0; inode < _nc; inode++) {
+              const double* x = vt + (k * _nc + inode) * nel;
+              double c = dphi[inode];
+              for(unsigned e = 0; e < nel; e++) J[e] += c * x[e];
+            }
+          }
+        }
+      }
+      return;
+    }
+
+    const unsigned n0 = _n1d[0], n1 = _n1d[1], n2 = _n1d[2];
+    const unsigned q0 = _q1d[0], q1 = _q1d[1], q2 = _q1d[2];
+
+    // T: xi contracted, value and xi derivative; S: xi and eta contracted, value, eta derivative and xi derivative
+    double* T0 = work;
+    double* T1 = T0 + q0 * n1 * n2 * nel;
+    double* S0 = T1 + q0 * n1 * n2 * nel;
+    double* S1 = S0 + q0 * q1 * n2 * nel;
+    double* S2 = S1 + q0 * q1 * n2 * nel;
+    double* SEnd = S2 + q0 * q1 * n2 * nel;
+
+    for(unsigned k = 0; k < _dim; k++) {
+
+      std::fill(T0, S0, 0.);
+      for(unsigned c = 0; c < n2; c++) {
+        for(unsigned b = 0; b < n1; b++) {
+          for(unsigned a = 0; a < n0; a++) {
+            const double* x = vt + (k * _nc + _tensorNode[a + n0 * (b + n1 * c)]) * nel;
+            for(unsigned i = 0; i < q0; i++) {
+              double p = _phi1d[0][a * q0 + i];
+              double dp = _dphi1d[0][a * q0 + i];
+              double* t0 = T0 + (i + q0 * (b + n1 * c)) * nel;
+              double* t1 = T1 + (i + q0 * (b + n1 * c)) * nel;
+              for(unsigned e = 0; e < nel; e++) {
+                t0[e] += p * x[e];
+                t1[e] += dp * x[e];
+              }
+            }
+          }
+        }
+      }
+
+      std::fill(S0, SEnd, 0.);
+      for(unsigned c = 0; c < n2; c++) {
+        for(unsigned j = 0; j < q1; j++) {
+          for(unsigned b = 0; b < n1; b++) {
+            double p = _phi1d[1][b * q1 + j];
+            double dp = _dphi1d[1][b * q1 + j];
+            for(unsigned i = 0; i < q0; i++) {
+              const double* t0 = T0 + (i + q0 * (b + n1 * c)) * nel;
+              const double* t1 = T1 + (i + q0 * (b + n1 * c)) * nel;
+              double* s0 = S0 + (i + q0 * (j + q1 * c)) * nel;
+              double* s1 = S1 + (i + q0 * (j + q1 * c)) * nel;
+              double* s2 = S2 + (i + q0 * (j + q1 * c)) * nel;
+              for(unsigned e = 0; e < nel; e++) {
+                s0[e] += p * t0[e];
+                s1[e] += dp * t0[e];
+                s2[e] += p * t1[e];
+              }
+            }
+          }
+        }
+      }
+
+      for(unsigned l = 0; l < q2; l++) {
+        for(unsigned j = 0; j < q1; j++) {
+          for(unsigned i = 0; i < q0; i++) {
+            unsigned ig = _tensorGauss[i + q0 * (j + q1 * l)];
+            double* Jxi = jac + ((ig * _dim + 0) * _dim + k) * nel;
+            double* Jeta = jac + ((ig * _dim + 1) * _dim + k) * nel;
+            double* Jzeta = (_dim == 3) ? jac + ((ig * _dim + 2) * _dim + k) * nel : NULL;
+            for(unsigned e = 0; e < nel; e++) {
+              Jxi[e] = 0.;
+              Jeta[e] = 0.;
+            }
+            if(Jzeta) {
+              for(unsigned e = 0; e < nel; e++) Jzeta[e] = 0.;
+            }
+            for(unsigned c = 0; c < n2; c++) {
+              double p = _phi1d[2][c * q2 + l];
+              double dp = _dphi1d[2][c * q2 + l];
+              const double* s0 = S0 + (i + q0 * (j + q1 * c)) * nel;
+              const double* s1 = S1 + (i + q0 * (j + q1 * c)) * nel;
+              const double* s2 = S2 + (i + q0 * (j + q1 * c)) * nel;
+              for(unsigned e = 0; e < nel; e++) {
+                Jxi[e] += p * s2[e];
+                Jeta[e] += p * s1[e];
+              }
+              if(Jzeta) {
+                for(unsigned e = 0; e < nel; e++) Jzeta[e] += dp * s0[e];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------
+//END sum factorization
+//----------------------------------------------------------------------------------------------------
+
 
 
   elem_type_1D::elem_type_1D(const char* geom_elem, const char* order, const char* order_gauss) :
@@ -1003,6 +1277,8 @@ namespace femus {
 //=====================
     EvaluateShapeAtQP(geom_elem, order);
 
+    InitSumFactorization(!strcmp(geom_elem, "quad") && (_SolType == 0 || _SolType == 2));
+
     //std::cout << std::endl;
 
     delete linearElement;
@@ -1419,6 +1695,8 @@ namespace femus {
 //=====================
     EvaluateShapeAtQP(geom_elem, order);
 
+    InitSumFactorization(!strcmp(geom_elem, "hex") && (_SolType == 0 || _SolType == 2));
+
     //std::cout << std::endl;
 
     delete linearElement;
@@ -1710,6 +1988,158 @@ namespace femus {
 
   }
 
+//---------------------------------------------------------------------------------------------------------
+
+  void elem_type_2D::JacobianBatch(const unsigned &nel, const double *vt, double *weight, double *gradphi, double *nablaphi,
+                                   double *work) const {
+
+    unsigned ng = _gauss.GetGaussPointsNumber();
+
+    double* jac = work;
+    double* jacI = jac + ng * 4 * nel;
+    BatchJacobianMatrix(nel, vt, jac, jacI + 4 * nel);
+
+    double* JI[2][2];
+    for(unsigned a = 0; a < 2; a++) {
+      for(unsigned b = 0; b < 2; b++) {
+        JI[a][b] = &jacI[(2 * a + b) * nel];
+      }
+    }
+
+    for(unsigned ig = 0; ig < ng; ig++) {
+      const double* J = &jac[ig * 4 * nel];
+      double gaussWeight = _gauss.GetGaussWeightsPointer()[ig];
+      double* w = weight + ig * nel;
+
+      for(unsigned e = 0; e < nel; e++) {
+        double J00 = J[e], J01 = J[nel + e], J10 = J[2 * nel + e], J11 = J[3 * nel + e];
+        double det = J00 * J11 - J01 * J10;
+        JI[0][0][e] = J11 / det;
+        JI[0][1][e] = -J01 / det;
+        JI[1][0][e] = -J10 / det;
+        JI[1][1][e] = J00 / det;
+        w[e] = det * gaussWeight;
+      }
+
+      for(int inode = 0; inode < _nc; inode++) {
+        double dxi = _dphidxi[ig][inode];
+        double deta = _dphideta[ig][inode];
+
+        double* g = gradphi + (ig * _nc + inode) * 2 * nel;
+        for(unsigned e = 0; e < nel; e++) {
+          g[e]       = dxi * JI[0][0][e] + deta * JI[0][1][e];
+          g[nel + e] = dxi * JI[1][0][e] + deta * JI[1][1][e];
+        }
+
+        if(nablaphi) {
+          double dxi2 = _d2phidxi2[ig][inode];
+          double deta2 = _d2phideta2[ig][inode];
+          double dxideta = _d2phidxideta[ig][inode];
+
+          double* h = nablaphi + (ig * _nc + inode) * 3 * nel;
+          for(unsigned e = 0; e < nel; e++) {
+            double A0 = dxi2 * JI[0][0][e] + dxideta * JI[0][1][e];
+            double B0 = dxideta * JI[0][0][e] + deta2 * JI[0][1][e];
+            double A1 = dxi2 * JI[1][0][e] + dxideta * JI[1][1][e];
+            double B1 = dxideta * JI[1][0][e] + deta2 * JI[1][1][e];
+            h[e]           = A0 * JI[0][0][e] + B0 * JI[0][1][e];
+            h[nel + e]     = A1 * JI[1][0][e] + B1 * JI[1][1][e];
+            h[2 * nel + e] = A0 * JI[1][0][e] + B0 * JI[1][1][e];
+          }
+        }
+      }
+    }
+  }
+
+//---------------------------------------------------------------------------------------------------------
+
+  void elem_type_3D::JacobianBatch(const unsigned &nel, const double *vt, double *weight, double *gradphi, double *nablaphi,
+                                   double *work) const {
+
+    unsigned ng = _gauss.GetGaussPointsNumber();
+
+    double* jac = work;
+    double* jacI = jac + ng * 9 * nel;
+    BatchJacobianMatrix(nel, vt, jac, jacI + 9 * nel);
+
+    double* JI[3][3];
+    for(unsigned a = 0; a < 3; a++) {
+      for(unsigned b = 0; b < 3; b++) {
+        JI[a][b] = &jacI[(3 * a + b) * nel];
+      }
+    }
+
+    for(unsigned ig = 0; ig < ng; ig++) {
+      const double* J[3][3];
+      for(unsigned a = 0; a < 3; a++) {
+        for(unsigned b = 0; b < 3; b++) {
+          J[a][b] = &jac[((ig * 3 + a) * 3 + b) * nel];
+        }
+      }
+      double gaussWeight = _gauss.GetGaussWeightsPointer()[ig];
+      double* w = weight + ig * nel;
+
+      for(unsigned e = 0; e < nel; e++) {
+        double J00 = J[0][0][e], J01 = J[0][1][e], J02 = J[0][2][e];
+        double J10 = J[1][0][e], J11 = J[1][1][e], J12 = J[1][2][e];
+        double J20 = J[2][0][e], J21 = J[2][1][e], J22 = J[2][2][e];
+
+        double det = J00 * (J11 * J22 - J12 * J21) + J01 * (J12 * J20 - J10 * J22) + J02 * (J10 * J21 - J11 * J20);
+
+        JI[0][0][e] = (-J12 * J21 + J11 * J22) / det;
+        JI[0][1][e] = (J02 * J21 - J01 * J22) / det;
+        JI[0][2][e] = (-J02 * J11 + J01 * J12) / det;
+        JI[1][0][e] = (J12 * J20 - J10 * J22) / det;
+        JI[1][1][e] = (-J02 * J20 + J00 * J22) / det;
+        JI[1][2][e] = (J02 * J10 - J00 * J12) / det;
+        JI[2][0][e] = (-J11 * J20 + J10 * J21) / det;
+        JI[2][1][e] = (J01 * J20 - J00 * J21) / det;
+        JI[2][2][e] = (-J01 * J10 + J00 * J11) / det;
+
+        w[e] = det * gaussWeight;
+      }
+
+      for(int inode = 0; inode < _nc; inode++) {
+        double dxi = _dphidxi[ig][inode];
+        double deta = _dphideta[ig][inode];
+        double dzeta = _dphidzeta[ig][inode];
+
+        double* g = gradphi + (ig * _nc + inode) * 3 * nel;
+        for(unsigned e = 0; e < nel; e++) {
+          g[e]           = dxi * JI[0][0][e] + deta * JI[0][1][e] + dzeta * JI[0][2][e];
+          g[nel + e]     = dxi * JI[1][0][e] + deta * JI[1][1][e] + dzeta * JI[1][2][e];
+          g[2 * nel + e] = dxi * JI[2][0][e] + deta * JI[2][1][e] + dzeta * JI[2][2][e];
+        }
+
+        if(nablaphi) {
+          double dxi2 = _d2phidxi2[ig][inode];
+          double deta2 = _d2phideta2[ig][inode];
+          double dzeta2 = _d2phidzeta2[ig][inode];
+          double dxideta = _d2phidxideta[ig][inode];
+          double detadzeta = _d2phidetadzeta[ig][inode];
+          double dzetadxi = _d2phidzetadxi[ig][inode];
+
+          double* h = nablaphi + (ig * _nc + inode) * 6 * nel;
+          for(unsigned e = 0; e < nel; e++) {
+            // second reference derivatives contracted with the d-th row of the inverse Jacobian
+            double A[3], B[3], C[3];
+            for(unsigned d = 0; d < 3; d++) {
+              A[d] = dxi2 * JI[d][0][e] + dxideta * JI[d][1][e] + dzetadxi * JI[d][2][e];
+              B[d] = dxideta * JI[d][0][e] + deta2 * JI[d][1][e] + detadzeta * JI[d][2][e];
+              C[d] = dzetadxi * JI[d][0][e] + detadzeta * JI[d][1][e] + dzeta2 * JI[d][2][e];
+            }
+            h[e]           = A[0] * JI[0][0][e] + B[0] * JI[0][1][e] + C[0] * JI[0][2][e];
+            h[nel + e]     = A[1] * JI[1][0][e] + B[1] * JI[1][1][e] + C[1] * JI[1][2][e];
+            h[2 * nel + e] = A[2] * JI[2][0][e] + B[2] * JI[2][1][e] + C[2] * JI[2][2][e];
+            h[3 * nel + e] = A[0] * JI[1][0][e] + B[0] * JI[1][1][e] + C[0] * JI[1][2][e];
+            h[4 * nel + e] = A[1] * JI[2][0][e] + B[1] * JI[2][1][e] + C[1] * JI[2][2][e];
+            h[5 * nel + e] = A[2] * JI[0][0][e] + B[2] * JI[0][1][e] + C[2] * JI[0][2][e];
+          }
+        }
+      }
+    }
+  }
+
 //---------------------------------------------------------------------------------------------------------
 
 } //end namespace femus
@@ -29,6 +29,7 @@
 #include "LinearEquation.hpp"
 #include "GaussPoints.hpp"
 #include "adept.h"
+#include "DualNumber.hpp"
 #include "FETypeEnum.hpp"
 
 
@@ -54,6 +55,14 @@ public:
   void BuildProlongation(const LinearEquation &lspdef,const LinearEquation &lspdec, const int& ielc, SparseMatrix* Projmat,
                          const unsigned &index_sol, const unsigned &kkindex_sol) const;
 
+  /** Matrix-free counterpart of BuildProlongation: fill the fine system dofs of the coarse element ielc (rows),
+   * the coarse system dofs of its nodes (cols) and, in the CSR layout of _prol_ind, the local coarse indices
+   * and the weights of the stencil of each row */
+  void GetProlongationStencil(const LinearEquation &lspdef,const LinearEquation &lspdec, const int& ielc,
+                              const unsigned &index_sol, const unsigned &kkindex_sol,
+                              vector < int > &rows, vector < int > &cols,
+                              vector < const int* > &stencilIndex, vector < const double* > &stencilValue) const;
+
   /** To be Added */
   void BuildRestrictionTranspose(const LinearEquation &lspdef,const LinearEquation &lspdec, const int& ielc, SparseMatrix* Projmat,
                                  const unsigned &index_sol, const unsigned &kkindex_sol,
@@ -76,6 +85,33 @@ public:
 
   virtual void JacobianSur(const vector < vector < double > > &vt, const unsigned &ig, double &Weight,
 			   vector < double > &other_phi, vector < double > &gradphi, vector < double > &normal) const = 0;
+
+  /** Forward-mode counterparts of Jacobian and JacobianSur, see DualNumber */
+  virtual void Jacobian(const vector < vector < DualNumber8 > > &vt, const unsigned &ig, DualNumber8 &Weight,
+			vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &nablaphi) const = 0;
+
+  virtual void JacobianSur(const vector < vector < DualNumber8 > > &vt, const unsigned &ig, DualNumber8 &Weight,
+			   vector < double > &other_phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &normal) const = 0;
+
+  /** Batched counterpart of Jacobian for nel elements of this type at all the Gauss points. The element is the innermost,
+   * SIMD friendly, index of every array: vt[(k * nc + inode) * nel + iel], weight[ig * nel + iel],
+   * gradphi[((ig * nc + inode) * dim + k) * nel + iel] and, if not NULL, nablaphi[((ig * nc + inode) * dim2 + k) * nel + iel].
+   * work is a scratch array of GetJacobianBatchWorkSize(nel) doubles, so no memory is allocated.
+   * On the tensor-product hex and quad bases the geometry is sum-factorized */
+  virtual void JacobianBatch(const unsigned &nel, const double *vt, double *weight, double *gradphi, double *nablaphi,
+                             double *work) const {
+    std::cout<<"JacobianBatch does not apply for this element dimension\n";
+    abort();
+  }
+
+  /** Size of the scratch array of JacobianBatch for nel elements */
+  unsigned GetJacobianBatchWorkSize(const unsigned &nel) const;
+
+  /** Returns true if JacobianBatch uses the sum-factorized geometry */
+  bool IsSumFactorized() const {
+    return _sumFactorized;
+  }
+
   /** To be Added */
   virtual double* GetPhi(const unsigned &ig) const = 0;
 
@@ -159,6 +195,16 @@ public:
   
 protected:
 
+  /** Builds the 1D tables of a tensor-product basis and Gauss rule, _sumFactorized stays false if the structure is not found */
+  void InitSumFactorization(const bool &tensorProductBasis);
+
+  /** jac[((ig * dim + i) * dim + k) * nel + iel] is the derivative of the coordinate k along the reference direction i,
+   * work is the sum factorization scratch array of GetBatchJacobianMatrixWorkSize(nel) doubles */
+  void BatchJacobianMatrix(const unsigned &nel, const double *vt, double *jac, double *work) const;
+
+  /** Size of the scratch array of BatchJacobianMatrix for nel elements */
+  unsigned GetBatchJacobianMatrixWorkSize(const unsigned &nel) const;
+
   // member data
   unsigned _dim; /*Spatial dimension of the geometric element*/
   int _nc,_nf,_nlag[4];
@@ -176,6 +222,13 @@ protected:
 //  Gauss
   const Gauss _gauss;
 
+//  sum factorization: _phi1d[d][a * _q1d[d] + i] is the 1D basis a at the 1D Gauss point i along the direction d
+  bool _sumFactorized;
+  unsigned _n1d[3], _q1d[3];
+  std::vector < double > _phi1d[3], _dphi1d[3];
+  std::vector < unsigned > _tensorNode;   // node of each lexicographic tensor index
+  std::vector < unsigned > _tensorGauss;  // Gauss point of each lexicographic tensor index
+
   /**  @deprecated */
   bool isMpGDAllocated;
   double**      _phi_mapGD;
@@ -216,6 +269,11 @@ public:
 		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
 		}
 
+  void Jacobian(const vector < vector < DualNumber8 > > &vt,const unsigned &ig, DualNumber8 &Weight,
+		vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &nablaphi) const{
+		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
+		}
+
   template <class type>
   void JacobianSur_type(const vector < vector < type > > &vt, const unsigned &ig, type &Weight,
 			vector < double > &phi, vector < type > &gradphi, vector < type > &normal) const;
@@ -230,6 +288,11 @@ public:
 		     JacobianSur_type(vt, ig, Weight, phi, gradphi, normal);
 		  }
 
+  void JacobianSur(const vector < vector < DualNumber8 > > &vt, const unsigned &ig, DualNumber8 &Weight,
+	           vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &normal) const{
+		     JacobianSur_type(vt, ig, Weight, phi, gradphi, normal);
+		  }
+
   inline double* GetPhi(const unsigned &ig) const { return _phi[ig]; }
   inline double* GetDPhiDXi(const unsigned &ig) const { return _dphidxi[ig]; }
 
@@ -286,6 +349,13 @@ public:
 		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
 		}
 
+  void Jacobian(const vector < vector < DualNumber8 > > &vt,const unsigned &ig, DualNumber8 &Weight,
+		vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &nablaphi) const{
+		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
+		}
+
+  void JacobianBatch(const unsigned &nel, const double *vt, double *weight, double *gradphi, double *nablaphi, double *work) const;
+
   template <class type>
   void JacobianSur_type(const vector < vector < type > > &vt, const unsigned &ig, type &Weight,
 			vector < double > &phi, vector < type > &gradphi, vector < type > &normal) const;
@@ -300,6 +370,11 @@ public:
 		     JacobianSur_type(vt, ig, Weight, phi, gradphi, normal);
 		  }
 
+  void JacobianSur(const vector < vector < DualNumber8 > > &vt, const unsigned &ig, DualNumber8 &Weight,
+	           vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &normal) const{
+		     JacobianSur_type(vt, ig, Weight, phi, gradphi, normal);
+		  }
+
   inline double* GetPhi(const unsigned &ig) const { return _phi[ig]; }
   inline double* GetDPhiDXi(const unsigned &ig) const { return _dphidxi[ig]; }
   inline double* GetDPhiDEta(const unsigned &ig) const { return _dphideta[ig]; }
@@ -372,6 +447,13 @@ public:
 		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
 		}
 
+  void Jacobian(const vector < vector < DualNumber8 > > &vt,const unsigned &ig, DualNumber8 &Weight,
+		vector < double > &phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &nablaphi) const{
+		Jacobian_type(vt, ig, Weight, phi, gradphi, nablaphi);
+		}
+
+  void JacobianBatch(const unsigned &nel, const double *vt, double *weight, double *gradphi, double *nablaphi, double *work) const;
+
   void JacobianSur(const vector < vector < adept::adouble > > &vt, const unsigned &ig, adept::adouble &Weight,
 	           vector < double > &other_phi, vector < adept::adouble > &gradphi, vector < adept::adouble > &normal) const{
 		   std::cout<<"Jacobian surface non-defined for elem_type_3D objects"<<std::endl;
@@ -384,6 +466,12 @@ public:
 		   abort();
 		  }
 
+  void JacobianSur(const vector < vector < DualNumber8 > > &vt, const unsigned &ig, DualNumber8 &Weight,
+	           vector < double > &other_phi, vector < DualNumber8 > &gradphi, vector < DualNumber8 > &normal) const{
+		   std::cout<<"Jacobian surface non-defined for elem_type_3D objects"<<std::endl;
+		   abort();
+		  }
+
 
   //---------------------------------------------------------------------------------------------------------
   inline double* GetPhi(const unsigned &ig) const { return _phi[ig]; }
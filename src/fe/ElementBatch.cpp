@@ -0,0 +1,127 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: ElementBatch
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "ElementBatch.hpp"
+#include "ElemType.hpp"
+#include "Mesh.hpp"
+#include "NumericVector.hpp"
+#include "Solution.hpp"
+
+#include <cstddef>
+
+
+namespace femus {
+
+  // ==============================================
+  ElementBatch::ElementBatch(const Mesh *msh, const short unsigned &ielGeom, const unsigned &solType,
+                             const unsigned &nSolutions, const unsigned &capacity) :
+    _msh(msh), _fe(msh->_finiteElement[ielGeom][solType]), _solType(solType) {
+
+    _dim = msh->GetDimension();
+    _dim2 = 3 * (_dim - 1) + !(_dim - 1);
+    _nDofs = _fe->GetNDofs();
+    _nGauss = _fe->GetGaussPointNumber();
+
+    _capacity = capacity;
+    _stride = ((capacity + 7) / 8) * 8;
+    _size = 0;
+
+    _elements.resize(_capacity);
+    _dofs.resize(_nDofs * _stride);
+
+    _x = Align(_xMemory, _dim * _nDofs * _stride);
+    _weight = Align(_weightMemory, _nGauss * _stride);
+    _gradPhi = Align(_gradPhiMemory, _nGauss * _nDofs * _dim * _stride);
+    _nablaPhi = NULL;
+    _work = Align(_workMemory, _fe->GetJacobianBatchWorkSize(_stride));
+
+    _solutionMemory.resize(nSolutions);
+    _solution.resize(nSolutions);
+    for(unsigned slot = 0; slot < nSolutions; slot++) {
+      _solution[slot] = Align(_solutionMemory[slot], _nDofs * _stride);
+    }
+  }
+
+  // ==============================================
+  double* ElementBatch::Align(std::vector < double > &memory, const unsigned &size) {
+    const size_t alignment = 64;
+    memory.resize(size + alignment / sizeof(double));
+    size_t misalignment = reinterpret_cast < size_t >(&memory[0]) % alignment;
+    return &memory[0] + ((alignment - misalignment) % alignment) / sizeof(double);
+  }
+
+  // ==============================================
+  bool ElementBatch::PushBack(const unsigned &iel) {
+    if(_size == _capacity) return false;
+
+    _elements[_size] = iel;
+
+    // the padding lanes repeat the last element
+    for(unsigned i = 0; i < _nDofs; i++) {
+      unsigned idof = _msh->GetSolutionDof(i, iel, _solType);
+      for(unsigned e = _size; e < _stride; e++) {
+        _dofs[i * _stride + e] = idof;
+      }
+    }
+
+    _size++;
+    return true;
+  }
+
+  // ==============================================
+  void ElementBatch::GatherCoordinates() {
+    if(_size == 0) return;
+
+    const unsigned xType = 2;
+    for(unsigned k = 0; k < _dim; k++) {
+      NumericVectorLocalView xView = _msh->_topology->_Sol[k]->GetLocalView();
+      for(unsigned i = 0; i < _nDofs; i++) {
+        double *x = _x + (k * _nDofs + i) * _stride;
+        for(unsigned e = 0; e < _size; e++) {
+          x[e] = xView(_msh->GetSolutionDof(i, _elements[e], xType));
+        }
+        for(unsigned e = _size; e < _stride; e++) {
+          x[e] = x[_size - 1];
+        }
+      }
+    }
+  }
+
+  // ==============================================
+  void ElementBatch::GatherSolution(const unsigned &slot, const NumericVector &sol) {
+    if(_size == 0) return;
+
+    NumericVectorLocalView solView = sol.GetLocalView();
+    const unsigned *dofs = &_dofs[0];
+    double *u = _solution[slot];
+    for(unsigned j = 0; j < _nDofs * _stride; j++) {
+      u[j] = solView(dofs[j]);
+    }
+  }
+
+  // ==============================================
+  void ElementBatch::Jacobian(const bool &hessian) {
+    if(_size == 0) return;
+
+    if(hessian && _nablaPhi == NULL) {
+      _nablaPhi = Align(_nablaPhiMemory, _nGauss * _nDofs * _dim2 * _stride);
+    }
+    _fe->JacobianBatch(_stride, _x, _weight, _gradPhi, (hessian) ? _nablaPhi : NULL, _work);
+  }
+
+} //end namespace femus
@@ -0,0 +1,137 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: ElementBatch
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_fe_ElementBatch_hpp__
+#define __femus_fe_ElementBatch_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include <vector>
+
+
+namespace femus {
+
+class Mesh;
+class elem_type;
+class NumericVector;
+
+/**
+ * Workspace for a batch of up to capacity owned elements with the same geometric type ielGeom, evaluated with the
+ * finite element family solType. All the buffers are allocated once, 64-byte aligned, in structure of arrays layout:
+ * the element is the innermost index and every row has GetStride() entries, a multiple of 8. The lanes beyond
+ * GetSize() repeat the last element, so batched loops can always run over the whole stride.
+ */
+class ElementBatch {
+
+public:
+
+    /** Constructor: nSolutions is the number of solution slots filled by GatherSolution */
+    ElementBatch(const Mesh *msh, const short unsigned &ielGeom, const unsigned &solType,
+                 const unsigned &nSolutions = 0, const unsigned &capacity = 32);
+
+    /** Removes all the elements */
+    void Clear() {
+      _size = 0;
+    }
+
+    /** Adds the owned element iel, which has to be of type ielGeom, and returns false if the batch is already full */
+    bool PushBack(const unsigned &iel);
+
+    unsigned GetSize() const {
+      return _size;
+    }
+
+    bool IsFull() const {
+      return _size == _capacity;
+    }
+
+    unsigned GetStride() const {
+      return _stride;
+    }
+
+    unsigned GetElement(const unsigned &e) const {
+      return _elements[e];
+    }
+
+    const elem_type* GetFiniteElement() const {
+      return _fe;
+    }
+
+    /** Gathers the _topology coordinates of the elements: GetCoordinates()[(k * nDofs + i) * stride + e] */
+    void GatherCoordinates();
+
+    /** Gathers the values of sol, of family solType, on the element dofs: GetSolution(slot)[i * stride + e] */
+    void GatherSolution(const unsigned &slot, const NumericVector &sol);
+
+    /** Batched Jacobian of the elements at all the Gauss points from the gathered coordinates,
+     * the second derivatives are evaluated only if hessian is true */
+    void Jacobian(const bool &hessian = false);
+
+    /** Mesh dofs of family solType: GetDofs()[i * stride + e] */
+    const unsigned* GetDofs() const {
+      return &_dofs[0];
+    }
+
+    const double* GetCoordinates() const {
+      return _x;
+    }
+
+    const double* GetSolution(const unsigned &slot) const {
+      return _solution[slot];
+    }
+
+    /** Gauss weights: GetWeights()[ig * stride + e] */
+    const double* GetWeights() const {
+      return _weight;
+    }
+
+    /** Shape function gradients: GetGradPhi()[((ig * nDofs + i) * dim + k) * stride + e] */
+    const double* GetGradPhi() const {
+      return _gradPhi;
+    }
+
+    /** Shape function second derivatives: GetNablaPhi()[((ig * nDofs + i) * dim2 + k) * stride + e] */
+    const double* GetNablaPhi() const {
+      return _nablaPhi;
+    }
+
+private:
+
+    /** Resizes memory to hold size aligned doubles and returns the aligned pointer */
+    static double* Align(std::vector < double > &memory, const unsigned &size);
+
+    const Mesh *_msh;
+    const elem_type *_fe;
+    short unsigned _solType;
+    unsigned _dim, _dim2;
+    unsigned _nDofs, _nGauss;
+    unsigned _capacity, _stride, _size;
+
+    std::vector < unsigned > _elements;
+    std::vector < unsigned > _dofs;
+
+    std::vector < double > _xMemory, _weightMemory, _gradPhiMemory, _nablaPhiMemory, _workMemory;
+    std::vector < std::vector < double > > _solutionMemory;
+    double *_x, *_weight, *_gradPhi, *_nablaPhi, *_work;
+    std::vector < double* > _solution;
+};
+
+
+} //end namespace femus
+
+
+
+#endif
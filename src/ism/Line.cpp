@@ -591,8 +591,7 @@ namespace femus {
 
     while(integrationIsOverCounter != _size) {
 
-      MyVector <unsigned> integrationIsOverCounterProc(1, 0);
-      integrationIsOverCounterProc.stack();
+      unsigned integrationIsOverCounterProc = 0;
 
       //BEGIN LOCAL ADVECTION INSIDE IPROC
       clock_t startTime = clock();
@@ -712,22 +711,16 @@ namespace femus {
         }
 
         if(step == UINT_MAX || markerOutsideDomain) {
-          integrationIsOverCounterProc[_iproc] += 1;
+          integrationIsOverCounterProc += 1;
         }
         //if(counter > maxload) break;
       }
       _time[5] += static_cast<double>((clock() - startTime)) / CLOCKS_PER_SEC;
-      MPI_Barrier(PETSC_COMM_WORLD);
       _time[0] += static_cast<double>((clock() - startTime)) / CLOCKS_PER_SEC;
       startTime = clock();
       //END LOCAL ADVECTION INSIDE IPROC
 
-      integrationIsOverCounter = 0;
-      for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
-        integrationIsOverCounterProc.broadcast(jproc);
-        integrationIsOverCounter += integrationIsOverCounterProc[jproc];
-        integrationIsOverCounterProc.clearBroadcast();
-      }
+      MPI_Allreduce(&integrationIsOverCounterProc, &integrationIsOverCounter, 1, MPI_UNSIGNED, MPI_SUM, PETSC_COMM_WORLD);
 
 //       MPI_Barrier( PETSC_COMM_WORLD );
 //       _time[1] += static_cast<double>((clock() - startTime)) / CLOCKS_PER_SEC;
@@ -737,85 +730,119 @@ namespace femus {
 
       //BEGIN exchange on information
 
-      //std::cout << " ----------------------------------PROCESSES EXCHANGE INFO ---------------------------------- " << std::endl;
+      // every process gets the element and the step of all the markers with a single collective
+      std::vector < int > stateCounts(_nprocs);
+      std::vector < int > stateDispls(_nprocs);
       for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
-        for(unsigned iMarker = _markerOffset[jproc]; iMarker < _markerOffset[jproc + 1]; iMarker++) {
-          unsigned elem =  _particles[iMarker]->GetMarkerElement();
-          MPI_Bcast(& elem, 1, MPI_UNSIGNED, jproc, PETSC_COMM_WORLD);
-          _particles[iMarker]->SetMarkerElement(elem);
+        stateCounts[jproc] = 2 * (_markerOffset[jproc + 1] - _markerOffset[jproc]);
+        stateDispls[jproc] = 2 * _markerOffset[jproc];
+      }
+      std::vector < unsigned > localState(stateCounts[_iproc] + 1);
+      for(unsigned iMarker = _markerOffset[_iproc]; iMarker < _markerOffset[_iproc + 1]; iMarker++) {
+        localState[2 * (iMarker - _markerOffset[_iproc])] = _particles[iMarker]->GetMarkerElement();
+        localState[2 * (iMarker - _markerOffset[_iproc]) + 1] = _particles[iMarker]->GetIprocMarkerStep();
+      }
+      std::vector < unsigned > markerState(2 * _size + 1);
+      MPI_Allgatherv(&localState[0], stateCounts[_iproc], MPI_UNSIGNED,
+                     &markerState[0], &stateCounts[0], &stateDispls[0], MPI_UNSIGNED, PETSC_COMM_WORLD);
+
+      for(unsigned iMarker = 0; iMarker < _size; iMarker++) {
+        _particles[iMarker]->SetMarkerElement(markerState[2 * iMarker]);
+        _particles[iMarker]->SetIprocMarkerStep(markerState[2 * iMarker + 1]);
+        _particles[iMarker]->GetMarkerProc(_sol);
+      }
 
-          unsigned step =  _particles[iMarker]->GetIprocMarkerStep();
-          MPI_Bcast(& step, 1, MPI_UNSIGNED, jproc, PETSC_COMM_WORLD);
-          _particles[iMarker]->SetIprocMarkerStep(step);
+      // pack the state of the owned markers that left this process: the ones still in the domain go to the process
+      // owning their new element, where the element search goes on, the ones outside the domain go to process 0
+      std::vector < std::vector < double > > sendBuffer(_nprocs);
+      for(unsigned iMarker = _markerOffset[_iproc]; iMarker < _markerOffset[_iproc + 1]; iMarker++) {
+        unsigned mproc = _particles[iMarker]->GetMarkerProc(_sol);
+        if(mproc != _iproc) {
+          PackMarkerState(iMarker, order, sendBuffer[mproc]);
+        }
+      }
 
-          if(elem != UINT_MAX) {  // if it is outside jproc, ACTUALLY IF WE ARE HERE IT COULD STILL BE IN JPROC but not outside the domain
-            unsigned mproc = _particles[iMarker]->GetMarkerProc(_sol);
-            _particles[iMarker]->SetMarkerProc(mproc);
-            if(mproc != jproc) {
-              unsigned prevElem = _particles[iMarker]->GetIprocMarkerPreviousElement();
-              _particles[iMarker]->GetMarkerS(n, order, s);
-              _particles[iMarker]->GetElement(prevElem, jproc, _sol, s);
-              _particles[iMarker]->SetIprocMarkerPreviousElement(prevElem);
-            }
-            elem = _particles[iMarker]->GetMarkerElement();
-            if(elem != UINT_MAX) {  // if it is not outside the domain
-              unsigned mproc = _particles[iMarker]->GetMarkerProc(_sol);
-              if(mproc != jproc) {
-                if(jproc == _iproc) {
-
-                  unsigned step =  _particles[iMarker]->GetIprocMarkerStep();
-                  MPI_Send(& step, 1, MPI_UNSIGNED, mproc, order + 1, PETSC_COMM_WORLD);
-
-                  unsigned istep = step % order;
-                  if(istep != 0) {
-                    K = _particles[iMarker]->GetIprocMarkerK();
-                    for(int i = 0; i < order; i++) {
-                      MPI_Send(&K[i][0], _dim, MPI_DOUBLE, mproc, i , PETSC_COMM_WORLD);
-                    }
-                    x0 = _particles[iMarker]->GetIprocMarkerOldCoordinates();
-                    MPI_Send(&x0[0], _dim, MPI_DOUBLE, mproc, order , PETSC_COMM_WORLD);
-                  }
-                  _particles[iMarker]->FreeXiX0andK();
+      // markers whose search ended in this process: (marker, element) pairs to be shared with all the processes
+      std::vector < unsigned > migratedMarkers;
+      std::vector < double > recvBuffer;
+      const unsigned recordSize = 4 + _dim * (2 + order);
 
-                }
-                else if(mproc == _iproc) {
+      while(true) {
+        unsigned localRecords = 0;
+        for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+          localRecords += sendBuffer[jproc].size();
+        }
+        unsigned globalRecords;
+        MPI_Allreduce(&localRecords, &globalRecords, 1, MPI_UNSIGNED, MPI_SUM, PETSC_COMM_WORLD);
+        if(globalRecords == 0) break;
 
-                  _particles[iMarker]->InitializeX0andK(order);
+        ExchangeMarkerStates(sendBuffer, recvBuffer);
 
-                  unsigned step;
-                  MPI_Recv(& step, 1, MPI_UNSIGNED, jproc, order + 1, PETSC_COMM_WORLD, MPI_STATUS_IGNORE);
-                  _particles[iMarker]->SetIprocMarkerStep(step);
+        for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+          sendBuffer[jproc].resize(0);
+        }
 
-                  unsigned istep = step % order;
-                  if(istep != 0) {
-                    for(int i = 0; i < order; i++) {
-                      MPI_Recv(&K[i][0], _dim, MPI_DOUBLE, jproc, i , PETSC_COMM_WORLD, MPI_STATUS_IGNORE);
-                      _particles[iMarker]->SetIprocMarkerK(K);
-                    }
-                    MPI_Recv(&x0[0], _dim, MPI_DOUBLE, jproc, order , PETSC_COMM_WORLD, MPI_STATUS_IGNORE);
-                    _particles[iMarker]->SetIprocMarkerOldCoordinates(x0);
+        for(unsigned r = 0; r < recvBuffer.size(); r += recordSize) {
+          const double *record = &recvBuffer[r];
+          unsigned iMarker = static_cast < unsigned >(record[0]);
+          unsigned elem = static_cast < unsigned >(record[1]);
+          unsigned prevElem = static_cast < unsigned >(record[2]);
+          unsigned step = static_cast < unsigned >(record[3]);
+          record += 4;
+
+          x.assign(record, record + _dim);
+          x0.assign(record + _dim, record + 2 * _dim);
+          K.resize(order);
+          for(unsigned j = 0; j < order; j++) {
+            K[j].assign(record + (2 + j) * _dim, record + (3 + j) * _dim);
+          }
 
-                  }
-                }
-              }
-            }
+          _particles[iMarker]->SetMarkerElement(elem);
+          _particles[iMarker]->SetIprocMarkerStep(step);
+          _particles[iMarker]->SetIprocMarkerCoordinates(x);
+
+          if(elem != UINT_MAX) {
+            _particles[iMarker]->InitializeX0andK(order);
+            _particles[iMarker]->SetIprocMarkerOldCoordinates(x0);
+            _particles[iMarker]->SetIprocMarkerK(K);
+
+            _particles[iMarker]->GetMarkerS(n, order, s);
+            _particles[iMarker]->GetElementSerial(prevElem, _sol, s);
+            _particles[iMarker]->SetIprocMarkerPreviousElement(prevElem);
           }
-          if(elem == UINT_MAX && jproc != 0) { // elem = UINT_MAX, but not yet in jproc = 0
-            if(jproc == _iproc) {
-              x = _particles[iMarker]->GetIprocMarkerCoordinates();
-              MPI_Send(&x[0], _dim, MPI_DOUBLE, 0, 1 , PETSC_COMM_WORLD);
-              _particles[iMarker]->FreeXiX0andK();
-            }
-            else if(_iproc == 0) {
-              _particles[iMarker]->InitializeX();
-              MPI_Recv(&x[0], _dim, MPI_DOUBLE, jproc, 1 , PETSC_COMM_WORLD, MPI_STATUS_IGNORE);
-              _particles[iMarker]->SetIprocMarkerCoordinates(x);
-            }
+
+          unsigned mproc = _particles[iMarker]->GetMarkerProc(_sol);
+          if(mproc != _iproc) { // the marker crossed another process boundary or left the domain
+            PackMarkerState(iMarker, order, sendBuffer[mproc]);
+          }
+          else {
+            migratedMarkers.push_back(iMarker);
+            migratedMarkers.push_back(_particles[iMarker]->GetMarkerElement());
           }
         }
       }
 
-      MPI_Barrier(PETSC_COMM_WORLD);
+      // share the final element of the migrated markers
+      int migratedSize = migratedMarkers.size();
+      std::vector < int > migratedCounts(_nprocs);
+      MPI_Allgather(&migratedSize, 1, MPI_INT, &migratedCounts[0], 1, MPI_INT, PETSC_COMM_WORLD);
+
+      std::vector < int > migratedDispls(_nprocs, 0);
+      for(unsigned jproc = 1; jproc < _nprocs; jproc++) {
+        migratedDispls[jproc] = migratedDispls[jproc - 1] + migratedCounts[jproc - 1];
+      }
+      unsigned migratedTotal = migratedDispls[_nprocs - 1] + migratedCounts[_nprocs - 1];
+
+      migratedMarkers.resize(migratedSize + 1);
+      std::vector < unsigned > allMigratedMarkers(migratedTotal + 1);
+      MPI_Allgatherv(&migratedMarkers[0], migratedSize, MPI_UNSIGNED,
+                     &allMigratedMarkers[0], &migratedCounts[0], &migratedDispls[0], MPI_UNSIGNED, PETSC_COMM_WORLD);
+
+      for(unsigned i = 0; i < migratedTotal; i += 2) {
+        _particles[allMigratedMarkers[i]]->SetMarkerElement(allMigratedMarkers[i + 1]);
+        _particles[allMigratedMarkers[i]]->GetMarkerProc(_sol);
+      }
+
       _time[1] += static_cast<double>((clock() - startTime)) / CLOCKS_PER_SEC;
       startTime = clock();
 
@@ -847,7 +874,6 @@ namespace femus {
 
       UpdateLine();
 
-      MPI_Barrier(PETSC_COMM_WORLD);
       _time[2] += static_cast<double>((clock() - startTime)) / CLOCKS_PER_SEC;
       startTime = clock();
 
@@ -875,6 +901,67 @@ namespace femus {
   }
 
 
+  void Line::PackMarkerState(const unsigned &iMarker, const unsigned &order, std::vector < double > &buffer) {
+
+    std::vector < double > x = _particles[iMarker]->GetIprocMarkerCoordinates();
+    std::vector < double > x0 = _particles[iMarker]->GetIprocMarkerOldCoordinates();
+    std::vector < std::vector < double > > K = _particles[iMarker]->GetIprocMarkerK();
+
+    buffer.push_back(iMarker);
+    buffer.push_back(_particles[iMarker]->GetMarkerElement());
+    buffer.push_back(_particles[iMarker]->GetIprocMarkerPreviousElement());
+    buffer.push_back(_particles[iMarker]->GetIprocMarkerStep());
+
+    for(unsigned k = 0; k < _dim; k++) {
+      buffer.push_back((k < x.size()) ? x[k] : 0.);
+    }
+    for(unsigned k = 0; k < _dim; k++) {
+      buffer.push_back((k < x0.size()) ? x0[k] : 0.);
+    }
+    for(unsigned j = 0; j < order; j++) {
+      for(unsigned k = 0; k < _dim; k++) {
+        buffer.push_back((j < K.size() && k < K[j].size()) ? K[j][k] : 0.);
+      }
+    }
+
+    // the marker state now belongs to the receiving process
+    _particles[iMarker]->FreeXiX0andK();
+    _particles[iMarker]->SetIprocMarkerCoordinates(std::vector < double > ());
+  }
+
+
+  void Line::ExchangeMarkerStates(const std::vector < std::vector < double > > &sendBuffer, std::vector < double > &recvBuffer) {
+
+    std::vector < int > sendCounts(_nprocs);
+    std::vector < int > sendDispls(_nprocs, 0);
+    for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+      sendCounts[jproc] = sendBuffer[jproc].size();
+      if(jproc > 0) sendDispls[jproc] = sendDispls[jproc - 1] + sendCounts[jproc - 1];
+    }
+
+    std::vector < int > recvCounts(_nprocs);
+    MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &recvCounts[0], 1, MPI_INT, PETSC_COMM_WORLD);
+
+    std::vector < int > recvDispls(_nprocs, 0);
+    for(unsigned jproc = 1; jproc < _nprocs; jproc++) {
+      recvDispls[jproc] = recvDispls[jproc - 1] + recvCounts[jproc - 1];
+    }
+
+    unsigned sendSize = sendDispls[_nprocs - 1] + sendCounts[_nprocs - 1];
+    unsigned recvSize = recvDispls[_nprocs - 1] + recvCounts[_nprocs - 1];
+
+    std::vector < double > sendData(sendSize + 1);
+    for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+      std::copy(sendBuffer[jproc].begin(), sendBuffer[jproc].end(), sendData.begin() + sendDispls[jproc]);
+    }
+
+    recvBuffer.resize(recvSize + 1);
+    MPI_Alltoallv(&sendData[0], &sendCounts[0], &sendDispls[0], MPI_DOUBLE,
+                  &recvBuffer[0], &recvCounts[0], &recvDispls[0], MPI_DOUBLE, PETSC_COMM_WORLD);
+    recvBuffer.resize(recvSize);
+  }
+
+
   void Line::MagneticForceWire(const std::vector <double> & xMarker, std::vector <double> &Fm, const unsigned &material) {
 
     double PI = acos(-1.);
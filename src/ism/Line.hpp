@@ -58,6 +58,13 @@ namespace femus {
 
 
     private:
+
+      /** Appends the advection state of the marker iMarker to buffer and frees it in this process */
+      void PackMarkerState(const unsigned &iMarker, const unsigned &order, std::vector < double > &buffer);
+
+      /** Sends sendBuffer[jproc] to every process jproc and collects in recvBuffer what the other processes sent */
+      void ExchangeMarkerStates(const std::vector < std::vector < double > > &sendBuffer, std::vector < double > &recvBuffer);
+
       std::vector < std::vector < double > > _line;
 
       std::vector < Marker*> _particles;  
@@ -19,6 +19,7 @@
 #include "Marker.hpp"
 #include "Line.hpp"
 #include "NumericVector.hpp"
+#include "ElementBinGrid.hpp"
 #include <math.h>
 
 #include "PolynomialBases.hpp"
@@ -182,50 +183,67 @@ namespace femus {
     unsigned ielProc = (initialElem < sol->GetMesh()->_elementOffset[_nprocs]) ?
                        sol->GetMesh()->IsdomBisectionSearch(iel, 3) : _nprocs;
 
-    if(useInitialSearch || _iproc != ielProc) {
+    // the bin grid is built on the undeformed coordinates, in FSI the mesh moves
+    bool useBinGrid = !sol->GetIfFSI();
+    bool binGridRestart = false;
 
-      //BEGIN SMART search
-      // look to the closest element among a restricted list
+    if(useInitialSearch || _iproc != ielProc) {
 
       iel = UINT_MAX;
 
-      double modulus = 1.e10;
+      if(useBinGrid) {
+        //BEGIN bin grid search
+        // start from the owned element whose bounding box contains the marker, UINT_MAX if there is none
+        iel = sol->GetMesh()->GetElementBinGrid().FindElement(_x);
+        //END bin grid search
+      }
+      else {
 
-      for(int jel = sol->GetMesh()->_elementOffset[_iproc]; jel < sol->GetMesh()->_elementOffset[_iproc + 1]; jel += 25) {
+        //BEGIN SMART search
+        // look to the closest element among a restricted list
 
-        unsigned interiorNode = sol->GetMesh()->GetElementDofNumber(jel, 2) - 1;
-        unsigned jDof  = sol->GetMesh()->GetSolutionDof(interiorNode, jel, 2);    // global to global mapping between coordinates node and coordinate dof
+        double modulus = 1.e10;
 
-        double distance2 = 0;
+        for(int jel = sol->GetMesh()->_elementOffset[_iproc]; jel < sol->GetMesh()->_elementOffset[_iproc + 1]; jel += 25) {
 
-        for(unsigned k = 0; k < _dim; k++) {
-          double dk = GetCoordinates(sol, k, jDof, s) - _x[k];   // global extraction and local storage for the element coordinates
-          distance2 += dk * dk;
-        }
+          unsigned interiorNode = sol->GetMesh()->GetElementDofNumber(jel, 2) - 1;
+          unsigned jDof  = sol->GetMesh()->GetSolutionDof(interiorNode, jel, 2);    // global to global mapping between coordinates node and coordinate dof
 
-        double modulusKel = sqrt(distance2);
+          double distance2 = 0;
 
-        if(modulusKel < modulus) {
-          iel = jel;
-          modulus = modulusKel;
+          for(unsigned k = 0; k < _dim; k++) {
+            double dk = GetCoordinates(sol, k, jDof, s) - _x[k];   // global extraction and local storage for the element coordinates
+            distance2 += dk * dk;
+          }
+
+          double modulusKel = sqrt(distance2);
+
+          if(modulusKel < modulus) {
+            iel = jel;
+            modulus = modulusKel;
+          }
         }
-      }
 
-      if(iel == UINT_MAX) {
-        //  std::cout << "Warning the marker is located on unreasonable distance from the mesh >= 1.e10" << std::endl;
-      }
-      else {
-        //  std::cout << "the smart search starts from element " << iel << std::endl;
-      }
+        if(iel == UINT_MAX) {
+          //  std::cout << "Warning the marker is located on unreasonable distance from the mesh >= 1.e10" << std::endl;
+        }
+        else {
+          //  std::cout << "the smart search starts from element " << iel << std::endl;
+        }
 
 
-      //END SMART search:
+        //END SMART search:
+      }
     }
 
 
     bool elementHasBeenFound = false;
     bool pointIsOutsideThisProcess = false;
-    bool pointIsOutsideTheDomain = false;
+    bool pointIsOutsideTheDomain = (iel == UINT_MAX); // no owned element can contain the marker
+
+    if(pointIsOutsideTheDomain) {
+      processorMarkerFlag[_iproc] = 0;
+    }
 
     std::vector< unsigned > nextElem(_nprocs, UINT_MAX);
     std::vector< unsigned > previousElem(_nprocs, UINT_MAX);
@@ -251,8 +269,16 @@ namespace femus {
           processorMarkerFlag[_iproc] = 1;
         }
         else if(nextElem[_iproc] == UINT_MAX) {
-          pointIsOutsideTheDomain = true;
-          processorMarkerFlag[_iproc] = 0;
+          unsigned binGridElem = (useBinGrid && !binGridRestart) ? sol->GetMesh()->GetElementBinGrid().FindElement(_x) : UINT_MAX;
+          if(binGridElem != UINT_MAX && binGridElem != iel) { // the walk left the domain, restart once from the bin grid element
+            binGridRestart = true;
+            iel = binGridElem;
+            previousElem[_iproc] = iel;
+          }
+          else {
+            pointIsOutsideTheDomain = true;
+            processorMarkerFlag[_iproc] = 0;
+          }
         }
         else {
           nextProc = sol->GetMesh()->IsdomBisectionSearch(nextElem[_iproc], 3);
@@ -412,6 +438,7 @@ namespace femus {
     bool elementHasBeenFound = false;
     bool pointIsOutsideThisProcess = false;
     bool pointIsOutsideTheDomain = false;
+    bool binGridRestart = sol->GetIfFSI(); // the bin grid is built on the undeformed coordinates
 
     //BEGIN next element search
     while(elementHasBeenFound + pointIsOutsideThisProcess + pointIsOutsideTheDomain == 0) {
@@ -431,8 +458,16 @@ namespace femus {
         elementHasBeenFound = true;
       }
       else if(_elem  == UINT_MAX) {
-        pointIsOutsideTheDomain = true;
-        break;
+        unsigned binGridElem = (!binGridRestart) ? sol->GetMesh()->GetElementBinGrid().FindElement(_x) : UINT_MAX;
+        if(binGridElem != UINT_MAX && binGridElem != currentElem) { // the walk left the domain, restart once from the bin grid element
+          binGridRestart = true;
+          currentElem = binGridElem;
+          previousElem = binGridElem;
+        }
+        else {
+          pointIsOutsideTheDomain = true;
+          break;
+        }
       }
       else {
         _mproc = sol->GetMesh()->IsdomBisectionSearch(_elem , 3);
@@ -499,6 +499,10 @@ namespace femus {
     _elementDof.broadcast(jproc);
   }
 
+  void elem::LocalizeElementDof() {
+    _elementDof.localize();
+  }
+
   unsigned elem::GetElementDofIndex(const unsigned& iel, const unsigned& inode) {
     return _elementDof[iel][inode];
   };
@@ -515,6 +519,10 @@ namespace femus {
     _elementNearFace.broadcast(jproc);
   }
 
+  void elem::LocalizeElementNearFace() {
+    _elementNearFace.localize();
+  }
+
   void elem::FreeLocalizedElementNearFace() {
     _elementNearFace.clearBroadcast();
   }
@@ -55,10 +55,12 @@ namespace femus {
 
       void ScatterElementNearFace();
       void LocalizeElementNearFace(const unsigned& jproc);
+      void LocalizeElementNearFace();
       void FreeLocalizedElementNearFace();
 
       void ScatterElementDof();
       void LocalizeElementDof(const unsigned &jproc);
+      void LocalizeElementDof();
       void FreeLocalizedElementDof();
 
       // reorder the element according to the new element mapping
@@ -188,6 +190,13 @@ namespace femus {
         _elementMaterial.broadcast(lproc);
         _elementGroup.broadcast(lproc);
       }
+      /** Gathers the element quantities of all the processes with a single collective per quantity */
+      void LocalizeElementQuantities() {
+        _elementLevel.localize();
+        _elementType.localize();
+        _elementMaterial.localize();
+        _elementGroup.localize();
+      }
       void FreeLocalizedElementQuantities() {
         _elementLevel.clearBroadcast();
         _elementType.clearBroadcast();
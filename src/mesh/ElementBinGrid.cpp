@@ -0,0 +1,203 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: ElementBinGrid
+ Authors: Eugenio Aulisa
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "ElementBinGrid.hpp"
+#include "Mesh.hpp"
+#include "NumericVector.hpp"
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+
+namespace femus {
+
+//------------------------------------------------------------------------------------------------------
+  ElementBinGrid::ElementBinGrid() : _dim(0), _elementOffset(0) {
+    for(unsigned k = 0; k < 3; k++) {
+      _xMin[k] = 0.;
+      _h[k] = 1.;
+      _nBins[k] = 1;
+    }
+  }
+
+//------------------------------------------------------------------------------------------------------
+  void ElementBinGrid::Build(const Mesh *msh) {
+
+    _dim = msh->GetDimension();
+    const unsigned xType = 2;
+
+    unsigned iproc = msh->processor_id();
+    _elementOffset = msh->_elementOffset[iproc];
+    unsigned nel = msh->_elementOffset[iproc + 1] - _elementOffset;
+
+    std::vector < NumericVectorLocalView > xView(_dim);
+    for(unsigned k = 0; k < _dim; k++) {
+      xView[k] = msh->_topology->_Sol[k]->GetLocalView();
+    }
+
+    // element bounding boxes and centers
+    _box.assign(2 * _dim * nel, 0.);
+    _center.assign(_dim * nel, 0.);
+
+    double xMax[3];
+    for(unsigned k = 0; k < _dim; k++) {
+      _xMin[k] = 1.e300;
+      xMax[k] = -1.e300;
+    }
+
+    for(unsigned iloc = 0; iloc < nel; iloc++) {
+      unsigned iel = _elementOffset + iloc;
+      unsigned nDofsX = msh->GetElementDofNumber(iel, xType);
+      double *box = &_box[2 * _dim * iloc];
+
+      for(unsigned k = 0; k < _dim; k++) {
+        box[2 * k] = 1.e300;
+        box[2 * k + 1] = -1.e300;
+      }
+
+      for(unsigned i = 0; i < nDofsX; i++) {
+        unsigned xDof = msh->GetSolutionDof(i, iel, xType);
+        for(unsigned k = 0; k < _dim; k++) {
+          double xk = xView[k](xDof);
+          box[2 * k] = std::min(box[2 * k], xk);
+          box[2 * k + 1] = std::max(box[2 * k + 1], xk);
+          _center[_dim * iloc + k] += xk / nDofsX;
+        }
+      }
+
+      // a small inflation makes points on the element boundary fall inside the box
+      double diag = 0.;
+      for(unsigned k = 0; k < _dim; k++) {
+        diag += (box[2 * k + 1] - box[2 * k]) * (box[2 * k + 1] - box[2 * k]);
+      }
+      double eps = 1.0e-8 * sqrt(diag);
+
+      for(unsigned k = 0; k < _dim; k++) {
+        box[2 * k] -= eps;
+        box[2 * k + 1] += eps;
+        _xMin[k] = std::min(_xMin[k], box[2 * k]);
+        xMax[k] = std::max(xMax[k], box[2 * k + 1]);
+      }
+    }
+
+    // about one element per bin
+    unsigned nBinsPerDirection = (nel > 0) ? static_cast < unsigned >(ceil(pow(static_cast < double >(nel), 1. / _dim))) : 1;
+    unsigned nBins = 1;
+    for(unsigned k = 0; k < 3; k++) {
+      _nBins[k] = (k < _dim) ? nBinsPerDirection : 1;
+      _h[k] = 1.;
+      if(k < _dim && nel > 0) {
+        _h[k] = (xMax[k] - _xMin[k]) / _nBins[k];
+        if(_h[k] <= 0.) _h[k] = 1.;
+      }
+      nBins *= _nBins[k];
+    }
+
+    // count, then fill, the elements overlapping each bin
+    _binOffset.assign(nBins + 1, 0);
+
+    for(unsigned pass = 0; pass < 2; pass++) {
+      std::vector < unsigned > binFill;
+      if(pass == 1) {
+        for(unsigned i = 0; i < nBins; i++) _binOffset[i + 1] += _binOffset[i];
+        _binElements.resize(_binOffset[nBins]);
+        binFill.assign(_binOffset.begin(), _binOffset.end() - 1);
+      }
+
+      for(unsigned iloc = 0; iloc < nel; iloc++) {
+        const double *box = &_box[2 * _dim * iloc];
+        unsigned lo[3] = {0, 0, 0};
+        unsigned hi[3] = {0, 0, 0};
+        for(unsigned k = 0; k < _dim; k++) {
+          lo[k] = std::min(static_cast < unsigned >((box[2 * k] - _xMin[k]) / _h[k]), _nBins[k] - 1);
+          hi[k] = std::min(static_cast < unsigned >((box[2 * k + 1] - _xMin[k]) / _h[k]), _nBins[k] - 1);
+        }
+        for(unsigned i = lo[0]; i <= hi[0]; i++) {
+          for(unsigned j = lo[1]; j <= hi[1]; j++) {
+            for(unsigned l = lo[2]; l <= hi[2]; l++) {
+              unsigned bin = (l * _nBins[1] + j) * _nBins[0] + i;
+              if(pass == 0) _binOffset[bin + 1]++;
+              else _binElements[binFill[bin]++] = iloc;
+            }
+          }
+        }
+      }
+    }
+  }
+
+//------------------------------------------------------------------------------------------------------
+  unsigned ElementBinGrid::GetBin(const double *x) const {
+    unsigned index[3] = {0, 0, 0};
+    for(unsigned k = 0; k < _dim; k++) {
+      double t = (x[k] - _xMin[k]) / _h[k];
+      if(t < 0. || t > _nBins[k]) return UINT_MAX;
+      index[k] = std::min(static_cast < unsigned >(t), _nBins[k] - 1);
+    }
+    return (index[2] * _nBins[1] + index[1]) * _nBins[0] + index[0];
+  }
+
+//------------------------------------------------------------------------------------------------------
+  unsigned ElementBinGrid::FindElement(const std::vector < double > &x) const {
+
+    if(_binOffset.size() == 0 || x.size() < _dim) return UINT_MAX;
+
+    unsigned bin = GetBin(&x[0]);
+    if(bin == UINT_MAX) return UINT_MAX;
+
+    unsigned elem = UINT_MAX;
+    double distance2Min = 1.e300;
+
+    for(unsigned j = _binOffset[bin]; j < _binOffset[bin + 1]; j++) {
+      unsigned iloc = _binElements[j];
+      const double *box = &_box[2 * _dim * iloc];
+
+      bool inside = true;
+      for(unsigned k = 0; k < _dim; k++) {
+        if(x[k] < box[2 * k] || x[k] > box[2 * k + 1]) {
+          inside = false;
+          break;
+        }
+      }
+
+      if(inside) {
+        double distance2 = 0.;
+        for(unsigned k = 0; k < _dim; k++) {
+          double dk = x[k] - _center[_dim * iloc + k];
+          distance2 += dk * dk;
+        }
+        if(distance2 < distance2Min) {
+          distance2Min = distance2;
+          elem = _elementOffset + iloc;
+        }
+      }
+    }
+
+    return elem;
+  }
+
+//------------------------------------------------------------------------------------------------------
+  void ElementBinGrid::FindElements(const std::vector < std::vector < double > > &x, std::vector < unsigned > &elem) const {
+    elem.resize(x.size());
+    for(unsigned i = 0; i < x.size(); i++) {
+      elem[i] = FindElement(x[i]);
+    }
+  }
+
+
+} //end namespace femus
@@ -0,0 +1,77 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: ElementBinGrid
+ Authors: Eugenio Aulisa
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_mesh_ElementBinGrid_hpp__
+#define __femus_mesh_ElementBinGrid_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include <vector>
+
+
+namespace femus {
+
+class Mesh;
+
+/**
+ * Uniform bin grid over the bounding boxes of the elements owned by this process,
+ * built from the _topology coordinates. It returns in constant time the owned
+ * element from which a point location walk should start.
+ */
+class ElementBinGrid {
+
+public:
+
+    /** Constructor */
+    ElementBinGrid();
+
+    /** Fills the grid with the owned elements of msh */
+    void Build(const Mesh *msh);
+
+    /** Returns the owned element, among those whose bounding box contains x, with the closest center,
+     * or UINT_MAX if no owned element box contains x */
+    unsigned FindElement(const std::vector < double > &x) const;
+
+    /** Batched version of FindElement for the points x[i][k], i = 0,...,x.size()-1 */
+    void FindElements(const std::vector < std::vector < double > > &x, std::vector < unsigned > &elem) const;
+
+private:
+
+    /** Returns the bin containing x, or UINT_MAX if x is outside the grid */
+    unsigned GetBin(const double *x) const;
+
+    unsigned _dim;
+    unsigned _elementOffset;
+
+    double _xMin[3];
+    double _h[3];
+    unsigned _nBins[3];
+
+    /** bounding box (min, max for each direction) and center of each owned element */
+    std::vector < double > _box;
+    std::vector < double > _center;
+
+    /** elements overlapping bin i are _binElements[_binOffset[i]], ..., _binElements[_binOffset[i + 1] - 1] */
+    std::vector < unsigned > _binOffset;
+    std::vector < unsigned > _binElements;
+};
+
+
+} //end namespace femus
+
+
+
+#endif
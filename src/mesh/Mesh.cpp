@@ -22,6 +22,8 @@
 #include "GambitIO.hpp"
 #include "SalomeIO.hpp"
 #include "NumericVector.hpp"
+#include "ElementBinGrid.hpp"
+#include "ElementBatch.hpp"
 
 // C++ includes
 #include <iostream>
@@ -41,6 +43,7 @@ namespace femus {
   using std::map;
 
   bool Mesh::_IsUserRefinementFunctionDefined = false;
+  bool Mesh::_localityReordering = false;
 
   unsigned Mesh::_dimension = 2;
   unsigned Mesh::_ref_index = 4; // 8*DIM[2]+4*DIM[1]+2*DIM[0];
@@ -50,6 +53,7 @@ namespace femus {
   Mesh::Mesh() {
 
     _coarseMsh = NULL;
+    _elementBinGrid = NULL;
 
     for(int i = 0; i < 5; i++) {
       _ProjCoarseToFine[i] = NULL;
@@ -83,6 +87,8 @@ namespace femus {
         _ProjCoarseToFine[i] = NULL;
       }
     }
+
+    delete _elementBinGrid;
   }
 
 /// print Mesh info
@@ -369,10 +375,20 @@ namespace femus {
     mapping.resize(GetNumberOfElements());
 
     //BEGIN building the  metis2Gambit_elem and  k = 3,4
+    std::vector < unsigned > elementOrder(GetNumberOfElements());
+    for(unsigned iel = 0; iel < GetNumberOfElements(); iel++) {
+      elementOrder[iel] = iel;
+    }
+    // the finer levels inherit the order of the coarse fathers
+    if(_localityReordering && GetLevel() == 0) {
+      HilbertElementOrder(elementOrder);
+    }
+
     unsigned counter = 0;
 
     for(int isdom = 0; isdom < _nprocs; isdom++) { // isdom = iprocess
-      for(unsigned iel = 0; iel < GetNumberOfElements(); iel++) {
+      for(unsigned i = 0; i < GetNumberOfElements(); i++) {
+        unsigned iel = elementOrder[i];
         if(partition[iel] == isdom) {
           //filling the Metis to Mesh element mapping
           mapping[ iel ] = counter;
@@ -417,8 +433,16 @@ namespace femus {
 
     counter = 0;
 
+    std::vector < unsigned > layerNodes;
+    std::vector < int > localIndex;
+    if(_localityReordering) {
+      localIndex.assign(GetNumberOfNodes(), -1);
+    }
+
     for(int isdom = 0; isdom < _nprocs; isdom++) {
       for(unsigned k = 0; k < 3; k++) {
+        // the nodes of type k first touched by the elements of isdom, in element order
+        layerNodes.resize(0);
         for(unsigned iel = _elementOffset[isdom]; iel < _elementOffset[isdom + 1]; iel++) {
           unsigned nodeStart = (k == 0) ? 0 : el->GetElementDofNumber(iel, k - 1);
           unsigned nodeEnd = el->GetElementDofNumber(iel, k);
@@ -428,8 +452,7 @@ namespace femus {
 
             if(partition[ii] > isdom) {
               partition[ii] = isdom;
-              mapping[ii] = counter;
-              counter++;
+              layerNodes.push_back(ii);
 
               for(int j = k; j < 3; j++) {
                 _ownSize[j][isdom]++;
@@ -437,6 +460,15 @@ namespace femus {
             }
           }
         }
+
+        if(_localityReordering) {
+          ReverseCuthillMcKee(layerNodes, _elementOffset[isdom], _elementOffset[isdom + 1], k, localIndex);
+        }
+
+        for(unsigned i = 0; i < layerNodes.size(); i++) {
+          mapping[layerNodes[i]] = counter;
+          counter++;
+        }
       }
     }
 
@@ -564,6 +596,177 @@ namespace femus {
 
   }
 
+// *******************************************************
+
+  namespace {
+    /** Hilbert index of the integer coordinates X, of bits bits each, in dim = 2 or 3 dimensions
+     * (J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707, 2004) */
+    unsigned HilbertIndex(unsigned X[3], const unsigned &bits, const unsigned &dim) {
+      unsigned M = 1u << (bits - 1);
+
+      // inverse undo
+      for(unsigned Q = M; Q > 1; Q >>= 1) {
+        unsigned P = Q - 1;
+        for(unsigned i = 0; i < dim; i++) {
+          if(X[i] & Q) {
+            X[0] ^= P;
+          }
+          else {
+            unsigned t = (X[0] ^ X[i]) & P;
+            X[0] ^= t;
+            X[i] ^= t;
+          }
+        }
+      }
+
+      // Gray encode
+      for(unsigned i = 1; i < dim; i++) {
+        X[i] ^= X[i - 1];
+      }
+      unsigned t = 0;
+      for(unsigned Q = M; Q > 1; Q >>= 1) {
+        if(X[dim - 1] & Q) t ^= Q - 1;
+      }
+      for(unsigned i = 0; i < dim; i++) {
+        X[i] ^= t;
+      }
+
+      // interleave the transposed bits
+      unsigned index = 0;
+      for(int b = bits - 1; b >= 0; b--) {
+        for(unsigned i = 0; i < dim; i++) {
+          index = (index << 1) | ((X[i] >> b) & 1u);
+        }
+      }
+      return index;
+    }
+  }
+
+  void Mesh::HilbertElementOrder(std::vector < unsigned > &elementOrder) {
+
+    unsigned dim = GetDimension();
+    unsigned bits = 30 / dim;
+    double scale = static_cast < double >((1u << bits) - 1u);
+
+    double xmin[3], xmax[3];
+    for(unsigned d = 0; d < dim; d++) {
+      xmin[d] = *std::min_element(_coords[d].begin(), _coords[d].end());
+      xmax[d] = *std::max_element(_coords[d].begin(), _coords[d].end());
+    }
+
+    std::vector < std::pair < unsigned, unsigned > > key(GetNumberOfElements());
+    for(unsigned iel = 0; iel < GetNumberOfElements(); iel++) {
+      unsigned nve = el->GetElementDofNumber(iel, 0);
+      unsigned X[3] = {0, 0, 0};
+      for(unsigned d = 0; d < dim; d++) {
+        double xc = 0.;
+        for(unsigned inode = 0; inode < nve; inode++) {
+          xc += _coords[d][ el->GetElementDofIndex(iel, inode) ];
+        }
+        xc /= nve;
+        if(xmax[d] > xmin[d]) {
+          X[d] = static_cast < unsigned >((xc - xmin[d]) / (xmax[d] - xmin[d]) * scale + 0.5);
+        }
+      }
+      key[iel] = std::make_pair((dim == 1) ? X[0] : HilbertIndex(X, bits, dim), iel);
+    }
+
+    sort(key.begin(), key.end());
+
+    for(unsigned i = 0; i < key.size(); i++) {
+      elementOrder[i] = key[i].second;
+    }
+  }
+
+// *******************************************************
+
+  void Mesh::ReverseCuthillMcKee(std::vector < unsigned > &nodes, const unsigned &elementStart, const unsigned &elementEnd,
+                                 const unsigned &k, std::vector < int > &localIndex) {
+
+    unsigned n = nodes.size();
+    if(n < 3) return;
+
+    for(unsigned i = 0; i < n; i++) {
+      localIndex[nodes[i]] = i;
+    }
+
+    // elements around each node, in compressed row format
+    std::vector < unsigned > rowOffset(n + 1, 0);
+    for(unsigned iel = elementStart; iel < elementEnd; iel++) {
+      unsigned nodeStart = (k == 0) ? 0 : el->GetElementDofNumber(iel, k - 1);
+      unsigned nodeEnd = el->GetElementDofNumber(iel, k);
+      for(unsigned inode = nodeStart; inode < nodeEnd; inode++) {
+        int i = localIndex[ el->GetElementDofIndex(iel, inode) ];
+        if(i >= 0) rowOffset[i + 1]++;
+      }
+    }
+    for(unsigned i = 0; i < n; i++) {
+      rowOffset[i + 1] += rowOffset[i];
+    }
+
+    std::vector < unsigned > nodeElements(rowOffset[n]);
+    std::vector < unsigned > rowCounter(rowOffset.begin(), rowOffset.end() - 1);
+    for(unsigned iel = elementStart; iel < elementEnd; iel++) {
+      unsigned nodeStart = (k == 0) ? 0 : el->GetElementDofNumber(iel, k - 1);
+      unsigned nodeEnd = el->GetElementDofNumber(iel, k);
+      for(unsigned inode = nodeStart; inode < nodeEnd; inode++) {
+        int i = localIndex[ el->GetElementDofIndex(iel, inode) ];
+        if(i >= 0) {
+          nodeElements[rowCounter[i]] = iel;
+          rowCounter[i]++;
+        }
+      }
+    }
+
+    // the number of elements around a node is used as its degree, each component starts from a node of minimum degree
+    std::vector < std::pair < unsigned, unsigned > > startCandidates(n);
+    for(unsigned i = 0; i < n; i++) {
+      startCandidates[i] = std::make_pair(rowOffset[i + 1] - rowOffset[i], i);
+    }
+    sort(startCandidates.begin(), startCandidates.end());
+
+    std::vector < unsigned > order;
+    order.reserve(n);
+    std::vector < bool > visited(n, false);
+    std::vector < std::pair < unsigned, unsigned > > neighbours;
+
+    for(unsigned s = 0; s < n; s++) {
+      unsigned start = startCandidates[s].second;
+      if(visited[start]) continue;
+
+      visited[start] = true;
+      order.push_back(start);
+
+      for(unsigned head = order.size() - 1; head < order.size(); head++) {
+        unsigned i = order[head];
+        neighbours.resize(0);
+        for(unsigned j = rowOffset[i]; j < rowOffset[i + 1]; j++) {
+          unsigned iel = nodeElements[j];
+          unsigned nodeStart = (k == 0) ? 0 : el->GetElementDofNumber(iel, k - 1);
+          unsigned nodeEnd = el->GetElementDofNumber(iel, k);
+          for(unsigned inode = nodeStart; inode < nodeEnd; inode++) {
+            int jnode = localIndex[ el->GetElementDofIndex(iel, inode) ];
+            if(jnode >= 0 && !visited[jnode]) {
+              visited[jnode] = true;
+              neighbours.push_back(std::make_pair(rowOffset[jnode + 1] - rowOffset[jnode], jnode));
+            }
+          }
+        }
+        sort(neighbours.begin(), neighbours.end());
+        for(unsigned j = 0; j < neighbours.size(); j++) {
+          order.push_back(neighbours[j].second);
+        }
+      }
+    }
+
+    std::vector < unsigned > cuthillMcKeeNodes(n);
+    for(unsigned i = 0; i < n; i++) {
+      cuthillMcKeeNodes[n - 1 - i] = nodes[order[i]];
+      localIndex[nodes[i]] = -1;
+    }
+    nodes.swap(cuthillMcKeeNodes);
+  }
+
 
 // *******************************************************
   unsigned Mesh::IsdomBisectionSearch(const unsigned &dof, const short unsigned &solType) const {
@@ -926,19 +1129,12 @@ namespace femus {
 //     std::cout << " ********************************** "<< std::endl;
 //     std::cout << "nnodes before = "  << nnodes << std::endl;
 
-    //intialize to UINT_MAX
-    for(unsigned iel = 0; iel < el->GetElementNumber(); iel++) {
-      unsigned elementType = el->GetElementType(iel);
+    // generate face dofs for tet and wedge elements:
+    // the triangular faces are hashed on their smallest vertex index, and each bucket stores
+    // the triplets (middle vertex, largest vertex, face-center dof) of the faces not yet matched.
+    // Every face is visited once, so the search is linear in the number of elements
+    std::vector < std::vector < unsigned > > faceBucket(nnodes);
 
-      if(elementType == 1 || elementType == 2) {
-        for(unsigned inode = el->GetElementDofNumber(iel, 2) - _numberOfMissedBiquadraticNodes[elementType];
-            inode < el->GetElementDofNumber(iel, 2); inode++) {
-          el->SetElementDofIndex(iel, inode, UINT_MAX);
-        }
-      }
-    }
-
-    // generate face dofs for tet and wedge elements
     for(unsigned iel = 0; iel < el->GetElementNumber(); iel++) {
       unsigned elementType = el->GetElementType(iel);
 
@@ -946,43 +1142,42 @@ namespace femus {
         for(unsigned iface = el->GetElementFaceNumber(iel, 0); iface < el->GetElementFaceNumber(iel, 1); iface++) {       //on all the faces that are triangles
           unsigned inode = el->GetElementDofNumber(iel, 1) + iface;
 
-          if(UINT_MAX == el->GetElementDofIndex(iel, inode)) {
-            el->SetElementDofIndex(iel, inode, nnodes);
-            unsigned i1 = el->GetFaceVertexIndex(iel, iface, 0);
-            unsigned i2 = el->GetFaceVertexIndex(iel, iface, 1);
-            unsigned i3 = el->GetFaceVertexIndex(iel, iface, 2);
-            bool faceHasBeenFound = false;
-
-            for(unsigned jel = iel + 1; jel < el->GetElementNumber(); jel++) {
-              for(unsigned jface = el->GetElementFaceNumber(jel, 0); jface < el->GetElementFaceNumber(jel, 1); jface++) {
-                unsigned jnode = el->GetElementDofNumber(jel, 1) + jface;
-
-                if(UINT_MAX == el->GetElementDofIndex(jel, jnode)) {
-                  unsigned j1 = el->GetFaceVertexIndex(jel, jface, 0);
-                  unsigned j2 = el->GetFaceVertexIndex(jel, jface, 1);
-                  unsigned j3 = el->GetFaceVertexIndex(jel, jface, 2);
-
-                  if((i1 == j1 || i1 == j2 || i1 == j3) &&
-                      (i2 == j1 || i2 == j2 || i2 == j3) &&
-                      (i3 == j1 || i3 == j2 || i3 == j3)) {
-                    el->SetElementDofIndex(jel, jnode, nnodes);
-                    faceHasBeenFound = true;
-                    break;
-                  }
-                }
-              }
-
-              if(faceHasBeenFound) {
-                break;
+          unsigned faceVertex[3];
+          for(unsigned k = 0; k < 3; k++) {
+            faceVertex[k] = el->GetFaceVertexIndex(iel, iface, k);
+          }
+          std::sort(faceVertex, faceVertex + 3);
+
+          std::vector < unsigned > &bucket = faceBucket[faceVertex[0]];
+          bool faceHasBeenFound = false;
+
+          for(unsigned j = 0; j < bucket.size(); j += 3) {
+            if(bucket[j] == faceVertex[1] && bucket[j + 1] == faceVertex[2]) {
+              el->SetElementDofIndex(iel, inode, bucket[j + 2]);
+              // a face is shared by at most two elements, so the entry can be released
+              unsigned last = bucket.size() - 3;
+              for(unsigned k = 0; k < 3; k++) {
+                bucket[j + k] = bucket[last + k];
               }
+              bucket.resize(last);
+              faceHasBeenFound = true;
+              break;
             }
+          }
 
+          if(!faceHasBeenFound) {
+            el->SetElementDofIndex(iel, inode, nnodes);
+            bucket.push_back(faceVertex[1]);
+            bucket.push_back(faceVertex[2]);
+            bucket.push_back(nnodes);
             ++nnodes;
           }
         }
       }
     }
 
+    faceBucket.clear();
+
     // generates element dofs for tet, wedge and triangle elements
     for(unsigned iel = 0; iel < el->GetElementNumber(); iel++) {
       if(1 == el->GetElementType(iel)) {     //tet
@@ -1037,6 +1232,170 @@ namespace femus {
     return _finiteElement[ielType][solType]->GetBasis();
   }
 
+//------------------------------------------------------------------------------------------------------
+  void Mesh::BuildGeometricCache(const unsigned &solType) {
+
+    const unsigned dim = GetDimension();
+    const unsigned dim2 = (3 * (dim - 1) + !(dim - 1));
+    const unsigned xType = 2;
+
+    unsigned iproc = processor_id();
+    unsigned elementStart = _elementOffset[iproc];
+    unsigned nel = _elementOffset[iproc + 1] - elementStart;
+
+    // count the Gauss points and the (dof, Gauss point) pairs of the owned elements
+    vector < unsigned > &gaussOffset = _geomGaussOffset[solType];
+    vector < unsigned > &dofGaussOffset = _geomDofGaussOffset[solType];
+    gaussOffset.resize(nel + 1);
+    dofGaussOffset.resize(nel + 1);
+    gaussOffset[0] = 0;
+    dofGaussOffset[0] = 0;
+
+    for(unsigned iloc = 0; iloc < nel; iloc++) {
+      unsigned iel = elementStart + iloc;
+      short unsigned ielGeom = GetElementType(iel);
+      unsigned ng = _finiteElement[ielGeom][solType]->GetGaussPointNumber();
+      gaussOffset[iloc + 1] = gaussOffset[iloc] + ng;
+      dofGaussOffset[iloc + 1] = dofGaussOffset[iloc] + ng * _finiteElement[ielGeom][solType]->GetNDofs();
+    }
+
+    _geomWeight[solType].resize(gaussOffset[nel]);
+    _geomPhiX[solType].resize(dofGaussOffset[nel] * dim);
+    _geomPhiXX[solType].resize(dofGaussOffset[nel] * dim2);
+
+    if(dim > 1) {
+      // runs of consecutive elements of the same type go through the batched, element-innermost, Jacobian
+      ElementBatch* batch[6] = {NULL, NULL, NULL, NULL, NULL, NULL};
+
+      for(unsigned ilocStart = 0; ilocStart < nel;) {
+        short unsigned ielGeom = GetElementType(elementStart + ilocStart);
+        if(batch[ielGeom] == NULL) batch[ielGeom] = new ElementBatch(this, ielGeom, solType);
+
+        ElementBatch &b = *batch[ielGeom];
+        b.Clear();
+        unsigned ilocEnd = ilocStart;
+        while(ilocEnd < nel && GetElementType(elementStart + ilocEnd) == ielGeom && b.PushBack(elementStart + ilocEnd)) ilocEnd++;
+
+        b.GatherCoordinates();
+        b.Jacobian(true);
+
+        unsigned stride = b.GetStride();
+        unsigned nDofs = b.GetFiniteElement()->GetNDofs();
+        unsigned ng = b.GetFiniteElement()->GetGaussPointNumber();
+        const double* weight = b.GetWeights();
+        const double* phi_x = b.GetGradPhi();
+        const double* phi_xx = b.GetNablaPhi();
+
+        for(unsigned e = 0; e < b.GetSize(); e++) {
+          unsigned iloc = ilocStart + e;
+          for(unsigned ig = 0; ig < ng; ig++) {
+            _geomWeight[solType][gaussOffset[iloc] + ig] = weight[ig * stride + e];
+            unsigned start = dofGaussOffset[iloc] + ig * nDofs;
+            for(unsigned i = 0; i < nDofs * dim; i++) {
+              _geomPhiX[solType][start * dim + i] = phi_x[(ig * nDofs * dim + i) * stride + e];
+            }
+            for(unsigned i = 0; i < nDofs * dim2; i++) {
+              _geomPhiXX[solType][start * dim2 + i] = phi_xx[(ig * nDofs * dim2 + i) * stride + e];
+            }
+          }
+        }
+        ilocStart = ilocEnd;
+      }
+
+      for(unsigned i = 0; i < 6; i++) {
+        delete batch[i];
+      }
+      return;
+    }
+
+    vector < NumericVectorLocalView > xView(dim);
+    for(unsigned k = 0; k < dim; k++) {
+      xView[k] = _topology->_Sol[k]->GetLocalView();
+    }
+
+    vector < unsigned > xDof;
+    vector < vector < double > > x(dim);
+    vector < double > phi;
+    vector < double > phi_x;
+    vector < double > phi_xx;
+    double weight;
+
+    for(unsigned iloc = 0; iloc < nel; iloc++) {
+      unsigned iel = elementStart + iloc;
+      short unsigned ielGeom = GetElementType(iel);
+      unsigned nDofs = _finiteElement[ielGeom][solType]->GetNDofs();
+      unsigned nDofsX = GetElementDofNumber(iel, xType);
+
+      xDof.resize(nDofsX);
+      for(unsigned i = 0; i < nDofsX; i++) {
+        xDof[i] = GetSolutionDof(i, iel, xType);
+      }
+
+      for(unsigned k = 0; k < dim; k++) {
+        x[k].resize(nDofsX);
+        xView[k].GetValues(&xDof[0], nDofsX, &x[k][0]);
+      }
+
+      unsigned ng = gaussOffset[iloc + 1] - gaussOffset[iloc];
+      for(unsigned ig = 0; ig < ng; ig++) {
+        _finiteElement[ielGeom][solType]->Jacobian(x, ig, weight, phi, phi_x, phi_xx);
+
+        _geomWeight[solType][gaussOffset[iloc] + ig] = weight;
+
+        unsigned start = dofGaussOffset[iloc] + ig * nDofs;
+        std::copy(phi_x.begin(), phi_x.begin() + nDofs * dim, _geomPhiX[solType].begin() + start * dim);
+        std::copy(phi_xx.begin(), phi_xx.begin() + nDofs * dim2, _geomPhiXX[solType].begin() + start * dim2);
+      }
+    }
+  }
+
+//------------------------------------------------------------------------------------------------------
+  void Mesh::ClearGeometricCache() {
+    for(unsigned solType = 0; solType < 5; solType++) {
+      vector < unsigned > ().swap(_geomGaussOffset[solType]);
+      vector < unsigned > ().swap(_geomDofGaussOffset[solType]);
+      vector < double > ().swap(_geomWeight[solType]);
+      vector < double > ().swap(_geomPhiX[solType]);
+      vector < double > ().swap(_geomPhiXX[solType]);
+    }
+
+    delete _elementBinGrid;
+    _elementBinGrid = NULL;
+  }
+
+//------------------------------------------------------------------------------------------------------
+  const ElementBinGrid& Mesh::GetElementBinGrid() {
+    if(!_elementBinGrid) {
+      _elementBinGrid = new ElementBinGrid();
+      _elementBinGrid->Build(this);
+    }
+    return *_elementBinGrid;
+  }
+
+//------------------------------------------------------------------------------------------------------
+  void Mesh::GetCachedJacobian(const unsigned &iel, const unsigned &ig, const unsigned &solType,
+                               double &weight, vector < double > &phi, vector < double > &phi_x, vector < double > &phi_xx) const {
+
+    const unsigned dim = GetDimension();
+    const unsigned dim2 = (3 * (dim - 1) + !(dim - 1));
+
+    unsigned iloc = iel - _elementOffset[processor_id()];
+    short unsigned ielGeom = GetElementType(iel);
+    unsigned nDofs = _finiteElement[ielGeom][solType]->GetNDofs();
+
+    assert(HasGeometricCache(solType) && iloc + 1 < _geomGaussOffset[solType].size());
+
+    weight = _geomWeight[solType][_geomGaussOffset[solType][iloc] + ig];
+
+    // the shape functions do not depend on the geometry
+    const double* phiRef = _finiteElement[ielGeom][solType]->GetPhi(ig);
+    phi.assign(phiRef, phiRef + nDofs);
+
+    unsigned start = _geomDofGaussOffset[solType][iloc] + ig * nDofs;
+    phi_x.assign(_geomPhiX[solType].begin() + start * dim, _geomPhiX[solType].begin() + (start + nDofs) * dim);
+    phi_xx.assign(_geomPhiXX[solType].begin() + start * dim2, _geomPhiXX[solType].begin() + (start + nDofs) * dim2);
+  }
+
 } //end namespace femus
 
 
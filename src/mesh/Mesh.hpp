@@ -39,6 +39,7 @@ using std::vector;
 class Solution;
 
 class elem;
+class ElementBinGrid;
 
 /**
  * The mesh class
@@ -177,6 +178,13 @@ public:
     /** To be added */
     void FillISvector(vector < int > &epart);
 
+    /** If true, the elements of each process are ordered along a Hilbert curve on the coarse level, and inherit
+     * the order of their fathers on the finer ones, and the dofs of each process are ordered with Reverse Cuthill-McKee.
+     * It has to be set before the coarse mesh is generated */
+    static void SetLocalityReordering(const bool &value) {
+      _localityReordering = value;
+    }
+
     /** To be added */
     void Buildkel();
     
@@ -191,6 +199,26 @@ public:
     }
 
     basis *GetBasis(const short unsigned &ielType, const short unsigned &solType);
+
+    /** Computes once the Gauss weights and the physical shape function derivatives of all the owned elements
+     * for the finite element family solType. The cache is valid as long as the _topology coordinates do not change */
+    void BuildGeometricCache(const unsigned &solType);
+
+    /** Frees the geometric cache of all the finite element families and the element bin grid,
+     * it has to be called after moving the _topology coordinates */
+    void ClearGeometricCache();
+
+    /** Returns the bin grid over the owned elements used to locate points, built on the first call */
+    const ElementBinGrid& GetElementBinGrid();
+
+    /** Returns true if the geometric cache of the finite element family solType has been built */
+    bool HasGeometricCache(const unsigned &solType) const {
+      return _geomGaussOffset[solType].size() != 0;
+    }
+
+    /** Same outputs as elem_type::Jacobian, read from the geometric cache, for the owned element iel and the Gauss point ig */
+    void GetCachedJacobian(const unsigned &iel, const unsigned &ig, const unsigned &solType,
+                           double &weight, vector < double > &phi, vector < double > &phi_x, vector < double > &phi_xx) const;
     
     // member data
     Solution* _topology;
@@ -248,6 +276,16 @@ private:
     /** Build the coarse to the fine projection matrix */
     void BuildCoarseToFineProjection(const unsigned& solType);
 
+    /** Sorts the elements by the Hilbert index of their vertex centroid, it needs the coordinates in the file numbering */
+    void HilbertElementOrder(std::vector < unsigned > &elementOrder);
+
+    /** Reverse Cuthill-McKee order of the nodes of type k first owned by the elements in [elementStart, elementEnd),
+     * localIndex has the size of the number of nodes and is -1 on input and on output */
+    void ReverseCuthillMcKee(std::vector < unsigned > &nodes, const unsigned &elementStart, const unsigned &elementEnd,
+                             const unsigned &k, std::vector < int > &localIndex);
+
+    static bool _localityReordering;
+
     /** Weights used to build the baricentric coordinate **/
     static const double _baricentricWeight[6][5][18];
     static const unsigned _numberOfMissedBiquadraticNodes[6];
@@ -277,6 +315,18 @@ private:
     std::vector < std::map < unsigned,  std::map < unsigned, double  > > > _amrRestriction;
     std::vector < std::map < unsigned, bool > > _amrSolidMark;
 
+    /** Geometric cache, one for each finite element family, stored in structure of arrays layout:
+     * for the owned element iel (iloc = iel - _elementOffset[_iproc]) the Gauss weights start at _geomGaussOffset[iloc]
+     * and the first (second) derivatives start at _geomDofGaussOffset[iloc] * dim (* dim2), Gauss point after Gauss point */
+    vector < unsigned > _geomGaussOffset[5];
+    vector < unsigned > _geomDofGaussOffset[5];
+    vector < double > _geomWeight[5];
+    vector < double > _geomPhiX[5];
+    vector < double > _geomPhiXX[5];
+
+    /** Spatial index over the owned elements, see GetElementBinGrid */
+    ElementBinGrid* _elementBinGrid;
+
 };
 
 } //end namespace femus
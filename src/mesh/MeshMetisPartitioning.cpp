@@ -24,6 +24,10 @@
   #include "metis.h"
 #endif
 
+#ifdef HAVE_PARMETIS
+  #include "parmetis.h"
+#endif
+
 //C++ include
 #include <iostream>
 
@@ -34,6 +38,9 @@ using std::cout;
 using std::endl;
 
 
+bool MeshMetisPartitioning::_parallelPartitioning = false;
+
+
 MeshMetisPartitioning::MeshMetisPartitioning(Mesh& mesh) : MeshPartitioning(mesh) {
 
 }
@@ -66,6 +73,19 @@ void MeshMetisPartitioning::DoPartition(std::vector <int> &epart, const bool &AM
   }
   else {
 
+    int ncommon = GetNumberOfCommonNodes(AMR);
+
+    if(_parallelPartitioning) {
+#ifdef HAVE_PARMETIS
+      DoParallelPartition(epart, ncommon);
+      return;
+#else
+      if(_iproc == 0) {
+        std::cout << "Warning: ParMetis was not found, the mesh is partitioned with Metis" << std::endl;
+      }
+#endif
+    }
+
 #ifndef HAVE_METIS
     std::cerr << "Fatal error: Metis library was not found. Metis partioning algorithm cannot be called!" << std::endl;
     exit(1);
@@ -106,9 +126,6 @@ void MeshMetisPartitioning::DoPartition(std::vector <int> &epart, const bool &AM
       }
     }
 
-
-    int ncommon = ( AMR || _mesh.GetDimension() == 1 ) ? 1 : _mesh.GetDimension()+1;
-
     //I call the Mesh partioning function of Metis library (output is epart(own elem) and npart (own nodes))
     int err = METIS_PartMeshDual(&nelem, &nnodes, &eptr[0], &eind[0], NULL, NULL, &ncommon, &_nprocs, NULL, options, &objval, &epart[0], &npart[0]);
 
@@ -131,16 +148,230 @@ void MeshMetisPartitioning::DoPartition(std::vector <int> &epart, const bool &AM
   return;
 }
 
-void MeshMetisPartitioning::DoPartition(std::vector <int> &epart, const Mesh& meshc){
-  epart.resize( _mesh.GetNumberOfElements() );
-  unsigned refIndex = _mesh.GetRefIndex();
-  for(int isdom = 0; isdom < _nprocs; isdom++){
-    for( unsigned iel =meshc._elementOffset[isdom]; iel < meshc._elementOffset[isdom+1]; iel++){
-      for (unsigned j=0; j < refIndex; j++) {
-        epart[ iel * refIndex + j ] = isdom;
+//------------------------------------------------------------------------------------------------------
+int MeshMetisPartitioning::GetNumberOfCommonNodes(const bool &AMR) {
+  // the hanging nodes of an AMR mesh make the neighbors share as few as one node
+  return ( AMR || _mesh.GetDimension() == 1 ) ? 1 : _mesh.GetDimension() + 1;
+}
+
+//------------------------------------------------------------------------------------------------------
+int MeshMetisPartitioning::GetElementWeight(const unsigned &iel) {
+  return _mesh.el->GetElementDofNumber(iel, 2);
+}
+
+//------------------------------------------------------------------------------------------------------
+double MeshMetisPartitioning::GetImbalance(const std::vector <int> &epart) {
+
+  // the element connectivity is known by every process, so no communication is needed
+  vector < double > weight(_nprocs, 0.);
+  double totalWeight = 0.;
+  for(unsigned iel = 0; iel < epart.size(); iel++) {
+    double w = GetElementWeight(iel);
+    weight[epart[iel]] += w;
+    totalWeight += w;
+  }
+
+  double maxWeight = 0.;
+  for(int isdom = 0; isdom < _nprocs; isdom++) {
+    if(weight[isdom] > maxWeight) maxWeight = weight[isdom];
+  }
+
+  return (totalWeight > 0.) ? maxWeight * _nprocs / totalWeight : 1.;
+}
+
+//------------------------------------------------------------------------------------------------------
+void MeshMetisPartitioning::DoAdaptivePartition(std::vector <int> &epart) {
+
+#ifdef HAVE_PARMETIS
+
+  int nelem = _mesh.GetNumberOfElements();
+
+  // the graph is distributed as the inherited partition, so every process starts from the elements it owns
+  vector < idx_t > elmdist(_nprocs + 1, 0);
+  for(unsigned iel = 0; iel < nelem; iel++) {
+    elmdist[epart[iel] + 1]++;
+  }
+  for(int isdom = 0; isdom < _nprocs; isdom++) {
+    elmdist[isdom + 1] += elmdist[isdom];
+  }
+
+  // ParMetis does not accept a process without elements: elmdist is the same on all the processes, so they all
+  // take this path together and partition the mesh again from scratch
+  for(int isdom = 0; isdom < _nprocs; isdom++) {
+    if(elmdist[isdom + 1] == elmdist[isdom]) {
+      if(_iproc == 0) {
+        std::cout << " Process " << isdom << " owns no elements, the AMR mesh is partitioned again" << std::endl;
       }
+      DoPartition(epart, true);
+      return;
+    }
+  }
+
+  unsigned ielStart = elmdist[_iproc];
+  unsigned ielEnd = elmdist[_iproc + 1];
+  unsigned nelemLocal = ielEnd - ielStart;
+
+  vector < idx_t > eptr(nelemLocal + 1);
+  vector < idx_t > vwgt(nelemLocal);
+  eptr[0] = 0;
+  for(unsigned iel = ielStart; iel < ielEnd; iel++) {
+    eptr[iel - ielStart + 1] = eptr[iel - ielStart] + _mesh.el->GetElementDofNumber(iel, 2);
+    vwgt[iel - ielStart] = GetElementWeight(iel);
+  }
+
+  vector < idx_t > eind(eptr[nelemLocal]);
+  unsigned counter = 0;
+  for(unsigned iel = ielStart; iel < ielEnd; iel++) {
+    unsigned ndofs = _mesh.el->GetElementDofNumber(iel, 2);
+    for(unsigned inode = 0; inode < ndofs; inode++) {
+      eind[counter] = _mesh.el->GetElementDofIndex(iel, inode);
+      counter++;
+    }
+  }
+
+  idx_t numflag = 0;
+  idx_t ncommonnodes = GetNumberOfCommonNodes(true);
+  idx_t *xadj;
+  idx_t *adjncy;
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  int err = ParMETIS_V3_Mesh2Dual(&elmdist[0], &eptr[0], &eind[0], &numflag, &ncommonnodes, &xadj, &adjncy, &comm);
+
+  if(err != METIS_OK) {
+    std::cout << " PARMETIS_ERROR " << std::endl;
+    exit(1);
+  }
+
+  idx_t wgtflag = 2;
+  idx_t ncon = 1;
+  idx_t nparts = _nprocs;
+  idx_t edgecut;
+  idx_t options[4] = {0, 0, 0, 0};
+
+  vector < real_t > tpwgts(nparts, 1. / nparts);
+  real_t ubvec = 1.05;
+  // ratio between the inter-process communication time and the data redistribution time
+  real_t itr = 1000.;
+
+  vector < idx_t > part(nelemLocal, _iproc);
+
+  err = ParMETIS_V3_AdaptiveRepart(&elmdist[0], xadj, adjncy, &vwgt[0], NULL, NULL, &wgtflag, &numflag, &ncon,
+                                   &nparts, &tpwgts[0], &ubvec, &itr, options, &edgecut, &part[0], &comm);
+
+  METIS_Free(xadj);
+  METIS_Free(adjncy);
+
+  if(err != METIS_OK) {
+    std::cout << " PARMETIS_ERROR " << std::endl;
+    exit(1);
+  }
+
+  vector < int > recvCount(_nprocs);
+  vector < int > displ(_nprocs);
+  for(int isdom = 0; isdom < _nprocs; isdom++) {
+    displ[isdom] = elmdist[isdom];
+    recvCount[isdom] = elmdist[isdom + 1] - elmdist[isdom];
+  }
+
+  vector < int > localPart(nelemLocal);
+  for(unsigned i = 0; i < nelemLocal; i++) {
+    localPart[i] = part[i];
+  }
+
+  MPI_Allgatherv(&localPart[0], nelemLocal, MPI_INT, &epart[0], &recvCount[0], &displ[0], MPI_INT, MPI_COMM_WORLD);
+
+  if(_iproc == 0) {
+    std::cout << " PARMETIS ADAPTIVE REPARTITIONING IS OK " << std::endl;
+  }
+
+#else
+
+  // without ParMetis the mesh is partitioned again from scratch
+  DoPartition(epart, true);
+
+#endif
+
+}
+
+//------------------------------------------------------------------------------------------------------
+void MeshMetisPartitioning::DoParallelPartition(std::vector <int> &epart, const int &ncommon) {
+
+#ifdef HAVE_PARMETIS
+
+  int nelem = _mesh.GetNumberOfElements();
+
+  // the elements are split in contiguous slabs, one for each process
+  vector < idx_t > elmdist(_nprocs + 1);
+  for(int isdom = 0; isdom <= _nprocs; isdom++) {
+    elmdist[isdom] = static_cast < idx_t >( (static_cast < long > (nelem) * isdom) / _nprocs );
+  }
+
+  unsigned ielStart = elmdist[_iproc];
+  unsigned ielEnd = elmdist[_iproc + 1];
+  unsigned nelemLocal = ielEnd - ielStart;
+
+  vector < idx_t > eptr(nelemLocal + 1);
+  eptr[0] = 0;
+  for(unsigned iel = ielStart; iel < ielEnd; iel++) {
+    eptr[iel - ielStart + 1] = eptr[iel - ielStart] + _mesh.el->GetElementDofNumber(iel, 2);
+  }
+
+  vector < idx_t > eind(eptr[nelemLocal]);
+  unsigned counter = 0;
+  for(unsigned iel = ielStart; iel < ielEnd; iel++) {
+    unsigned ndofs = _mesh.el->GetElementDofNumber(iel, 2);
+    for(unsigned inode = 0; inode < ndofs; inode++) {
+      eind[counter] = _mesh.el->GetElementDofIndex(iel, inode);
+      counter++;
     }
   }
+
+  idx_t wgtflag = 0;
+  idx_t numflag = 0;
+  idx_t ncon = 1;
+  idx_t ncommonnodes = ncommon;
+  idx_t nparts = _nprocs;
+  idx_t edgecut;
+  idx_t options[3] = {0, 0, 0};
+
+  vector < real_t > tpwgts(nparts, 1. / nparts);
+  real_t ubvec = 1.05;
+
+  vector < idx_t > part(nelemLocal);
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+
+  int err = ParMETIS_V3_PartMeshKway(&elmdist[0], &eptr[0], &eind[0], NULL, &wgtflag, &numflag, &ncon, &ncommonnodes,
+                                     &nparts, &tpwgts[0], &ubvec, options, &edgecut, &part[0], &comm);
+
+  if(err != METIS_OK) {
+    std::cout << " PARMETIS_ERROR " << std::endl;
+    exit(1);
+  }
+
+  // every process holds the whole mesh and needs the whole partition to build the dof maps
+  vector < int > recvCount(_nprocs);
+  vector < int > displ(_nprocs);
+  for(int isdom = 0; isdom < _nprocs; isdom++) {
+    displ[isdom] = elmdist[isdom];
+    recvCount[isdom] = elmdist[isdom + 1] - elmdist[isdom];
+  }
+
+  vector < int > localPart(nelemLocal);
+  for(unsigned i = 0; i < nelemLocal; i++) {
+    localPart[i] = part[i];
+  }
+
+  epart.resize(nelem);
+  MPI_Allgatherv(&localPart[0], nelemLocal, MPI_INT, &epart[0], &recvCount[0], &displ[0], MPI_INT, MPI_COMM_WORLD);
+
+  if(_iproc == 0) {
+    std::cout << " PARMETIS PARTITIONING IS OK " << std::endl;
+  }
+
+#endif
+
 }
 
-}
\ No newline at end of file
+}
@@ -47,12 +47,36 @@ public:
      *  for coarse and AMR mesh */
     void DoPartition( std::vector < int > &epart, const bool &AMR );
 
-    /** Parallel partitioning imported from coarser mesh partition:
-     *  for uniformed refined meshes */
-    void DoPartition( std::vector < int > &epart, const Mesh &meshc );
+    /** Adaptive repartitioning of an AMR mesh: on input epart is the partition inherited from the coarser mesh,
+     *  with the elements of each process numbered contiguously, on output it is balanced with respect to the
+     *  element weights, moving as few elements as possible */
+    void DoAdaptivePartition( std::vector < int > &epart );
+
+    /** Maximum over the processes of the element weight owned, divided by its average */
+    double GetImbalance( const std::vector < int > &epart );
+
+    /** If true, and ParMetis is available, the coarse and AMR meshes are partitioned with ParMetis instead of Metis.
+     *  The partitions differ from the Metis ones. It is false by default */
+    static void SetParallelPartitioning( const bool &value ) {
+      _parallelPartitioning = value;
+    }
 
 private:
 
+    /** Number of nodes two elements have to share to be neighbors in the dual graph */
+    int GetNumberOfCommonNodes( const bool &AMR );
+
+    /** Work estimate of the element iel, its number of dofs */
+    int GetElementWeight( const unsigned &iel );
+
+    /** ParMetis partitioning: every process builds the dual graph only for its own slab of elements, and the
+     *  resulting partition is gathered on all processes. Only the graph partitioning is distributed: the mesh is
+     *  still read and stored whole on every process and no element is migrated, so the memory per process is
+     *  the same as with serial Metis */
+    void DoParallelPartition( std::vector < int > &epart, const int &ncommon );
+
+    static bool _parallelPartitioning;
+
 
 };
 
@@ -26,7 +26,7 @@
 namespace femus {
 
 //-------------------------------------------------------------------
-  MeshRefinement::MeshRefinement(Mesh& mesh): _mesh(mesh) {
+  MeshRefinement::MeshRefinement(Mesh& mesh): _mesh(mesh), _gatherCoarseLevel(false) {
 
   }
 
@@ -184,7 +184,8 @@ namespace femus {
 
 
 //---------------------------------------------------------------------------------------------------------------
-  void MeshRefinement::RefineMesh(const unsigned& igrid, Mesh* mshc, const elem_type* otherFiniteElement[6][5]) {
+  void MeshRefinement::RefineMesh(const unsigned& igrid, Mesh* mshc, const elem_type* otherFiniteElement[6][5],
+                                  const bool& repartitionAMR, const double& imbalanceThreshold) {
 
     _mesh.SetIfHomogeneous(true);
 
@@ -212,6 +213,9 @@ namespace femus {
 
     _mesh.el = new elem(elc, _mesh.GetRefIndex(), coarseLocalizedAmrVector);
 
+    // process of the coarse father of each fine element
+    std::vector < int > partition(nelem);
+
     unsigned jel = 0;
     //divide each coarse element in 8(3D), 4(2D) or 2(1D) fine elements and find all the vertices
 
@@ -219,10 +223,19 @@ namespace femus {
 
     bool AMR = false;
 
+    // the coarse element data of all the processes are gathered at once, or broadcast one process slab at a time
+    if(_gatherCoarseLevel) {
+      elc->LocalizeElementDof();
+      elc->LocalizeElementNearFace();
+      elc->LocalizeElementQuantities();
+    }
+
     for(unsigned isdom = 0; isdom < _nprocs; isdom++) {
-      elc->LocalizeElementDof(isdom);
-      elc->LocalizeElementNearFace(isdom);
-      elc->LocalizeElementQuantities(isdom);
+      if(!_gatherCoarseLevel) {
+        elc->LocalizeElementDof(isdom);
+        elc->LocalizeElementNearFace(isdom);
+        elc->LocalizeElementQuantities(isdom);
+      }
       for(unsigned iel = mshc->_elementOffset[isdom]; iel < mshc->_elementOffset[isdom + 1]; iel++) {
         if(static_cast < unsigned short >(coarseLocalizedAmrVector[iel] + 0.25) == 1) {
           unsigned elt = elc->GetElementType(iel);
@@ -235,6 +248,7 @@ namespace femus {
             if(iel >= elementOffsetCoarse && iel < elementOffsetCoarseP1) {
               elc->SetChildElement(iel, j, jel + j);
             }
+            partition[jel + j] = isdom;
           }
 
           // project vertex indeces
@@ -268,6 +282,7 @@ namespace femus {
           if(iel >= elementOffsetCoarse && iel < elementOffsetCoarseP1) {
             elc->SetChildElement(iel, 0, jel);
           }
+          partition[jel] = isdom;
 
           // project nodes indeces
           for(unsigned inode = 0; inode < elc->GetNVE(elt, 2); inode++)
@@ -287,6 +302,14 @@ namespace femus {
           _mesh.el->AddToElementNumber(1, elt);
         }
       }
+      if(!_gatherCoarseLevel) {
+        elc->FreeLocalizedElementDof();
+        elc->FreeLocalizedElementNearFace();
+        elc->FreeLocalizedElementQuantities();
+      }
+    }
+
+    if(_gatherCoarseLevel) {
       elc->FreeLocalizedElementDof();
       elc->FreeLocalizedElementNearFace();
       elc->FreeLocalizedElementQuantities();
@@ -371,17 +394,24 @@ namespace femus {
 
     Buildkmid();
 
-    std::vector < int > partition;
-    partition.reserve(_mesh.GetNumberOfNodes());
-    partition.resize(_mesh.GetNumberOfElements());
-
-    MeshMetisPartitioning meshMetisPartitioning(_mesh);
-
+    // a uniformly refined mesh, or an AMR one that skips the repartition, keeps the partition of the coarse fathers:
+    // the unrefined elements and their dofs do not move and no global Metis call is needed
     if(AMR == true) {
-      meshMetisPartitioning.DoPartition(partition, AMR);
-    }
-    else {
-      meshMetisPartitioning.DoPartition(partition, *mshc);
+      MeshMetisPartitioning meshMetisPartitioning(_mesh);
+      if(repartitionAMR) {
+        partition.reserve(_mesh.GetNumberOfNodes());
+        meshMetisPartitioning.DoPartition(partition, AMR);
+      }
+      else {
+        double imbalance = meshMetisPartitioning.GetImbalance(partition);
+        if(imbalance > imbalanceThreshold) {
+          if(_iproc == 0) {
+            std::cout << " AMR level " << igrid << " imbalance " << imbalance << " exceeds " << imbalanceThreshold
+                      << ", repartitioning" << std::endl;
+          }
+          meshMetisPartitioning.DoAdaptivePartition(partition);
+        }
+      }
     }
 
     _mesh.FillISvector(partition);
@@ -44,8 +44,20 @@ public:
 
     /** Refinement functions */
 
-    /** This function generates a finer mesh level, $l_i$, from a coarser mesh level $l_{i-1}$, $i>0$ */
-    void RefineMesh(const unsigned &igrid, Mesh *mshc, const elem_type* otheFiniteElement[6][5]);
+    /** This function generates a finer mesh level, $l_i$, from a coarser mesh level $l_{i-1}$, $i>0$.
+     * A partially refined level is repartitioned with Metis if repartitionAMR is true, otherwise each
+     * fine element is given to the process owning its coarse father, as for the uniform refinement,
+     * and the partition is rebalanced only if its imbalance exceeds imbalanceThreshold */
+    void RefineMesh(const unsigned &igrid, Mesh *mshc, const elem_type* otheFiniteElement[6][5],
+                    const bool &repartitionAMR = true, const double &imbalanceThreshold = 1.2);
+
+    /** Coarse element data used by RefineMesh: if gather is true the coarse level of all the processes is gathered
+     * with one MPI_Allgatherv per quantity, otherwise (default) each process slab is broadcast in turn, one round per
+     * process. Gathering removes the per-process rounds but every process holds the whole coarse level at once, while
+     * the broadcasts hold one slab at a time; in both cases the fine elem, replicated on every process, is larger */
+    void SetCoarseLevelGather(const bool &gather) {
+      _gatherCoarseLevel = gather;
+    }
 
     /** Flag all the elements to be refined */
     void FlagAllElementsToBeRefined();
@@ -69,6 +81,8 @@ private:
 
     Mesh& _mesh;                 //< reference to the mesh which is built by refinement
 
+    bool _gatherCoarseLevel;     //< gather the whole coarse level at once instead of one slab per process, false by default
+
 };
 
 
@@ -51,7 +51,7 @@ MultiLevelMesh::~MultiLevelMesh() {
 }
 
 //---------------------------------------------------------------------------------------------------
-MultiLevelMesh::MultiLevelMesh(): _gridn0(0)
+MultiLevelMesh::MultiLevelMesh(): _gridn0(0), _amrSkipRepartition(false), _amrImbalanceThreshold(1.2), _gatherCoarseLevel(false)
   {
 
   _finiteElementGeometryFlag.resize(6,false);
@@ -116,7 +116,10 @@ MultiLevelMesh::MultiLevelMesh(const unsigned short &igridn,const unsigned short
 			       const char mesh_file[], const char GaussOrder[], const double Lref,
 			       bool (* SetRefinementFlag)(const std::vector < double > &x,
 							  const int &ElemGroupNumber,const int &level) ):
-    _gridn0(igridn)
+    _gridn0(igridn),
+    _amrSkipRepartition(false),
+    _amrImbalanceThreshold(1.2),
+    _gatherCoarseLevel(false)
     {
 
 
@@ -236,6 +239,7 @@ void MultiLevelMesh::RefineMesh( const unsigned short &igridn, const unsigned sh
 
       _level0[i] = new Mesh();
       MeshRefinement meshfiner(*_level0[i]);
+      meshfiner.SetCoarseLevelGather(_gatherCoarseLevel);
       meshfiner.RefineMesh(i,_level0[i-1],_finiteElement);
     }
 
@@ -261,6 +265,7 @@ void MultiLevelMesh::RefineMesh( const unsigned short &igridn, const unsigned sh
       }
       _level0[i] = new Mesh();
       MeshRefinement meshfiner(*_level0[i]);
+      meshfiner.SetCoarseLevelGather(_gatherCoarseLevel);
       meshfiner.RefineMesh(i,_level0[i-1],_finiteElement);
     }
 
@@ -286,7 +291,8 @@ void MultiLevelMesh::AddAMRMeshLevel()
 
   _level0[_gridn0] = new Mesh();
   MeshRefinement meshfiner(*_level0[_gridn0]);
-  meshfiner.RefineMesh(_gridn0,_level0[_gridn0-1u],_finiteElement);
+  meshfiner.SetCoarseLevelGather(_gatherCoarseLevel);
+  meshfiner.RefineMesh(_gridn0,_level0[_gridn0-1u],_finiteElement,!_amrSkipRepartition,_amrImbalanceThreshold);
 
   _level.resize(_gridn+1u);
   _level[_gridn]=_level0[_gridn0];
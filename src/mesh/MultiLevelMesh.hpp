@@ -73,8 +73,29 @@ public:
 
     /** Add a partially refined mesh level in the AMR alghorithm **/
     void AddAMRMeshLevel();
+
+    /** Skip the Metis repartition of the levels added by AddAMRMeshLevel: each fine element goes to the process
+     * owning its coarse father, so the unrefined elements and their dofs stay on the same process. The coarser
+     * levels and their solvers are kept, but the new level, its sparsity pattern and its prolongator are still built
+     * from scratch; only the global partitioning is skipped */
+    void SetAMRSkipRepartition(const bool &skipRepartition = true) {
+        _amrSkipRepartition = skipRepartition;
+    };
+
+    /** With SetAMRSkipRepartition: rebalance the inherited partition when the maximum process load over the average
+     * load exceeds threshold (default 1.2) */
+    void SetAMRImbalanceThreshold(const double &threshold) {
+        _amrImbalanceThreshold = threshold;
+    };
     
     
+    /** Coarse element data used when the levels are refined by RefineMesh and AddAMRMeshLevel: gathered at once
+     * (fewer collectives) or broadcast one process slab at a time (default, lower peak memory),
+     * see MeshRefinement::SetCoarseLevelGather */
+    void SetCoarseLevelGather(const bool &gather) {
+        _gatherCoarseLevel = gather;
+    };
+
     /** Get the mesh pointer to level i */
     Mesh* GetLevel(const unsigned i) {
         return _level[i];
@@ -127,6 +148,10 @@ private:
     
     /** MultilevelMesh  writer */
     Writer* _writer;
+
+    bool _amrSkipRepartition;
+    double _amrImbalanceThreshold;
+    bool _gatherCoarseLevel;
     
     /** Domain (optional) */
     Domain* _domain;
@@ -374,6 +374,43 @@ namespace femus {
     _lproc = lproc;
   }
 
+  // ******************
+  template <class Type> void MyMatrix<Type>::localize() {
+
+    if(_serial) {
+      std::cout << "Error in MyMatrix.localize(), matrix is in " << status() << " status" << std::endl;
+      abort();
+    }
+
+    _matSize.localize();
+    _rowSize.localize();
+    _rowOffset.localize();
+
+    std::vector < int > counts(_nprocs);
+    std::vector < int > displs(_nprocs);
+    unsigned matsize = 0;
+    for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+      counts[jproc] = _matSize[jproc];
+      displs[jproc] = matsize;
+      // the row offsets of each process are relative to its own block
+      for(unsigned i = _offset[jproc]; i < _offset[jproc + 1]; i++) {
+        _rowOffset[i] += matsize;
+      }
+      matsize += _matSize[jproc];
+    }
+
+    _mat.swap(_mat2);
+    _mat.resize(matsize);
+
+    MPI_Allgatherv(&_mat2[0], counts[_iproc], _MY_MPI_DATATYPE, &_mat[0], &counts[0], &displs[0], _MY_MPI_DATATYPE, MPI_COMM_WORLD);
+
+    _begin = 0;
+    _end = _offset[_nprocs];
+    _size = _end - _begin;
+
+    _lproc = _nprocs;
+  }
+
   // ******************
   template <class Type> void MyMatrix<Type>::clearBroadcast() {
 
@@ -99,6 +99,9 @@ namespace femus {
       // ******************
       void broadcast(const unsigned &lproc);
 
+      // ******************
+      void localize();
+
       // ******************
       void clearBroadcast();
 
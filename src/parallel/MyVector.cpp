@@ -241,6 +241,31 @@ namespace femus {
     _lproc = lproc;
   }
 
+  // ******************
+  template <class Type> void MyVector<Type>::localize() {
+
+    if(_serial) {
+      std::cout << "Error in MyVector.localize(), vector is in " << status() << " status" << std::endl;
+      abort();
+    }
+
+    std::vector < int > counts(_nprocs);
+    std::vector < int > displs(_nprocs);
+    for(unsigned jproc = 0; jproc < _nprocs; jproc++) {
+      counts[jproc] = _offset[jproc + 1] - _offset[jproc];
+      displs[jproc] = _offset[jproc];
+    }
+
+    _vec.swap(_vec2);
+    _vec.resize(_offset[_nprocs]);
+
+    MPI_Allgatherv(&_vec2[0], counts[_iproc], _MY_MPI_DATATYPE, &_vec[0], &counts[0], &displs[0], _MY_MPI_DATATYPE, MPI_COMM_WORLD);
+
+    _begin = 0;
+    _end = _offset[_nprocs];
+    _lproc = _nprocs;
+  }
+
   // ******************
   template <class Type> void MyVector<Type>::clearBroadcast() {
 
@@ -85,6 +85,9 @@ namespace femus {
       // ******************
       void broadcast(const unsigned &lproc);
 
+      // ******************
+      void localize();
+
       // ******************
       void clearBroadcast();
 
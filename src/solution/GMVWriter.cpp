@@ -19,6 +19,7 @@
 #include "GMVWriter.hpp"
 #include "MultiLevelProblem.hpp"
 #include "NumericVector.hpp"
+#include "Profiler.hpp"
 #include <cstdio>
 #include <fstream>
 #include <iostream>
@@ -26,10 +27,85 @@
 #include <algorithm>
 #include <cstring>
 #include "Files.hpp"
+#include <mpi.h>
 
 
 namespace femus {
 
+  namespace {
+
+    /** The gmv binary file is written collectively with MPI-IO: the headers by the first process and
+     * the distributed arrays by all the processes, each one at the offset of its owned part */
+    class GMVParallelFile {
+
+      public:
+
+        GMVParallelFile( const std::string &filename ) : _position( 0 ) {
+          MPI_Comm_rank( MPI_COMM_WORLD, &_iproc );
+          _isOpen = ( MPI_File_open( MPI_COMM_WORLD, const_cast < char* >( filename.c_str() ),
+                                     MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &_fh ) == MPI_SUCCESS );
+          if( _isOpen ) MPI_File_set_size( _fh, 0 );
+        }
+
+        ~GMVParallelFile() {
+          if( _isOpen ) MPI_File_close( &_fh );
+        }
+
+        bool IsOpen() const {
+          return _isOpen;
+        }
+
+        /** gmv keywords and names take 8 characters */
+        void WriteKeyword( const std::string &keyword ) {
+          char buffer[8];
+          FillKeyword( keyword, buffer );
+          WriteShared( buffer, 8 );
+        }
+
+        static void FillKeyword( const std::string &keyword, char buffer[8] ) {
+          memset( buffer, 0, 8 );
+          memcpy( buffer, keyword.c_str(), ( keyword.size() < 8 ) ? keyword.size() : 8 );
+        }
+
+        void WriteShared( const void* data, const unsigned &nBytes ) {
+          if( _iproc == 0 ) {
+            MPI_File_write_at( _fh, _position, const_cast < void* >( data ), nBytes, MPI_BYTE, MPI_STATUS_IGNORE );
+          }
+          _position += nBytes;
+        }
+
+        void WriteDistributed( const void* data, const unsigned &nBytes ) {
+          unsigned long long localBytes = nBytes;
+          unsigned long long offset = 0;
+          unsigned long long totalBytes = 0;
+          MPI_Exscan( &localBytes, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+          if( _iproc == 0 ) offset = 0;
+          MPI_Allreduce( &localBytes, &totalBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+
+          MPI_File_write_at_all( _fh, _position + offset, const_cast < void* >( data ), nBytes, MPI_BYTE, MPI_STATUS_IGNORE );
+          _position += totalBytes;
+        }
+
+        void WriteDistributed( const std::vector < double > &data ) {
+          WriteDistributed( ( data.size() > 0 ) ? &data[0] : NULL, data.size() * sizeof( double ) );
+        }
+
+      private:
+
+        MPI_File _fh;
+        MPI_Offset _position;
+        int _iproc;
+        bool _isOpen;
+    };
+
+    /** Copy the owned values of v into values */
+    void GetOwnedValues( const NumericVector* v, const unsigned &offset, std::vector < double > &values ) {
+      NumericVectorLocalView view = v->GetLocalView();
+      for( unsigned ii = 0; ii < values.size(); ii++ ) values[ii] = view( ii + offset );
+    }
+
+  }
+
   GMVWriter::GMVWriter( MultiLevelSolution* ml_sol ) : Writer( ml_sol ) {
     _debugOutput = false;
   }
@@ -44,6 +120,8 @@ namespace femus {
 
   void GMVWriter::Write( const std::string output_path, const char order[], const std::vector<std::string>& vars, const unsigned time_step ) {
 
+    if( _profiler ) _profiler->Start( "GMV output" );
+
     // ********** linear -> index==0 *** quadratic -> index==1 **********
     unsigned index = ( strcmp( order, "linear" ) ) ? 1 : 0;
 
@@ -56,36 +134,30 @@ namespace femus {
     std::ostringstream filename;
     filename << output_path << "/" << filename_prefix << ".level" << _gridn << "." << time_step << "." << order << ".gmv";
 
-    std::ofstream fout;
+    // every process writes its own nodes, elements and values into the same file
+    GMVParallelFile fout( filename.str() );
 
-    if( _iproc != 0 ) {
-      fout.rdbuf();   //redirect to dev_null
+    if( !fout.IsOpen() ) {
+      std::cout << std::endl << " The output file " << filename.str() << " cannot be opened.\n";
+      abort();
     }
-    else {
-      fout.open( filename.str().c_str() );
-      if( fout.is_open() ) {
-        std::cout << std::endl << " The output is printed to file " << filename.str() << " in GMV format" << std::endl;
-      }
-      else {
-        std::cout << std::endl << " The output file " << filename.str() << " cannot be opened.\n";
-        abort();
-      }
+    else if( _iproc == 0 ) {
+      std::cout << std::endl << " The output is printed to file " << filename.str() << " in GMV format" << std::endl;
     }
 
     Mesh* mesh = _ml_mesh->GetLevel( _gridn - 1 );
-    Solution* solution = _ml_sol->GetSolutionLevel( _gridn - 1 );
+    Solution* solution = ( _ml_sol != NULL ) ? _ml_sol->GetSolutionLevel( _gridn - 1 ) : NULL;
     unsigned nvt = mesh->GetTotalNumberOfDofs( index );
     unsigned nel = mesh->GetNumberOfElements();
     unsigned dim = mesh->GetDimension();
 
-    std::vector < double > vector1;
-    vector1.reserve( nvt );
+    unsigned dofOffset = mesh->_dofOffset[index][_iproc];
+    unsigned elementOffset = mesh->_elementOffset[_iproc];
+    unsigned elementOffsetp1 = mesh->_elementOffset[_iproc + 1];
+    unsigned nelOwned = elementOffsetp1 - elementOffset;
 
-    std::vector < double > vector2;
-    if( nvt > ( dim + 1 ) *nel )
-      vector2.reserve( nvt );
-    else
-      vector2.reserve( ( dim + 1 ) *nel );
+    std::vector < double > vector1( mesh->_ownSize[index][_iproc] );
+    std::vector < double > vector2( mesh->_ownSize[index][_iproc] );
 
     NumericVector* numVector;
     numVector = NumericVector::build().release();
@@ -93,17 +165,13 @@ namespace femus {
 
 
     //BEGIN GMV FILE PRINT
-    char* buffer = new char[10];
-    sprintf( buffer, "%s", "gmvinput" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-    sprintf( buffer, "%s", "ieeei4r8" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
+    fout.WriteKeyword( "gmvinput" );
+    fout.WriteKeyword( "ieeei4r8" );
 
 
     //BEGIN COORDINATES
-    sprintf( buffer, "%s", "nodes" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-    fout.write( ( char* ) &nvt, sizeof( unsigned ) );
+    fout.WriteKeyword( "nodes" );
+    fout.WriteShared( &nvt, sizeof( unsigned ) );
 
     for( int i = 0; i < 3; i++ ) {
       if( !_surface ) {
@@ -121,99 +189,86 @@ namespace femus {
                                 *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indSurfVar ) ) );
       }
 
-      numVector->localize_to_one( vector1, 0 );
+      GetOwnedValues( numVector, dofOffset, vector1 );
       if( _ml_sol != NULL && _moving_mesh  && dim > i )  {
         unsigned indDXDYDZ = _ml_sol->GetIndex( _moving_vars[i].c_str() );
         numVector->matrix_mult( *solution->_Sol[indDXDYDZ],
                                 *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indDXDYDZ ) ) );
-        numVector->localize_to_one( vector2, 0 );
-        if( _iproc == 0 ) {
-          for( unsigned i = 0; i < nvt; i++ )
-            vector1[i] += vector2[i];
-        }
+        GetOwnedValues( numVector, dofOffset, vector2 );
+        for( unsigned ii = 0; ii < vector1.size(); ii++ )
+          vector1[ii] += vector2[ii];
       }
-      fout.write( ( char* ) &vector1[0], nvt * sizeof( double ) );
+      fout.WriteDistributed( vector1 );
 
     }
     //END COORDINATES
 
     //BEGIN CONNETTIVITY
     const int eltp[2][6] = {{8, 4, 6, 4, 3, 2}, {20, 10, 15, 8, 6, 3}};
-    sprintf( buffer, "%s", "cells" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-
-    fout.write( ( char* ) &nel, sizeof( unsigned ) );
+    fout.WriteKeyword( "cells" );
+    fout.WriteShared( &nel, sizeof( unsigned ) );
 
+    // each owned element is stored as name, number of nodes and node list
+    std::vector < char > cells;
+    cells.reserve( nelOwned * ( 8 + sizeof( unsigned ) * ( 1 + NVE[0][index] ) ) );
+    char buffer[16];
     unsigned topology[27];
 
-    //mesh->_topology->_Sol[mesh->GetTypeIndex()]->localize_to_one( vector1, 0 );
-
-    for( unsigned isdom = 0; isdom < _nprocs; isdom++ ) {
-      mesh->el->LocalizeElementDof( isdom );
-      mesh->el->LocalizeElementQuantities(isdom);
-      if( _iproc == 0 ) {
-        for( unsigned ii = mesh->_elementOffset[isdom]; ii < mesh->_elementOffset[isdom + 1]; ii++ ) {
-          //short unsigned ielt = static_cast < short unsigned >( vector1[ii] + 0.25 );
-	  short unsigned ielt = mesh->GetElementType(ii);
-          if( ielt == 0 )
-            sprintf( buffer, "phex%d", eltp[index][0] );
-          else if( ielt == 1 )
-            sprintf( buffer, "ptet%d", eltp[index][1] );
-          else if( ielt == 2 )
-            sprintf( buffer, "pprism%d", eltp[index][2] );
-          else if( ielt == 3 ) {
-            if( eltp[index][3] == 8 )
-              sprintf( buffer, "%dquad", eltp[index][3] );
-            else
-              sprintf( buffer, "quad" );
-          }
-          else if( ielt == 4 ) {
-            if( eltp[index][4] == 6 )
-              sprintf( buffer, "%dtri", eltp[index][4] );
-            else
-              sprintf( buffer, "tri" );
-          }
-          else if( ielt == 5 ) {
-            if( eltp[index][5] == 3 )
-              sprintf( buffer, "%dline", eltp[index][5] );
-            else
-              sprintf( buffer, "line" );
-          }
-          fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-          fout.write( ( char* ) &NVE[ielt][index], sizeof( unsigned ) );
-          for( unsigned j = 0; j < NVE[ielt][index]; j++ ) {
-            unsigned jnode_Metis = mesh->GetSolutionDof( j, ii, index );
-            topology[j] = jnode_Metis + 1;
-          }
-          fout.write( ( char* ) topology, sizeof( unsigned ) *NVE[ielt][index] );
-        }
+    for( unsigned ii = elementOffset; ii < elementOffsetp1; ii++ ) {
+      short unsigned ielt = mesh->GetElementType( ii );
+      if( ielt == 0 )
+        sprintf( buffer, "phex%d", eltp[index][0] );
+      else if( ielt == 1 )
+        sprintf( buffer, "ptet%d", eltp[index][1] );
+      else if( ielt == 2 )
+        sprintf( buffer, "pprism%d", eltp[index][2] );
+      else if( ielt == 3 ) {
+        if( eltp[index][3] == 8 )
+          sprintf( buffer, "%dquad", eltp[index][3] );
+        else
+          sprintf( buffer, "quad" );
+      }
+      else if( ielt == 4 ) {
+        if( eltp[index][4] == 6 )
+          sprintf( buffer, "%dtri", eltp[index][4] );
+        else
+          sprintf( buffer, "tri" );
       }
-      mesh->el->FreeLocalizedElementDof();
-      mesh->el->FreeLocalizedElementQuantities();
+      else if( ielt == 5 ) {
+        if( eltp[index][5] == 3 )
+          sprintf( buffer, "%dline", eltp[index][5] );
+        else
+          sprintf( buffer, "line" );
+      }
+      char name[8];
+      GMVParallelFile::FillKeyword( buffer, name );
+      cells.insert( cells.end(), name, name + 8 );
+
+      const char* nve = reinterpret_cast < const char* >( &NVE[ielt][index] );
+      cells.insert( cells.end(), nve, nve + sizeof( unsigned ) );
+
+      for( unsigned j = 0; j < NVE[ielt][index]; j++ ) {
+        unsigned jnode_Metis = mesh->GetSolutionDof( j, ii, index );
+        topology[j] = jnode_Metis + 1;
+      }
+      const char* nodes = reinterpret_cast < const char* >( topology );
+      cells.insert( cells.end(), nodes, nodes + sizeof( unsigned ) * NVE[ielt][index] );
     }
+    fout.WriteDistributed( ( cells.size() > 0 ) ? &cells[0] : NULL, cells.size() );
 
     //END CONNETTIVITY
 
     //BEGIN VARIABLES
     const unsigned zero = 0u;
     const unsigned one = 1u;
-    sprintf( buffer, "%s", "variable" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
+    fout.WriteKeyword( "variable" );
 
     //BEGIN METIS PARTITIONING
-    strcpy( buffer, "METIS_DD" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-    fout.write( ( char* ) &zero, sizeof( unsigned ) );
-
-    vector1.resize( nel );
-    unsigned icount = 0;
-    for( int isdom = 0; isdom < _nprocs; isdom++ ) {
-      for( unsigned ii = mesh->_elementOffset[isdom]; ii < mesh->_elementOffset[isdom + 1]; ii++ ) {
-        vector1[icount] = isdom;
-        icount++;
-      }
-    }
-    fout.write( ( char* ) &vector1[0], nel * sizeof( double ) );
+    fout.WriteKeyword( "METIS_DD" );
+    fout.WriteShared( &zero, sizeof( unsigned ) );
+
+    std::vector < double > elementValues( nelOwned, _iproc );
+    fout.WriteDistributed( elementValues );
     //END METIS PARTITIONING
 
     //BEGIN SOLUTION
@@ -227,61 +282,44 @@ namespace femus {
 
         for( int name = 0; name < 4; name++ ) {
           //BEGIN LAGRANGIAN Fem SOLUTION
+          std::string printName;
+          NumericVector* printSol;
           if( name == 0 ) {
-            sprintf( buffer, "%s", _ml_sol->GetSolutionName( i ) );
+            printName = _ml_sol->GetSolutionName( i );
+            printSol = solution->_Sol[i];
           }
           else if( name == 1 ) {
-            sprintf( buffer, "%s %s", "Bdc", _ml_sol->GetSolutionName( i ) );
+            printName = std::string( "Bdc " ) + _ml_sol->GetSolutionName( i );
+            printSol = solution->_Bdc[i];
           }
           else if( name == 2 ) {
-            sprintf( buffer, "%s %s", "Res", _ml_sol->GetSolutionName( i ) );
+            printName = std::string( "Res " ) + _ml_sol->GetSolutionName( i );
+            printSol = solution->_Res[i];
           }
           else {
-            sprintf( buffer, "%s %s", "Eps", _ml_sol->GetSolutionName( i ) );
+            printName = std::string( "Eps " ) + _ml_sol->GetSolutionName( i );
+            printSol = solution->_Eps[i];
           }
           if( name == 0 || ( _debugOutput  && solution->_ResEpsBdcFlag[i] ) ) {
             if( _ml_sol->GetSolutionType( i ) < 3 ) { // **********  on the nodes **********
-              fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-              fout.write( ( char* ) &one, sizeof( unsigned ) );
-              if( name == 0 ) {
-                numVector->matrix_mult( *solution->_Sol[i], *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( i ) ) );
-              }
-              else if( name == 1 ) {
-                numVector->matrix_mult( *solution->_Bdc[i], *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( i ) ) );
-              }
-              else if( name == 2 ) {
-                numVector->matrix_mult( *solution->_Res[i], *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( i ) ) );
-              }
-              else {
-                numVector->matrix_mult( *solution->_Eps[i], *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( i ) ) );
-              }
-              numVector->localize_to_one( vector1, 0 );
-              fout.write( ( char* ) &vector1[0], nvt * sizeof( double ) );
+              fout.WriteKeyword( printName );
+              fout.WriteShared( &one, sizeof( unsigned ) );
+              numVector->matrix_mult( *printSol, *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( i ) ) );
+              GetOwnedValues( numVector, dofOffset, vector1 );
+              fout.WriteDistributed( vector1 );
               //END LAGRANGIAN Fem SOLUTION
             }
             else {
               //BEGIN DISCONTINUOUS Fem SOLUTION
-              fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-              fout.write( ( char* ) &zero, sizeof( unsigned ) );
+              fout.WriteKeyword( printName );
+              fout.WriteShared( &zero, sizeof( unsigned ) );
 
-              if( name == 0 ) {
-                solution->_Sol[i]->localize_to_one( vector2, 0 );
-              }
-              else if( name == 1 ) {
-                solution->_Bdc[i]->localize_to_one( vector2, 0 );
-              }
-              else if( name == 2 ) {
-                solution->_Res[i]->localize_to_one( vector2, 0 );
-              }
-              else {
-                solution->_Eps[i]->localize_to_one( vector2, 0 );
-              }
-              vector1.resize( nel );
-              for( unsigned ii = 0; ii < nel; ii++ ) {
-                vector1[ii] = vector2[ mesh->GetSolutionDof( 0, ii, _ml_sol->GetSolutionType( i ) ) ];
+              NumericVectorLocalView solView = printSol->GetLocalView();
+              for( unsigned ii = elementOffset; ii < elementOffsetp1; ii++ ) {
+                elementValues[ii - elementOffset] = solView( mesh->GetSolutionDof( 0, ii, _ml_sol->GetSolutionType( i ) ) );
               }
 
-              fout.write( ( char* ) &vector1[0], nel * sizeof( double ) );
+              fout.WriteDistributed( elementValues );
               //END DISCONTINUOUS Fem SOLUTION
             }
           }
@@ -290,23 +328,17 @@ namespace femus {
     }
     //END SOLUTION
 
-    sprintf( buffer, "%s", "endvars" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
+    fout.WriteKeyword( "endvars" );
     //END VARIABLES
 
-    sprintf( buffer, "%s", "endgmv" );
-    fout.write( ( char* ) buffer, sizeof( char ) * 8 );
-    fout.close();
+    fout.WriteKeyword( "endgmv" );
     //END GMV FILE PRINT
 
     delete numVector;
-    delete [] buffer;
+
+    if( _profiler ) _profiler->Stop( "GMV output" );
 
     return;
   }
 
 } //end namespace femus
-
-
-
-
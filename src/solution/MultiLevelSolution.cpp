@@ -31,6 +31,13 @@ PURPOSE.  See the above copyright notice for more information.
 #include <iomanip>
 #include <sstream>
 #include <sys/stat.h>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#ifdef HAVE_HDF5
+#include "hdf5.h"
+#endif
 
 namespace femus
 {
@@ -39,6 +46,289 @@ namespace femus
   using std::cout;
   using std::endl;
 
+#ifdef HAVE_HDF5
+  namespace
+  {
+
+    /** Number of integers identifying a dof independently of the partition:
+     * three quantized coordinates and the local index inside the element for discontinuous families */
+    const unsigned checkpointKeySize = 4;
+
+    /** Orders dof indices by their checkpoint keys */
+    class CheckpointKeyLess
+    {
+      public:
+        CheckpointKeyLess(const long long* keys) : _keys(keys) {}
+
+        bool operator()(const unsigned &a, const unsigned &b) const {
+          return std::lexicographical_compare(_keys + checkpointKeySize * a, _keys + checkpointKeySize * (a + 1),
+                                              _keys + checkpointKeySize * b, _keys + checkpointKeySize * (b + 1));
+        }
+
+        bool operator()(const unsigned &a, const long long* key) const {
+          return std::lexicographical_compare(_keys + checkpointKeySize * a, _keys + checkpointKeySize * (a + 1),
+                                              key, key + checkpointKeySize);
+        }
+
+      private:
+        const long long* _keys;
+    };
+
+    /** Quantization step of the checkpoint keys on msh, relative to the bounding box of the whole mesh:
+     * collective, so it has to be called by all the processes */
+    double GetCheckpointKeyStep(Mesh* msh)
+    {
+
+      double box[6] = {1.e300, 1.e300, 1.e300, 1.e300, 1.e300, 1.e300};
+      for(unsigned k = 0; k < 3; k++) {
+        NumericVector* xk = msh->_topology->_Sol[k];
+        for(unsigned i = xk->first_local_index(); i < xk->last_local_index(); i++) {
+          double x = (*xk)(i);
+          if(x < box[k]) box[k] = x;
+          if(-x < box[3 + k]) box[3 + k] = -x;
+        }
+      }
+      MPI_Allreduce(MPI_IN_PLACE, box, 6, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+
+      double diag2 = 0.;
+      for(unsigned k = 0; k < 3; k++) {
+        double lk = -box[3 + k] - box[k];
+        diag2 += (lk > 0.) ? lk * lk : 0.;
+      }
+      return (diag2 > 0.) ? 1.e-9 * sqrt(diag2) : 1.e-9;
+    }
+
+    /** Build the partition-independent keys of the owned dofs of solType on msh, with the step h of GetCheckpointKeyStep */
+    void BuildCheckpointKeys(Mesh* msh, const unsigned &solType, const double &h, std::vector < long long > &keys)
+    {
+
+      unsigned iproc = msh->processor_id();
+      unsigned offset = msh->_dofOffset[solType][iproc];
+      unsigned ownSize = msh->_dofOffset[solType][iproc + 1] - offset;
+
+      keys.assign(checkpointKeySize * ownSize, 0);
+
+      std::vector < double > x(3);
+      for(unsigned iel = msh->_elementOffset[iproc]; iel < msh->_elementOffset[iproc + 1]; iel++) {
+
+        unsigned nDofs = msh->GetElementDofNumber(iel, solType);
+
+        if(solType > 2) {
+          unsigned nDofsX = msh->GetElementDofNumber(iel, 2);
+          std::fill(x.begin(), x.end(), 0.);
+          for(unsigned j = 0; j < nDofsX; j++) {
+            unsigned xDof = msh->GetSolutionDof(j, iel, 2);
+            for(unsigned k = 0; k < 3; k++) x[k] += (*msh->_topology->_Sol[k])(xDof);
+          }
+          for(unsigned k = 0; k < 3; k++) x[k] /= nDofsX;
+        }
+
+        for(unsigned j = 0; j < nDofs; j++) {
+          unsigned dof = msh->GetSolutionDof(j, iel, solType);
+          if(dof < offset || dof >= offset + ownSize) continue;
+
+          if(solType < 3) {
+            unsigned xDof = msh->GetSolutionDof(j, iel, 2);
+            for(unsigned k = 0; k < 3; k++) x[k] = (*msh->_topology->_Sol[k])(xDof);
+          }
+
+          long long* key = &keys[checkpointKeySize * (dof - offset)];
+          for(unsigned k = 0; k < 3; k++) key[k] = static_cast < long long >(floor(x[k] / h + 0.5));
+          key[3] = (solType < 3) ? 0 : j + 1;
+        }
+      }
+    }
+
+    /** Rendezvous process of a checkpoint key */
+    unsigned GetCheckpointKeyProcess(const long long* key, const unsigned &nprocs)
+    {
+      unsigned long hash = 0;
+      for(unsigned k = 0; k < checkpointKeySize; k++) hash = hash * 1000003ul + static_cast < unsigned long >(key[k]);
+      return hash % nprocs;
+    }
+
+    /** Send the rows of width nCols grouped by destination process, order lists the local rows to send sorted by destination,
+     * sendCount and recvCount are counted in rows */
+    template < class Type >
+    void ExchangeCheckpointRows(const std::vector < Type > &rows, const std::vector < unsigned > &order, const unsigned &nCols,
+                                const std::vector < int > &sendCount, const std::vector < int > &recvCount,
+                                MPI_Datatype type, std::vector < Type > &recvRows)
+    {
+      unsigned nprocs = sendCount.size();
+      std::vector < int > sendSize(nprocs), sendDispl(nprocs + 1, 0), recvSize(nprocs), recvDispl(nprocs + 1, 0);
+      for(unsigned p = 0; p < nprocs; p++) {
+        sendSize[p] = sendCount[p] * nCols;
+        sendDispl[p + 1] = sendDispl[p] + sendSize[p];
+        recvSize[p] = recvCount[p] * nCols;
+        recvDispl[p + 1] = recvDispl[p] + recvSize[p];
+      }
+
+      std::vector < Type > sendRows(sendDispl[nprocs] + 1);
+      for(unsigned r = 0; r < order.size(); r++) {
+        std::copy(&rows[nCols * order[r]], &rows[nCols * order[r]] + nCols, &sendRows[nCols * r]);
+      }
+      recvRows.resize(recvDispl[nprocs] + 1);
+      MPI_Alltoallv(&sendRows[0], &sendSize[0], &sendDispl[0], type,
+                    &recvRows[0], &recvSize[0], &recvDispl[0], type, MPI_COMM_WORLD);
+      recvRows.resize(recvDispl[nprocs]);
+    }
+
+    /** Sort the rows by their rendezvous process: order gets the rows by process and count the number of rows per process */
+    void SortCheckpointKeysByProcess(const std::vector < long long > &keys, const unsigned &nprocs,
+                                     std::vector < unsigned > &order, std::vector < int > &count)
+    {
+      unsigned nRows = keys.size() / checkpointKeySize;
+      std::vector < unsigned > process(nRows);
+      count.assign(nprocs, 0);
+      for(unsigned r = 0; r < nRows; r++) {
+        process[r] = GetCheckpointKeyProcess(&keys[checkpointKeySize * r], nprocs);
+        count[process[r]]++;
+      }
+      std::vector < unsigned > position(nprocs, 0);
+      for(unsigned p = 1; p < nprocs; p++) position[p] = position[p - 1] + count[p - 1];
+      order.resize(nRows);
+      for(unsigned r = 0; r < nRows; r++) order[position[process[r]]++] = r;
+    }
+
+    /** Match the owned dofs, identified by keys, with the slice of the checkpoint rows read by this process, identified by
+     * fileKeys and holding nFields values each: on return values[j * nFields + f] holds the fields of the owned dof j.
+     * Both sides meet on the rendezvous process of the key, so no process needs more than its share of the file */
+    void MatchCheckpointRows(const std::vector < long long > &keys, const std::vector < long long > &fileKeys,
+                             const std::vector < double > &fileValues, const unsigned &nFields,
+                             std::vector < double > &values, const std::string &name)
+    {
+      int nprocs;
+      MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+      // the file rows go to the rendezvous processes
+      std::vector < unsigned > fileOrder;
+      std::vector < int > fileSendCount, fileRecvCount(nprocs);
+      SortCheckpointKeysByProcess(fileKeys, nprocs, fileOrder, fileSendCount);
+      MPI_Alltoall(&fileSendCount[0], 1, MPI_INT, &fileRecvCount[0], 1, MPI_INT, MPI_COMM_WORLD);
+
+      std::vector < long long > rendezvousFileKeys;
+      std::vector < double > rendezvousFileValues;
+      ExchangeCheckpointRows(fileKeys, fileOrder, checkpointKeySize, fileSendCount, fileRecvCount, MPI_LONG_LONG, rendezvousFileKeys);
+      ExchangeCheckpointRows(fileValues, fileOrder, nFields, fileSendCount, fileRecvCount, MPI_DOUBLE, rendezvousFileValues);
+
+      // and so do the requests of the owned dofs
+      std::vector < unsigned > order;
+      std::vector < int > sendCount, recvCount(nprocs);
+      SortCheckpointKeysByProcess(keys, nprocs, order, sendCount);
+      MPI_Alltoall(&sendCount[0], 1, MPI_INT, &recvCount[0], 1, MPI_INT, MPI_COMM_WORLD);
+
+      std::vector < long long > requestKeys;
+      ExchangeCheckpointRows(keys, order, checkpointKeySize, sendCount, recvCount, MPI_LONG_LONG, requestKeys);
+
+      // the rendezvous processes answer the requests in the order they have been received
+      unsigned nFileRows = rendezvousFileKeys.size() / checkpointKeySize;
+      const long long* fileKeyBegin = (nFileRows > 0) ? &rendezvousFileKeys[0] : NULL;
+      std::vector < unsigned > fileRow(nFileRows);
+      for(unsigned r = 0; r < nFileRows; r++) fileRow[r] = r;
+      std::sort(fileRow.begin(), fileRow.end(), CheckpointKeyLess(fileKeyBegin));
+
+      unsigned nRequests = requestKeys.size() / checkpointKeySize;
+      std::vector < double > answers(nFields * nRequests);
+      std::vector < unsigned > answerOrder(nRequests);
+      for(unsigned r = 0; r < nRequests; r++) {
+        const long long* key = &requestKeys[checkpointKeySize * r];
+        std::vector < unsigned >::iterator it = std::lower_bound(fileRow.begin(), fileRow.end(), key, CheckpointKeyLess(fileKeyBegin));
+        if(it == fileRow.end() || !std::equal(key, key + checkpointKeySize, fileKeyBegin + checkpointKeySize * (*it))) {
+          std::cerr << "Error: the dof with key (" << key[0] << ", " << key[1] << ", " << key[2] << ", " << key[3]
+                    << ") is not in " << name << std::endl;
+          abort();
+        }
+        std::copy(&rendezvousFileValues[nFields * (*it)], &rendezvousFileValues[nFields * (*it)] + nFields, &answers[nFields * r]);
+        answerOrder[r] = r;
+      }
+
+      std::vector < double > received;
+      ExchangeCheckpointRows(answers, answerOrder, nFields, recvCount, sendCount, MPI_DOUBLE, received);
+
+      values.resize(nFields * order.size());
+      for(unsigned r = 0; r < order.size(); r++) {
+        std::copy(&received[nFields * r], &received[nFields * r] + nFields, &values[nFields * order[r]]);
+      }
+    }
+
+    /** Open or create the checkpoint file, with MPI-IO when HDF5 has been built in parallel */
+    hid_t OpenCheckpointFile(const char* filename, const unsigned &flags, const bool &parallel)
+    {
+      hid_t plist = H5Pcreate(H5P_FILE_ACCESS);
+#ifdef H5_HAVE_PARALLEL
+      if(parallel) H5Pset_fapl_mpio(plist, MPI_COMM_WORLD, MPI_INFO_NULL);
+#endif
+      hid_t file = (flags == H5F_ACC_TRUNC) ? H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, plist) :
+                   H5Fopen(filename, flags, plist);
+      H5Pclose(plist);
+      return file;
+    }
+
+    void CreateCheckpointDataset(hid_t file, const std::string &name, hid_t type, const hsize_t &nRows, const hsize_t &nCols)
+    {
+      hsize_t dims[2] = {nRows, nCols};
+      hid_t space = H5Screate_simple((nCols > 1) ? 2 : 1, dims, NULL);
+      hid_t dataset = H5Dcreate(file, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      H5Dclose(dataset);
+      H5Sclose(space);
+    }
+
+    /** Write or read the rows [offset, offset + nRows) of a dataset; collective when the file has been opened with MPI-IO */
+    void AccessCheckpointRows(hid_t file, const std::string &name, hid_t type, const hsize_t &offset, const hsize_t &nRows,
+                              const hsize_t &nCols, void* data, const bool &write, const bool &collective)
+    {
+      hid_t dataset = H5Dopen(file, name.c_str(), H5P_DEFAULT);
+      hid_t fileSpace = H5Dget_space(dataset);
+      hsize_t start[2] = {offset, 0};
+      hsize_t count[2] = {nRows, nCols};
+      int rank = (nCols > 1) ? 2 : 1;
+      hid_t memSpace = H5Screate_simple(rank, count, NULL);
+      if(nRows > 0) {
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, NULL, count, NULL);
+      }
+      else {
+        H5Sselect_none(fileSpace);
+        H5Sselect_none(memSpace);
+      }
+
+      hid_t xfer = H5Pcreate(H5P_DATASET_XFER);
+#ifdef H5_HAVE_PARALLEL
+      if(collective) H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
+#endif
+      herr_t status = (write) ? H5Dwrite(dataset, type, memSpace, fileSpace, xfer, data) :
+                      H5Dread(dataset, type, memSpace, fileSpace, xfer, data);
+      if(status < 0) {
+        std::cerr << "Error: cannot access the checkpoint dataset " << name << std::endl;
+        abort();
+      }
+      H5Pclose(xfer);
+      H5Sclose(memSpace);
+      H5Sclose(fileSpace);
+      H5Dclose(dataset);
+    }
+
+    void WriteCheckpointAttribute(hid_t object, const char* name, hid_t type, const hsize_t &size, const void* data)
+    {
+      hid_t space = H5Screate_simple(1, &size, NULL);
+      hid_t attribute = H5Acreate(object, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+      H5Awrite(attribute, type, data);
+      H5Aclose(attribute);
+      H5Sclose(space);
+    }
+
+    void ReadCheckpointAttribute(hid_t object, const char* name, hid_t type, void* data)
+    {
+      hid_t attribute = H5Aopen(object, name, H5P_DEFAULT);
+      if(attribute < 0 || H5Aread(attribute, type, data) < 0) {
+        std::cerr << "Error: cannot read the checkpoint attribute " << name << std::endl;
+        abort();
+      }
+      H5Aclose(attribute);
+    }
+
+  }
+#endif
+
 //---------------------------------------------------------------------------------------------------
   MultiLevelSolution::~MultiLevelSolution()
   {
@@ -607,19 +897,137 @@ namespace femus
   void MultiLevelSolution::SaveSolution(const char* filename, const double time)
   {
 
-    char composedFileName[100];
+#ifdef HAVE_HDF5
+
+#ifdef H5_HAVE_PARALLEL
+    const bool parallel = true;
+#else
+    const bool parallel = false;
+#endif
+
+    std::ostringstream composedFileName;
+    composedFileName << "./save/" << filename << "_time" << std::fixed << std::setprecision(6) << time << ".h5";
+
+    std::vector < bool > typeIsUsed(5, false);
+    for(unsigned i = 0; i < _solType.size(); i++) typeIsUsed[_solType[i]] = true;
+
+    // create the level hierarchy and the metadata: collectively with MPI-IO, by the first process otherwise
+    if(parallel || _iproc == 0) {
+      hid_t file = OpenCheckpointFile(composedFileName.str().c_str(), H5F_ACC_TRUNC, parallel);
+      if(file < 0) {
+        std::cerr << "Error: cannot create the checkpoint file " << composedFileName.str() << std::endl;
+        abort();
+      }
+
+      unsigned header[3] = {_gridn, static_cast < unsigned >(_nprocs), static_cast < unsigned >(_solName.size())};
+      WriteCheckpointAttribute(file, "time", H5T_NATIVE_DOUBLE, 1, &time);
+      WriteCheckpointAttribute(file, "levels_nprocs_nvariables", H5T_NATIVE_UINT, 3, header);
+
+      for(unsigned level = 0; level < _gridn; level++) {
+        Mesh* msh = _mlMesh->GetLevel(level);
+        std::ostringstream levelName;
+        levelName << "/level" << level;
+        H5Gclose(H5Gcreate(file, levelName.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+
+        for(unsigned solType = 0; solType < 5; solType++) {
+          if(!typeIsUsed[solType]) continue;
+          std::ostringstream typeName;
+          typeName << levelName.str() << "/type" << solType;
+          hid_t group = H5Gcreate(file, typeName.str().c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+          WriteCheckpointAttribute(group, "dofOffset", H5T_NATIVE_UINT, _nprocs + 1, &msh->_dofOffset[solType][0]);
+          H5Gclose(group);
+          CreateCheckpointDataset(file, typeName.str() + "/keys", H5T_NATIVE_LLONG, msh->_dofOffset[solType][_nprocs], checkpointKeySize);
+        }
+
+        for(unsigned i = 0; i < _solName.size(); i++) {
+          hsize_t nDofs = msh->_dofOffset[_solType[i]][_nprocs];
+          CreateCheckpointDataset(file, levelName.str() + "/sol_" + _solName[i], H5T_NATIVE_DOUBLE, nDofs, 1);
+          if(_solution[level]->_SolOld[i]) {
+            CreateCheckpointDataset(file, levelName.str() + "/old_" + _solName[i], H5T_NATIVE_DOUBLE, nDofs, 1);
+          }
+        }
+      }
+      H5Fclose(file);
+    }
+
+    // the keys need collective communication, so they are built by all the processes before the writes
+    std::vector < std::vector < std::vector < long long > > > keys(_gridn, std::vector < std::vector < long long > >(5));
+    for(unsigned level = 0; level < _gridn; level++) {
+      Mesh* msh = _mlMesh->GetLevel(level);
+      double h = GetCheckpointKeyStep(msh);
+      for(unsigned solType = 0; solType < 5; solType++) {
+        if(typeIsUsed[solType]) BuildCheckpointKeys(msh, solType, h, keys[level][solType]);
+      }
+    }
+
+    // write the owned rows: all together with MPI-IO, one process after the other otherwise
+    std::vector < double > values;
+    for(int jproc = 0; jproc < ((parallel) ? 1 : _nprocs); jproc++) {
+      if(!parallel) MPI_Barrier(MPI_COMM_WORLD);
+      if(!parallel && jproc != _iproc) continue;
+
+      hid_t file = OpenCheckpointFile(composedFileName.str().c_str(), H5F_ACC_RDWR, parallel);
+
+      for(unsigned level = 0; level < _gridn; level++) {
+        Mesh* msh = _mlMesh->GetLevel(level);
+        std::ostringstream levelName;
+        levelName << "/level" << level;
+
+        for(unsigned solType = 0; solType < 5; solType++) {
+          if(!typeIsUsed[solType]) continue;
+          std::ostringstream typeName;
+          typeName << levelName.str() << "/type" << solType << "/keys";
+          hsize_t offset = msh->_dofOffset[solType][_iproc];
+          hsize_t ownSize = msh->_dofOffset[solType][_iproc + 1] - offset;
+          AccessCheckpointRows(file, typeName.str(), H5T_NATIVE_LLONG, offset, ownSize, checkpointKeySize,
+                               (ownSize > 0) ? &keys[level][solType][0] : NULL, true, parallel);
+        }
+
+        for(unsigned i = 0; i < _solName.size(); i++) {
+          unsigned solType = _solType[i];
+          hsize_t offset = msh->_dofOffset[solType][_iproc];
+          hsize_t ownSize = msh->_dofOffset[solType][_iproc + 1] - offset;
+          values.resize(ownSize);
+
+          for(unsigned old = 0; old < 2; old++) {
+            NumericVector* sol = (old) ? _solution[level]->_SolOld[i] : _solution[level]->_Sol[i];
+            if(sol == NULL) continue;
+            NumericVectorLocalView solView = sol->GetLocalView();
+            for(unsigned j = 0; j < ownSize; j++) values[j] = solView(offset + j);
+            AccessCheckpointRows(file, levelName.str() + ((old) ? "/old_" : "/sol_") + _solName[i], H5T_NATIVE_DOUBLE,
+                                 offset, ownSize, 1, (ownSize > 0) ? &values[0] : NULL, true, parallel);
+          }
+        }
+      }
+      H5Fclose(file);
+    }
+    if(!parallel) MPI_Barrier(MPI_COMM_WORLD);
+
+#else
 
     for(int i = 0; i < _solName.size(); i++) {
-      sprintf(composedFileName, "./save/%s_time%f_sol%s_level%d", filename, time, _solName[i], _gridn);
-      _solution[_gridn - 1]->_Sol[i]->BinaryPrint(composedFileName);
+      std::ostringstream composedFileName;
+      composedFileName << "./save/" << filename << "_time" << std::fixed << std::setprecision(6) << time
+                       << "_sol" << _solName[i] << "_level" << _gridn;
+      _solution[_gridn - 1]->_Sol[i]->BinaryPrint(composedFileName.str().c_str());
     }
+
+#endif
   }
 
   void MultiLevelSolution::LoadSolution(const char* filename)
   {
-    LoadSolution(_gridn, filename);
+    size_t length = strlen(filename);
+    if(length > 3 && !strcmp(filename + length - 3, ".h5")) {
+      double time;
+      LoadSolution(filename, time);
+    }
+    else {
+      LoadSolution(_gridn, filename);
+    }
   }
 
+
   void MultiLevelSolution::LoadSolution(const unsigned &level, const char* filename)
   {
 
@@ -629,18 +1037,18 @@ namespace femus
       abort();
     }
 
-    char composedFileName[200];
     for(int i = 0; i < _solName.size(); i++) {
-      sprintf(composedFileName, "%s_sol%s_level%d", filename, _solName[i], level);
+      std::ostringstream composedFileName;
+      composedFileName << filename << "_sol" << _solName[i] << "_level" << level;
       // check if the file really exists
       if(strncmp(filename, "http://", 7) && strncmp(filename, "ftp://", 6)) {
         struct stat buffer;
-        if(stat(composedFileName, &buffer) != 0) {
-          std::cerr << "Error: cannot locate file " << composedFileName << std::endl;
+        if(stat(composedFileName.str().c_str(), &buffer) != 0) {
+          std::cerr << "Error: cannot locate file " << composedFileName.str() << std::endl;
           abort();
         }
       }
-      _solution[level - 1]->_Sol[i]->BinaryLoad(composedFileName);
+      _solution[level - 1]->_Sol[i]->BinaryLoad(composedFileName.str().c_str());
     }
 
     for(int gridf = level; gridf < _gridn; gridf++) {
@@ -655,6 +1063,164 @@ namespace femus
   }
 
 
+  void MultiLevelSolution::LoadSolution(const char* filename, double &time)
+  {
+
+#ifdef HAVE_HDF5
+
+#ifdef H5_HAVE_PARALLEL
+    const bool parallel = true;
+#else
+    const bool parallel = false;
+#endif
+
+    // every process opens the file for reading: independently unless HDF5 has been built in parallel
+    hid_t file = OpenCheckpointFile(filename, H5F_ACC_RDONLY, parallel);
+    if(file < 0) {
+      std::cerr << "Error: cannot open the checkpoint file " << filename << std::endl;
+      abort();
+    }
+
+    unsigned header[3];
+    ReadCheckpointAttribute(file, "time", H5T_NATIVE_DOUBLE, &time);
+    ReadCheckpointAttribute(file, "levels_nprocs_nvariables", H5T_NATIVE_UINT, header);
+    unsigned fileLevels = (header[0] < _gridn) ? header[0] : _gridn;
+    unsigned fileNprocs = header[1];
+
+    std::vector < long long > fileKeys;
+    std::vector < long long > keys;
+    std::vector < double > fileValues;
+    std::vector < double > values;
+    std::vector < double > fieldValues;
+    std::vector < unsigned > fileDofOffset(fileNprocs + 1);
+
+    for(unsigned level = 0; level < fileLevels; level++) {
+      Mesh* msh = _mlMesh->GetLevel(level);
+      std::ostringstream levelName;
+      levelName << "/level" << level;
+
+      // collective, so it is computed by all the processes even if the partition matches
+      double h = GetCheckpointKeyStep(msh);
+
+      for(unsigned solType = 0; solType < 5; solType++) {
+
+        std::vector < unsigned > solIndex;
+        for(unsigned i = 0; i < _solName.size(); i++) {
+          if(_solType[i] == solType) solIndex.push_back(i);
+        }
+        if(solIndex.size() == 0) continue;
+
+        std::ostringstream typeName;
+        typeName << levelName.str() << "/type" << solType;
+        hid_t group = H5Gopen(file, typeName.str().c_str(), H5P_DEFAULT);
+        if(group < 0) {
+          std::cerr << "Error: the checkpoint file " << filename << " has no " << typeName.str() << " group" << std::endl;
+          abort();
+        }
+        ReadCheckpointAttribute(group, "dofOffset", H5T_NATIVE_UINT, &fileDofOffset[0]);
+        H5Gclose(group);
+
+        unsigned offset = msh->_dofOffset[solType][_iproc];
+        unsigned ownSize = msh->_dofOffset[solType][_iproc + 1] - offset;
+        unsigned nDofs = fileDofOffset[fileNprocs];
+
+        if(nDofs != msh->_dofOffset[solType][_nprocs]) {
+          std::cerr << "Error: the checkpoint file " << filename << " does not match the mesh at " << typeName.str() << std::endl;
+          abort();
+        }
+
+        // the stored fields of this family: current and old solutions, an old solution missing from the file is
+        // copied from the current one once this has been read
+        std::vector < NumericVector* > fieldSol;
+        std::vector < std::string > fieldName;
+        std::vector < unsigned > missingOld;
+        for(unsigned k = 0; k < solIndex.size(); k++) {
+          unsigned i = solIndex[k];
+          for(unsigned old = 0; old < 2; old++) {
+            NumericVector* sol = (old) ? _solution[level]->_SolOld[i] : _solution[level]->_Sol[i];
+            if(sol == NULL) continue;
+
+            std::string name = levelName.str() + ((old) ? "/old_" : "/sol_") + _solName[i];
+            if(H5Lexists(file, name.c_str(), H5P_DEFAULT) <= 0) {
+              if(old) {
+                missingOld.push_back(i);
+                continue;
+              }
+              std::cerr << "Error: the checkpoint file " << filename << " has no " << name << " dataset" << std::endl;
+              abort();
+            }
+            fieldSol.push_back(sol);
+            fieldName.push_back(name);
+          }
+        }
+        unsigned nFields = fieldSol.size();
+
+        // same partition: each process reads its own rows, otherwise each process reads an even slice of the file
+        // and the dofs are matched through their keys
+        bool samePartition = (fileNprocs == static_cast < unsigned >(_nprocs) &&
+                              std::equal(fileDofOffset.begin(), fileDofOffset.end(), msh->_dofOffset[solType].begin()));
+
+        unsigned fileBegin = (samePartition) ? offset :
+                             static_cast < unsigned >((static_cast < unsigned long long >(nDofs) * _iproc) / _nprocs);
+        unsigned nFileRows = (samePartition) ? ownSize :
+                             static_cast < unsigned >((static_cast < unsigned long long >(nDofs) * (_iproc + 1)) / _nprocs) - fileBegin;
+
+        fileValues.resize(nFields * nFileRows);
+        fieldValues.resize(nFileRows);
+        for(unsigned f = 0; f < nFields; f++) {
+          AccessCheckpointRows(file, fieldName[f], H5T_NATIVE_DOUBLE, fileBegin, nFileRows, 1,
+                               (nFileRows > 0) ? &fieldValues[0] : NULL, false, parallel);
+          for(unsigned r = 0; r < nFileRows; r++) fileValues[nFields * r + f] = fieldValues[r];
+        }
+
+        if(samePartition) {
+          values.swap(fileValues);
+        }
+        else {
+          fileKeys.resize(checkpointKeySize * nFileRows);
+          AccessCheckpointRows(file, typeName.str() + "/keys", H5T_NATIVE_LLONG, fileBegin, nFileRows, checkpointKeySize,
+                               (nFileRows > 0) ? &fileKeys[0] : NULL, false, parallel);
+          BuildCheckpointKeys(msh, solType, h, keys);
+          MatchCheckpointRows(keys, fileKeys, fileValues, nFields, values, std::string(filename) + ":" + typeName.str());
+        }
+
+        for(unsigned f = 0; f < nFields; f++) {
+          for(unsigned j = 0; j < ownSize; j++) fieldSol[f]->set(offset + j, values[nFields * j + f]);
+          fieldSol[f]->close();
+        }
+
+        for(unsigned k = 0; k < missingOld.size(); k++) {
+          *_solution[level]->_SolOld[missingOld[k]] = *_solution[level]->_Sol[missingOld[k]];
+        }
+      }
+    }
+
+    H5Fclose(file);
+
+    // levels missing from the checkpoint are projected from the finest saved one
+    for(unsigned gridf = fileLevels; gridf < _gridn; gridf++) {
+      for(unsigned i = 0; i < _solName.size(); i++) {
+        _solution[gridf]->_Sol[i]->matrix_mult(*_solution[gridf - 1]->_Sol[i],
+                                               *_mlMesh->GetLevel(gridf)->GetCoarseToFineProjection(_solType[i]));
+        _solution[gridf]->_Sol[i]->close();
+        if(_solution[gridf]->_SolOld[i] && _solution[gridf - 1]->_SolOld[i]) {
+          _solution[gridf]->_SolOld[i]->matrix_mult(*_solution[gridf - 1]->_SolOld[i],
+                                                    *_mlMesh->GetLevel(gridf)->GetCoarseToFineProjection(_solType[i]));
+          _solution[gridf]->_SolOld[i]->close();
+        }
+      }
+    }
+
+#else
+
+    std::cout << "Error in MultiLevelSolution::LoadSolution function:" << std::endl;
+    std::cout << "reading the checkpoint " << filename << " requires FEMuS to be built with HDF5" << std::endl;
+    abort();
+
+#endif
+  }
+
+
   void MultiLevelSolution::RefineSolution(const unsigned &gridf)
   {
 
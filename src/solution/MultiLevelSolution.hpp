@@ -210,9 +210,14 @@ public:
 
     bool _useParsedBCFunction;
 
+    /** Save a restart file. With HDF5 a single checkpoint ./save/filename_time%f.h5 is written collectively,
+     * holding the time, the level hierarchy and the current and old solutions of all the variables */
     void SaveSolution(const char* filename, const double time=0.);
+    /** Load a restart file. A filename ending in .h5 is read as a checkpoint written by SaveSolution */
     void LoadSolution(const char* filename);
     void LoadSolution(const unsigned &level, const char* filename);
+    /** Load an HDF5 checkpoint, possibly written with a different number of processes, and return its time */
+    void LoadSolution(const char* filename, double &time);
     
      // *******************************************************
 
@@ -317,49 +317,81 @@ namespace femus {
 
   void Solution::UpdateSol(const vector <unsigned> &_SolPdeIndex,  NumericVector* _EPS, const vector <vector <unsigned> > &KKoffset) {
 
-    PetscScalar zero = 0.;
+    unsigned iproc = processor_id();
+
+    // the owned block of each variable is copied into _Eps and added to _Sol directly on the local arrays
+    NumericVectorLocalView epsView = _EPS->GetLocalView();
 
     for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
       unsigned indexSol = _SolPdeIndex[k];
       unsigned soltype =  _SolType[indexSol];
 
-      int loc_offset_EPS = KKoffset[k][processor_id()];
+      int loc_offset_EPS = KKoffset[k][iproc];
+      unsigned ownSize = _msh->_ownSize[soltype][iproc];
 
-      int glob_offset_eps = _msh->_dofOffset[soltype][processor_id()];
-
-      vector <int> index(_msh->_ownSize[soltype][processor_id()]);
+      double* eps = _Eps[indexSol]->GetOwnedArray();
+      double* sol = _Sol[indexSol]->GetOwnedArray();
+      double* amrEps = (_AMR_flag) ? _AMREps[indexSol]->GetOwnedArray() : NULL;
 
-      for(int i = 0; i < _msh->_ownSize[soltype][processor_id()]; i++) {
-        index[i] = loc_offset_EPS + i;
+      for(unsigned i = 0; i < ownSize; i++) {
+        double value = epsView(loc_offset_EPS + i);
+        eps[i] = value;
+        sol[i] += value;
+        if(amrEps) amrEps[i] += value;
       }
+    }
 
-      vector <double> valueEPS(_msh->_ownSize[soltype][processor_id()]);
-      _EPS->get(index, valueEPS);
-      //vector <double> valueRES(_msh->_ownSize[soltype][processor_id()]);
-      //_RES->get(index,valueRES);
+    // _Eps[i] and _AMREps[i] are duplicates of _Sol[i] and share its ghost scatter,
+    // so the three are updated one after the other, overlapping only across the variables
+    UpdateGhosts(_SolPdeIndex, _Sol);
+    UpdateGhosts(_SolPdeIndex, _Eps);
+    if(_AMR_flag) UpdateGhosts(_SolPdeIndex, _AMREps);
 
-      for(int i = 0; i < _msh->_ownSize[soltype][processor_id()]; i++) {
-        _Eps[indexSol]->set(i + glob_offset_eps, valueEPS[i]);
-        //if ((*_Bdc[indexSol])(i+glob_offset_eps)>1.1) _Res[indexSol]->set(i+glob_offset_eps,valueRES[i]);
-        //else _Res[indexSol]->set(i+glob_offset_eps,zero);
-      }
+  }
 
-      //_Res[indexSol]->close();
-      _Eps[indexSol]->close();
-    }
+  /**
+   * Scale the last update of _Sol
+   **/
+
+  void Solution::ScaleSolUpdate(const vector <unsigned> &_SolPdeIndex, const double &factor) {
+
+    unsigned iproc = processor_id();
 
     for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
       unsigned indexSol = _SolPdeIndex[k];
-      _Sol[indexSol]->add(*_Eps[indexSol]);
-      _Sol[indexSol]->close();
+      unsigned ownSize = _msh->_ownSize[_SolType[indexSol]][iproc];
 
-      if(_AMR_flag) {
-        _AMREps[indexSol]->add(*_Eps[indexSol]);
-        _AMREps[indexSol]->close();
+      double* eps = _Eps[indexSol]->GetOwnedArray();
+      double* sol = _Sol[indexSol]->GetOwnedArray();
+      double* amrEps = (_AMR_flag) ? _AMREps[indexSol]->GetOwnedArray() : NULL;
+
+      for(unsigned i = 0; i < ownSize; i++) {
+        double value = (factor - 1.) * eps[i];
+        eps[i] += value;
+        sol[i] += value;
+        if(amrEps) amrEps[i] += value;
       }
+    }
 
+    UpdateGhosts(_SolPdeIndex, _Sol);
+    UpdateGhosts(_SolPdeIndex, _Eps);
+    if(_AMR_flag) UpdateGhosts(_SolPdeIndex, _AMREps);
+  }
+
+
+  /**
+   * Update the ghosts of one vector per variable
+   **/
+
+  void Solution::UpdateGhosts(const vector <unsigned> &_SolPdeIndex, vector <NumericVector*> &vec) {
+
+    for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
+      vec[_SolPdeIndex[k]]->UpdateGhostsBegin();
     }
 
+    for(unsigned k = 0; k < _SolPdeIndex.size(); k++) {
+      vec[_SolPdeIndex[k]]->UpdateGhostsEnd();
+    }
   }
 
 
@@ -72,6 +72,8 @@ namespace femus {
 //       void UpdateSolAndRes(const vector <unsigned> &_SolPdeIndex,  NumericVector* EPS, NumericVector* RES, const vector <vector <unsigned> > &KKoffset);
 
       void UpdateSol(const vector <unsigned> &_SolPdeIndex,  NumericVector* EPS, const vector <vector <unsigned> > &KKoffset);
+      /** Scales by factor the last update of UpdateSol, stored in _Eps, and moves _Sol accordingly. It is used to backtrack the Newton step */
+      void ScaleSolUpdate(const vector <unsigned> &_SolPdeIndex, const double &factor);
       /** */
       void UpdateRes(const vector <unsigned> &_SolPdeIndex, NumericVector* _RES, const vector <vector <unsigned> > &KKoffset);
 
@@ -147,6 +149,9 @@ namespace femus {
       }
       
     private:
+      /** Updates the ghosts of vec[_SolPdeIndex[k]] for all k. These vectors have distinct scatter contexts, so their communication overlaps */
+      void UpdateGhosts(const vector <unsigned> &_SolPdeIndex, vector <NumericVector*> &vec);
+
       //member data
       vector <int> _SolType;
       vector <char*> _SolName;
@@ -19,6 +19,8 @@
 #include "VTKWriter.hpp"
 #include "MultiLevelProblem.hpp"
 #include "NumericVector.hpp"
+#include "Profiler.hpp"
+#include "FemusConfig.hpp"
 #include <b64/b64.h>
 #include <iostream>
 #include <fstream>
@@ -29,6 +31,10 @@
 #include <algorithm>
 #include "Files.hpp"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 namespace femus {
 
 
@@ -37,17 +43,123 @@ namespace femus {
 
   VTKWriter::VTKWriter( MultiLevelSolution* ml_sol ): Writer( ml_sol ) {
     _debugOutput = false;
+    _doublePrecision = false;
+    _encoding = VTK_BASE64;
+    for( unsigned i = 0; i < 3; i++ ) _coordinateMesh[i] = NULL;
   }
 
   VTKWriter::VTKWriter( MultiLevelMesh* ml_mesh ): Writer( ml_mesh ) {
     _debugOutput = false;
+    _doublePrecision = false;
+    _encoding = VTK_BASE64;
+    for( unsigned i = 0; i < 3; i++ ) _coordinateMesh[i] = NULL;
   }
 
   VTKWriter::~VTKWriter(){}
 
 
+  void VTKWriter::SetVtkEncoding( const VTKEncodingEnum &encoding ) {
+    _encoding = encoding;
+#ifndef HAVE_ZLIB
+    if( _encoding == VTK_ZLIB ) {
+      std::cout << "Warning FEMuS has been built without zlib, the vtu data arrays are appended uncompressed" << std::endl;
+      _encoding = VTK_RAW;
+    }
+#endif
+  }
+
+
+  void VTKWriter::PrintDataArray( std::ofstream &fout, std::ofstream &Pfout, const char type[], const std::string &name,
+                                  const unsigned &nComponents, const void* data, const unsigned &nBytes ) {
+
+    fout  << "        <DataArray type=\"" << type << "\"";
+    Pfout << "      <PDataArray type=\"" << type << "\"";
+    if( !name.empty() ) {
+      fout  << " Name=\"" << name << "\"";
+      Pfout << " Name=\"" << name << "\"";
+    }
+    if( nComponents > 1 ) {
+      fout  << " NumberOfComponents=\"" << nComponents << "\"";
+      Pfout << " NumberOfComponents=\"" << nComponents << "\"";
+    }
+    Pfout << " format=\"binary\"/>" << std::endl;
+
+    if( _encoding == VTK_BASE64 ) {
+      fout << " format=\"binary\">" << std::endl;
+
+      //print the array dimension and then the array, block by block
+      const unsigned header[] = { nBytes };
+      size_t cch = b64::b64_encode( header, sizeof( header ), NULL, 0 );
+      _encodeBuffer.resize( cch );
+      b64::b64_encode( header, sizeof( header ), &_encodeBuffer[0], cch );
+      fout.write( &_encodeBuffer[0], cch );
+
+      if( nBytes > 0 ) {
+        cch = b64::b64_encode( data, nBytes, NULL, 0 );
+        _encodeBuffer.resize( cch );
+        b64::b64_encode( data, nBytes, &_encodeBuffer[0], cch );
+        fout.write( &_encodeBuffer[0], cch );
+      }
+      fout << std::endl;
+      fout << "        </DataArray>" << std::endl;
+    }
+    else {
+      fout << " format=\"appended\" offset=\"" << _appendedData.size() << "\"/>" << std::endl;
+
+      const char* bytes = static_cast < const char* >( data );
+      if( _encoding == VTK_RAW ) {
+        const char* header = reinterpret_cast < const char* >( &nBytes );
+        _appendedData.insert( _appendedData.end(), header, header + sizeof( unsigned ) );
+        _appendedData.insert( _appendedData.end(), bytes, bytes + nBytes );
+      }
+#ifdef HAVE_ZLIB
+      else {
+        // vtkZLibDataCompressor header: number of blocks, block size, last block size, compressed block sizes
+        unsigned header[4] = {0, 0, 0, 0};
+        uLongf compressedSize = 0;
+        if( nBytes > 0 ) {
+          compressedSize = compressBound( nBytes );
+          _encodeBuffer.resize( compressedSize );
+          compress2( reinterpret_cast < Bytef* >( &_encodeBuffer[0] ), &compressedSize,
+                     reinterpret_cast < const Bytef* >( bytes ), nBytes, Z_BEST_SPEED );
+          header[0] = 1;
+          header[1] = nBytes;
+          header[2] = nBytes;
+          header[3] = compressedSize;
+        }
+        const char* headerBytes = reinterpret_cast < const char* >( header );
+        _appendedData.insert( _appendedData.end(), headerBytes, headerBytes + ( ( nBytes > 0 ) ? 4 : 3 ) * sizeof( unsigned ) );
+        if( nBytes > 0 ) _appendedData.insert( _appendedData.end(), _encodeBuffer.begin(), _encodeBuffer.begin() + compressedSize );
+      }
+#endif
+    }
+  }
+
+
+  void VTKWriter::PrintDataArray( std::ofstream &fout, std::ofstream &Pfout, const std::string &name,
+                                  const unsigned &nComponents, const std::vector < double > &data ) {
+    if( _doublePrecision ) {
+      PrintDataArray( fout, Pfout, "Float64", name, nComponents, ( data.size() > 0 ) ? &data[0] : NULL, data.size() * sizeof( double ) );
+    }
+    else {
+      _floatBuffer.assign( data.begin(), data.end() );
+      PrintDataArray( fout, Pfout, "Float32", name, nComponents, ( data.size() > 0 ) ? &_floatBuffer[0] : NULL, data.size() * sizeof( float ) );
+    }
+  }
+
+
+  const NumericVector& VTKWriter::ProjectSolution( NumericVector* mysol, NumericVector* sol, Mesh* mesh,
+                                                   const unsigned &index, const unsigned &solType ) {
+    if( solType == index ) return *sol;
+    mysol->matrix_mult( *sol, *mesh->GetQitoQjProjection( index, solType ) );
+    return *mysol;
+  }
+
+
   void VTKWriter::Write( const std::string output_path, const char order[], const std::vector < std::string >& vars, const unsigned time_step ) {
 
+    if( _profiler ) _profiler->Start( "VTK output" );
+
     // *********** open vtu files *************
     std::ofstream fout;
 
@@ -55,7 +167,6 @@ namespace femus {
     Files files;
     files.CheckDir( output_path, dirnamePVTK );
 
-    int icount;
     unsigned index = 0;
     if( !strcmp( order, "linear" ) ) 	 index = 0; //linear
     else if( !strcmp( order, "quadratic" ) ) 	 index = 1; //quadratic
@@ -68,7 +179,7 @@ namespace femus {
     std::ostringstream filename;
     filename << output_path << "/" << dirnamePVTK << filename_prefix << ".level" << _gridn << "." << _iproc << "." << time_step << "." << order << ".vtu";
 
-    fout.open( filename.str().c_str() );
+    fout.open( filename.str().c_str(), std::ios::binary );
     if( !fout.is_open() ) {
       std::cout << std::endl << " The output file " << filename.str() << " cannot be opened.\n";
       abort();
@@ -76,9 +187,13 @@ namespace femus {
 
     // *********** write vtu header ************
     fout << "<?xml version=\"1.0\"?>" << std::endl;
-    fout << "<VTKFile type = \"UnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\">" << std::endl;
+    fout << "<VTKFile type = \"UnstructuredGrid\" version=\"0.1\" byte_order=\"LittleEndian\"";
+    if( _encoding == VTK_ZLIB ) fout << " compressor=\"vtkZLibDataCompressor\"";
+    fout << ">" << std::endl;
     fout << "  <UnstructuredGrid>" << std::endl;
 
+    _appendedData.clear();
+
     // *********** open pvtu file *************
     std::ofstream Pfout;
     if( _iproc != 0 ) {
@@ -109,7 +224,7 @@ namespace femus {
     // ****************************************
 
     Mesh* mesh = _ml_mesh->GetLevel( _gridn - 1 );
-    Solution* solution = _ml_sol->GetSolutionLevel( _gridn - 1 );
+    Solution* solution = ( _ml_sol != NULL ) ? _ml_sol->GetSolutionLevel( _gridn - 1 ) : NULL;
 
     //count the own node dofs on all levels
     unsigned nvt = mesh->_ownSize[index][_iproc];
@@ -123,7 +238,6 @@ namespace femus {
     unsigned nel = elemetOffsetp1 - elemetOffset;
     unsigned dofOffset = mesh->_dofOffset[index][_iproc];
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      short unsigned ielt = mesh->GetElementType( iel );
       for( unsigned j = 0; j < mesh->GetElementDofNumber( iel, index ); j++ ) {
         counter++;
         unsigned jdof = mesh->GetSolutionDof( j, iel, index );
@@ -139,34 +253,12 @@ namespace femus {
     unsigned nvtOwned = nvt;
     nvt += ghostMap.size(); // total node dofs (own + ghost)
 
-    const unsigned dim_array_coord [] = { nvt * 3 * sizeof( float ) };
-    const unsigned dim_array_conn[]   = { counter * sizeof( int ) };
-    const unsigned dim_array_off []   = { nel * sizeof( int ) };
-    const unsigned dim_array_type []  = { nel * sizeof( short unsigned ) };
-    const unsigned dim_array_reg []   = { nel * sizeof( short unsigned ) };
-    const unsigned dim_array_elvar [] = { nel * sizeof( float ) };
-    const unsigned dim_array_ndvar [] = { nvt * sizeof( float ) };
-
-    // initialize common buffer_void memory
-    unsigned buffer_size = ( dim_array_coord[0] > dim_array_conn[0] ) ? dim_array_coord[0] : dim_array_conn[0];
-    void* buffer_void = new char [buffer_size];
-    char* buffer_char = static_cast <char*>( buffer_void );
-
-    size_t cch;
-    cch = b64::b64_encode( &buffer_char[0], buffer_size , NULL, 0 );
-    vector <char> enc;
-    enc.resize( cch );
-    char* pt_char;
-
     fout  << "    <Piece NumberOfPoints= \"" << nvt << "\" NumberOfCells= \"" << nel << "\" >" << std::endl;
 
     //-----------------------------------------------------------------------------------------------
     // print coordinates *********************************************Solu*******************************************
     fout  << "      <Points>" << std::endl;
-    fout  << "        <DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"binary\">" << std::endl;
-
     Pfout << "    <PPoints>" << std::endl;
-    Pfout << "      <PDataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"binary\"/>" << std::endl;
 
     NumericVector* mysol;
     mysol = NumericVector::build().release();
@@ -181,83 +273,49 @@ namespace femus {
                    mesh->_ghostDofs[index][_iproc], false, GHOSTED );
     }
 
-    // point pointer to common mamory area buffer of void type;
-    float* var_coord = static_cast<float*>( buffer_void );
-
-    for( int i = 0; i < 3; i++ ) {
-      if( !_surface ) {
-        mysol->matrix_mult( *mesh->_topology->_Sol[i],
-                            *mesh->GetQitoQjProjection( index, 2 ) );
-        if( _graph && i == 2 ) {
-          unsigned indGraph = _ml_sol->GetIndex( _graphVariable.c_str() );
-          mysol->matrix_mult( *solution->_Sol[indGraph],
-                              *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indGraph ) ) );
-        }
-      }
-      else {
-        unsigned indSurfVar = _ml_sol->GetIndex( _surfaceVariables[i].c_str() );
-        mysol->matrix_mult( *solution->_Sol[indSurfVar],
-                            *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indSurfVar ) ) );
-      }
-      for( unsigned ii = 0; ii < nvtOwned; ii++ ) {
-        var_coord[ ii * 3 + i] = ( *mysol )( ii +  dofOffset );
-      }
-      if( _ml_sol != NULL && _moving_mesh  && _ml_mesh->GetLevel( 0 )->GetDimension() > i )  { // if moving mesh
-        unsigned indDXDYDZ = _ml_sol->GetIndex( _moving_vars[i].c_str() );
-        mysol->matrix_mult( *solution->_Sol[indDXDYDZ],
-                            *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indDXDYDZ ) ) );
+    // the projection of the mesh coordinates is computed only once for each mesh and order
+    std::vector < double > &coordinateCache = _coordinateCache[index];
+    if( _coordinateMesh[index] != mesh || coordinateCache.size() != 3 * nvt ) {
+      coordinateCache.resize( 3 * nvt );
+      for( int i = 0; i < 3; i++ ) {
+        NumericVectorLocalView xView = ProjectSolution( mysol, mesh->_topology->_Sol[i], mesh, index, 2 ).GetLocalView();
         for( unsigned ii = 0; ii < nvtOwned; ii++ ) {
-          var_coord[ii * 3 + i] += ( *mysol )( ii +  dofOffset );
+          coordinateCache[ ii * 3 + i] = xView( ii + dofOffset );
+        }
+        for( std::map <unsigned, unsigned>::iterator it = ghostMap.begin(); it != ghostMap.end(); ++it ) {
+          coordinateCache[ ( nvtOwned + it->second ) * 3 + i ] = xView( it->first );
         }
       }
+      _coordinateMesh[index] = mesh;
     }
-    unsigned offset_ig = 3 * nvtOwned;
+    std::vector < double > var_coord( coordinateCache );
 
-    //print ghost nodes
     for( int i = 0; i < 3; i++ ) {
-      if( !_surface ) {
-        mysol->matrix_mult( *mesh-> _topology->_Sol[i],
-                            *mesh-> GetQitoQjProjection( index, 2 ) );
-        if( _graph && i == 2 ) {
-          unsigned indGraphVar = _ml_sol->GetIndex( _graphVariable.c_str() );
-          mysol->matrix_mult( *solution->_Sol[indGraphVar],
-                              *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indGraphVar ) ) );
+      bool replace = _surface || ( _graph && i == 2 );
+      bool add = _ml_sol != NULL && _moving_mesh && mesh->GetDimension() > i;
+      for( unsigned move = 0; move < 2; move++ ) {
+        if( ( move == 0 && !replace ) || ( move == 1 && !add ) ) continue;
+
+        unsigned solIndex;
+        if( move == 1 ) solIndex = _ml_sol->GetIndex( _moving_vars[i].c_str() ); // if moving mesh
+        else if( _surface ) solIndex = _ml_sol->GetIndex( _surfaceVariables[i].c_str() );
+        else solIndex = _ml_sol->GetIndex( _graphVariable.c_str() );
+
+        NumericVectorLocalView solView = ProjectSolution( mysol, solution->_Sol[solIndex], mesh, index,
+                                                          _ml_sol->GetSolutionType( solIndex ) ).GetLocalView();
+        double scale = ( move == 0 ) ? 0. : 1.;
+        for( unsigned ii = 0; ii < nvtOwned; ii++ ) {
+          var_coord[ ii * 3 + i] = scale * var_coord[ ii * 3 + i] + solView( ii + dofOffset );
         }
-      }
-      else {
-        unsigned indSurfVar = _ml_sol->GetIndex( _surfaceVariables[i].c_str() );
-        mysol->matrix_mult( *solution->_Sol[indSurfVar],
-                            *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indSurfVar ) ) );
-      }
-      for( std::map <unsigned, unsigned>::iterator it = ghostMap.begin(); it != ghostMap.end(); ++it ) {
-        var_coord[ offset_ig + 3 * it->second + i ] = ( *mysol )( it->first );
-      }
-    }
-
-    for( int i = 0; i < 3; i++ ) { // if moving mesh
-      if( _ml_sol != NULL && _moving_mesh  && mesh->GetDimension() > i )  {
-        unsigned indDXDYDZ = _ml_sol->GetIndex( _moving_vars[i].c_str() );
-        mysol->matrix_mult( *solution->_Sol[indDXDYDZ],
-                            *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( indDXDYDZ ) ) );
         for( std::map <unsigned, unsigned>::iterator it = ghostMap.begin(); it != ghostMap.end(); ++it ) {
-          var_coord[ offset_ig + 3 * it->second + i ] += ( *mysol )( it->first );
+          unsigned ii = nvtOwned + it->second;
+          var_coord[ ii * 3 + i ] = scale * var_coord[ ii * 3 + i ] + solView( it->first );
         }
       }
     }
 
-    cch = b64::b64_encode( &dim_array_coord[0], sizeof( dim_array_coord ), NULL, 0 );
-    b64::b64_encode( &dim_array_coord[0], sizeof( dim_array_coord ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    //print coordinates array
-    cch = b64::b64_encode( &var_coord[0], dim_array_coord[0] , NULL, 0 );
-    b64::b64_encode( &var_coord[0], dim_array_coord[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
+    PrintDataArray( fout, Pfout, "", 3, var_coord );
 
-    fout  << "        </DataArray>" << std::endl;
     fout  << "      </Points>" << std::endl;
     Pfout << "    </PPoints>" << std::endl;
     //-----------------------------------------------------------------------------------------------
@@ -268,12 +326,8 @@ namespace femus {
     Pfout << "    <PCells>" << std::endl;
     //-----------------------------------------------------------------------------------------------
     //print connectivity
-    fout  << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Int32\" Name=\"connectivity\" format=\"binary\"/>" << std::endl;
-
-    // point pointer to common mamory area buffer of void type;
-    int* var_conn = static_cast <int*>( buffer_void );
-    icount = 0;
+    std::vector < int > var_conn( counter );
+    unsigned icount = 0;
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
       for( unsigned j = 0; j < mesh->GetElementDofNumber( iel, index ); j++ ) {
         unsigned loc_vtk_conn = (mesh->GetElementType( iel ) == 0)? FemusToVTKorToXDMFConn[j] : j;
@@ -282,87 +336,29 @@ namespace femus {
         icount++;
       }
     }
-
-    //print connectivity dimension
-    cch = b64::b64_encode( &dim_array_conn[0], sizeof( dim_array_conn ), NULL, 0 );
-    b64::b64_encode( &dim_array_conn[0], sizeof( dim_array_conn ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    //print connectivity array
-    cch = b64::b64_encode( &var_conn[0], dim_array_conn[0] , NULL, 0 );
-    b64::b64_encode( &var_conn[0], dim_array_conn[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
-    fout << "        </DataArray>" << std::endl;
+    PrintDataArray( fout, Pfout, "Int32", "connectivity", 1, ( counter > 0 ) ? &var_conn[0] : NULL, counter * sizeof( int ) );
     //------------------------------------------------------------------------------------------------
 
     //-------------------------------------------------------------------------------------------------
     //printing offset
-    fout  << "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Int32\" Name=\"offsets\" format=\"binary\"/>" << std::endl;
-
-    // point pointer to common memory area buffer of void type;
-    int* var_off = static_cast <int*>( buffer_void );
-    icount = 0;
+    std::vector < int > var_off( nel );
     int offset_el = 0;
-    // print offset array
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
       offset_el += mesh->GetElementDofNumber( iel, index );
-      var_off[icount] = offset_el;
-      icount++;
+      var_off[iel - elemetOffset] = offset_el;
     }
-
-    //print offset dimension
-    cch = b64::b64_encode( &dim_array_off[0], sizeof( dim_array_off ), NULL, 0 );
-    b64::b64_encode( &dim_array_off[0], sizeof( dim_array_off ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    //print offset array
-    cch = b64::b64_encode( &var_off[0], dim_array_off[0] , NULL, 0 );
-    b64::b64_encode( &var_off[0], dim_array_off[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    fout  << std::endl;
-
-    fout  << "        </DataArray>" << std::endl;
-
+    PrintDataArray( fout, Pfout, "Int32", "offsets", 1, ( nel > 0 ) ? &var_off[0] : NULL, nel * sizeof( int ) );
     //--------------------------------------------------------------------------------------------------
 
     //--------------------------------------------------------------------------------------------------
-
     //Element format type : 23:Serendipity(8-nodes)  28:Quad9-Biquadratic
-    fout  << "        <DataArray type=\"UInt16\" Name=\"types\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"UInt16\" Name=\"types\" format=\"binary\"/>" << std::endl;
-
-    // point pointer to common mamory area buffer of void type;
-    unsigned short* var_type = static_cast <unsigned short*>( buffer_void );
-    icount = 0;
+    std::vector < unsigned short > var_type( nel );
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      short unsigned ielt = mesh->GetElementType( iel );
-      var_type[icount] = femusToVtkCellType[index][ielt];
-      icount++;
+      var_type[iel - elemetOffset] = femusToVtkCellType[index][mesh->GetElementType( iel )];
     }
-
-    //print element format dimension
-    cch = b64::b64_encode( &dim_array_type[0], sizeof( dim_array_type ), NULL, 0 );
-    b64::b64_encode( &dim_array_type[0], sizeof( dim_array_type ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    //print element format array
-    cch = b64::b64_encode( &var_type[0], dim_array_type[0] , NULL, 0 );
-    b64::b64_encode( &var_type[0], dim_array_type[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    fout  << std::endl;
-    fout  << "        </DataArray>" << std::endl;
+    PrintDataArray( fout, Pfout, "UInt16", "types", 1, ( nel > 0 ) ? &var_type[0] : NULL, nel * sizeof( unsigned short ) );
     //----------------------------------------------------------------------------------------------------
-//
+
     fout  << "      </Cells>" << std::endl;
     Pfout << "    </PCells>" << std::endl;
     //--------------------------------------------------------------------------------------------------
@@ -371,149 +367,38 @@ namespace femus {
     fout  << "      <CellData Scalars=\"scalars\">" << std::endl;
     Pfout << "    <PCellData Scalars=\"scalars\">" << std::endl;
 
-    unsigned short* var_reg = static_cast <unsigned short*>( buffer_void );
-
     // Print Metis Partitioning
-    fout  << "        <DataArray type=\"UInt16\" Name=\"Metis partition\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"UInt16\" Name=\"Metis partition\" format=\"binary\"/>" << std::endl;
-
-    // point pointer to common mamory area buffer of void type;
-    unsigned short* var_proc = static_cast <unsigned short*>( buffer_void );
-
-    icount = 0;
-    for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      var_proc[icount] = _iproc;
-      icount++;
-    }
-
-    //print regions dimension
-    cch = b64::b64_encode( &dim_array_reg[0], sizeof( dim_array_reg ), NULL, 0 );
-    b64::b64_encode( &dim_array_reg[0], sizeof( dim_array_reg ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-
-    //print regions array
-    cch = b64::b64_encode( &var_proc[0], dim_array_reg[0] , NULL, 0 );
-    b64::b64_encode( &var_proc[0], dim_array_reg[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-    fout  << std::endl;
-    fout  << "        </DataArray>" << std::endl;
-
+    std::vector < unsigned short > var_proc( nel, _iproc );
+    PrintDataArray( fout, Pfout, "UInt16", "Metis partition", 1, ( nel > 0 ) ? &var_proc[0] : NULL, nel * sizeof( unsigned short ) );
 
     //BEGIN SARA&GIACOMO
-
+    std::vector < double > var_el( nel );
 
     //-------------------------------------------MATERIAL---------------------------------------------------------
-
-    //NumericVector& material =  mesh->_topology->GetSolutionName( "Material" );
-
-    fout  << "        <DataArray type=\"Float32\" Name=\"" << "Material" << "\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Float32\" Name=\"" << "Material" << "\" format=\"binary\"/>" << std::endl;
-    // point pointer to common memory area buffer of void type;
-    float* var_el = static_cast< float*>( buffer_void );
-    icount = 0;
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      var_el[icount] = mesh->GetElementMaterial(iel); 
-      icount++;
+      var_el[iel - elemetOffset] = mesh->GetElementMaterial( iel );
     }
-
-    //print solution on element dimension
-    cch = b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), NULL, 0 );
-    b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    //print solution on element array
-    cch = b64::b64_encode( &var_el[0], dim_array_elvar[0] , NULL, 0 );
-    b64::b64_encode( &var_el[0], dim_array_elvar[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
-    fout << "        </DataArray>" << std::endl;
+    PrintDataArray( fout, Pfout, "Material", 1, var_el );
 
     //------------------------------------------------------GROUP-----------------------------------------------------------
-
-    //NumericVector& group =  mesh->_topology->GetSolutionName( "Group" );
-
-    fout  << "        <DataArray type=\"Float32\" Name=\"" << "Group" << "\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Float32\" Name=\"" << "Group" << "\" format=\"binary\"/>" << std::endl;
-    // point pointer to common memory area buffer of void type;
-    var_el = static_cast< float*>( buffer_void );
-    icount = 0;
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      var_el[icount] = mesh->GetElementGroup(iel);
-      icount++;
+      var_el[iel - elemetOffset] = mesh->GetElementGroup( iel );
     }
-    //print solution on element dimension
-    cch = b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), NULL, 0 );
-    b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    //print solution on element array
-    cch = b64::b64_encode( &var_el[0], dim_array_elvar[0] , NULL, 0 );
-    b64::b64_encode( &var_el[0], dim_array_elvar[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
-    fout << "        </DataArray>" << std::endl;
+    PrintDataArray( fout, Pfout, "Group", 1, var_el );
 
     //-------------------------------------------------------TYPE--------------------------------------------------
-   // NumericVector& type =  mesh->_topology->GetSolutionName( "Type" );
-
-    fout  << "        <DataArray type=\"Float32\" Name=\"" << "TYPE" << "\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Float32\" Name=\"" << "TYPE" << "\" format=\"binary\"/>" << std::endl;
-    // point pointer to common memory area buffer of void type;
-    var_el = static_cast< float*>( buffer_void );
-    icount = 0;
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      var_el[icount] = mesh->GetElementType(iel);
-      icount++;
+      var_el[iel - elemetOffset] = mesh->GetElementType( iel );
     }
-    //print solution on element dimension
-    cch = b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), NULL, 0 );
-    b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    //print solution on element array
-    cch = b64::b64_encode( &var_el[0], dim_array_elvar[0] , NULL, 0 );
-    b64::b64_encode( &var_el[0], dim_array_elvar[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
-    fout << "        </DataArray>" << std::endl;
-
-    
-    //-------------------------------------------------------TYPE--------------------------------------------------
-    fout  << "      <DataArray type=\"Float32\" Name=\"" << "Level" << "\" format=\"binary\">" << std::endl;
-    Pfout << "      <PDataArray type=\"Float32\" Name=\"" << "Level" << "\" format=\"binary\"/>" << std::endl;
-    // point pointer to common memory area buffer of void type;
-    var_el = static_cast< float*>( buffer_void );
-    icount = 0;
+    PrintDataArray( fout, Pfout, "TYPE", 1, var_el );
+
+    //-------------------------------------------------------LEVEL--------------------------------------------------
     for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-      var_el[icount] = mesh->el->GetElementLevel(iel);
-      icount++;
+      var_el[iel - elemetOffset] = mesh->el->GetElementLevel( iel );
     }
-    //print solution on element dimension
-    cch = b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), NULL, 0 );
-    b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    //print solution on element array
-    cch = b64::b64_encode( &var_el[0], dim_array_elvar[0] , NULL, 0 );
-    b64::b64_encode( &var_el[0], dim_array_elvar[0], &enc[0], cch );
-    pt_char = &enc[0];
-    for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-    fout << std::endl;
-    fout << "        </DataArray>" << std::endl;
-    
-    
-    //END SARA&GIACOMO
+    PrintDataArray( fout, Pfout, "Level", 1, var_el );
 
-    if( _ml_sol == NULL ) {
-      delete [] var_proc;
-    }
+    //END SARA&GIACOMO
 
     bool print_all = 0;
     for( unsigned ivar = 0; ivar < vars.size(); ivar++ ) {
@@ -523,49 +408,37 @@ namespace femus {
       //Print Solution (on element) ***************************************************************
       for( unsigned i = 0; i < ( !print_all )*vars.size() + print_all * _ml_sol->GetSolutionSize(); i++ ) {
         unsigned solIndex = ( print_all == 0 ) ? _ml_sol->GetIndex( vars[i].c_str() ) : i;
-        if( 3 <= _ml_sol->GetSolutionType( solIndex ) ) {
+        unsigned solType = _ml_sol->GetSolutionType( solIndex );
+        if( 3 <= solType ) {
 
           std::string solName =  _ml_sol->GetSolutionName( solIndex );
 
-          for( int name = 0; name < 1 + 3 * _debugOutput * solution->_ResEpsBdcFlag[i]; name++ ) {
+          for( int name = 0; name < 1 + 3 * _debugOutput * solution->_ResEpsBdcFlag[solIndex]; name++ ) {
             std::string printName;
+            NumericVector* printSol;
 
-            if( name == 0 ) printName = solName;
-            else if( name == 1 ) printName = "Bdc" + solName;
-            else if( name == 2 ) printName = "Res" + solName;
-            else printName = "Eps" + solName;
+            if( name == 0 ) {
+              printName = solName;
+              printSol = solution->_Sol[solIndex];
+            }
+            else if( name == 1 ) {
+              printName = "Bdc" + solName;
+              printSol = solution->_Bdc[solIndex];
+            }
+            else if( name == 2 ) {
+              printName = "Res" + solName;
+              printSol = solution->_Res[solIndex];
+            }
+            else {
+              printName = "Eps" + solName;
+              printSol = solution->_Eps[solIndex];
+            }
 
-            fout  << "        <DataArray type=\"Float32\" Name=\"" << printName << "\" format=\"binary\">" << std::endl;
-            Pfout << "      <PDataArray type=\"Float32\" Name=\"" << printName << "\" format=\"binary\"/>" << std::endl;
-            // point pointer to common memory area buffer of void type;
-            float* var_el = static_cast< float*>( buffer_void );
-            icount = 0;
+            NumericVectorLocalView solView = printSol->GetLocalView();
             for( int iel = elemetOffset; iel < elemetOffsetp1; iel++ ) {
-              unsigned iel_Metis = mesh->GetSolutionDof( 0, iel, _ml_sol->GetSolutionType( i ) );
-              if( name == 0 )
-                var_el[icount] = ( *solution->_Sol[i] )( iel_Metis );
-              else if( name == 1 )
-                var_el[icount] = ( *solution->_Bdc[i] )( iel_Metis );
-              else if( name == 2 )
-                var_el[icount] = ( *solution->_Res[i] )( iel_Metis );
-              else
-                var_el[icount] = ( *solution->_Eps[i] )( iel_Metis );
-              icount++;
+              var_el[iel - elemetOffset] = solView( mesh->GetSolutionDof( 0, iel, solType ) );
             }
-
-            //print solution on element dimension
-            cch = b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), NULL, 0 );
-            b64::b64_encode( &dim_array_elvar[0], sizeof( dim_array_elvar ), &enc[0], cch );
-            pt_char = &enc[0];
-            for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-            //print solution on element array
-            cch = b64::b64_encode( &var_el[0], dim_array_elvar[0] , NULL, 0 );
-            b64::b64_encode( &var_el[0], dim_array_elvar[0], &enc[0], cch );
-            pt_char = &enc[0];
-            for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-            fout << std::endl;
-            fout << "        </DataArray>" << std::endl;
+            PrintDataArray( fout, Pfout, printName, 1, var_el );
           }
         }
       } //end _ml_sol != NULL
@@ -582,75 +455,60 @@ namespace femus {
       Pfout << "    <PPointData Scalars=\"scalars\"> " << std::endl;
       //Loop on variables
 
-      // point pointer to common memory area buffer of void type;
-      float* var_nd = static_cast<float*>( buffer_void );
+      std::vector < double > var_nd( nvt );
       for( unsigned i = 0; i < ( !print_all )*vars.size() + print_all * _ml_sol->GetSolutionSize(); i++ ) {
         unsigned solIndex = ( print_all == 0 ) ? _ml_sol->GetIndex( vars[i].c_str() ) : i;
-        if( _ml_sol->GetSolutionType( solIndex ) < 3 ) {
+        unsigned solType = _ml_sol->GetSolutionType( solIndex );
+        if( solType < 3 ) {
           //BEGIN LAGRANGIAN Fem SOLUTION
           std::string solName =  _ml_sol->GetSolutionName( solIndex );
 
-          for( int name = 0; name < 1 + 3 * _debugOutput * solution->_ResEpsBdcFlag[i]; name++ ) {
+          for( int name = 0; name < 1 + 3 * _debugOutput * solution->_ResEpsBdcFlag[solIndex]; name++ ) {
             std::string printName;
+            NumericVector* printSol;
 
-            if( name == 0 ) printName = solName;
-            else if( name == 1 ) printName = "Bdc" + solName;
-            else if( name == 2 ) printName = "Res" + solName;
-            else printName = "Eps" + solName;
-
-            fout  << "        <DataArray type=\"Float32\" Name=\"" << printName << "\" format=\"binary\">" << std::endl;
-            Pfout << "      <PDataArray type=\"Float32\" Name=\"" << printName << "\" format=\"binary\"/>" << std::endl;
-
-            //print solutions on nodes dimension
-            cch = b64::b64_encode( &dim_array_ndvar[0], sizeof( dim_array_ndvar ), NULL, 0 );
-            b64::b64_encode( &dim_array_ndvar[0], sizeof( dim_array_ndvar ), &enc[0], cch );
-            pt_char = &enc[0];
-            for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-
-            unsigned offset_iprc = mesh->_dofOffset[index][_iproc];
-            unsigned nvt_ig = mesh->_ownSize[index][_iproc];
-
-            if( name == 0 )
-              mysol->matrix_mult( *solution->_Sol[solIndex],
-                                  *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( solIndex ) ) );
-            else if( name == 1 )
-              mysol->matrix_mult( *solution->_Bdc[solIndex],
-                                  *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( solIndex ) ) );
-            else if( name == 2 )
-              mysol->matrix_mult( *solution->_Res[solIndex],
-                                  *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( solIndex ) ) );
-            else
-              mysol->matrix_mult( *solution->_Eps[solIndex],
-                                  *mesh->GetQitoQjProjection( index, _ml_sol->GetSolutionType( solIndex ) ) );
-
-            for( unsigned ii = 0; ii < nvt_ig; ii++ ) {
-              var_nd[ ii ] = ( *mysol )( ii + offset_iprc );
+            if( name == 0 ) {
+              printName = solName;
+              printSol = solution->_Sol[solIndex];
+            }
+            else if( name == 1 ) {
+              printName = "Bdc" + solName;
+              printSol = solution->_Bdc[solIndex];
+            }
+            else if( name == 2 ) {
+              printName = "Res" + solName;
+              printSol = solution->_Res[solIndex];
+            }
+            else {
+              printName = "Eps" + solName;
+              printSol = solution->_Eps[solIndex];
             }
-            unsigned offset_ig = nvtOwned;
 
+            NumericVectorLocalView solView = ProjectSolution( mysol, printSol, mesh, index, solType ).GetLocalView();
+            for( unsigned ii = 0; ii < nvtOwned; ii++ ) {
+              var_nd[ ii ] = solView( ii + dofOffset );
+            }
             for( std::map <unsigned, unsigned>::iterator it = ghostMap.begin(); it != ghostMap.end(); ++it ) {
-              var_nd[ offset_ig + it->second ] = ( *mysol )( it->first );
+              var_nd[ nvtOwned + it->second ] = solView( it->first );
             }
-
-            cch = b64::b64_encode( &var_nd[0], dim_array_ndvar [0], NULL, 0 );
-            b64::b64_encode( &var_nd[0], dim_array_ndvar [0], &enc[0], cch );
-            pt_char = &enc[0];
-            for( unsigned i = 0; i < cch; i++, pt_char++ ) fout << *pt_char;
-            fout << std::endl;
-
-            fout  << "        </DataArray>" << std::endl;
+            PrintDataArray( fout, Pfout, printName, 1, var_nd );
           }
         } //endif
       } // end for sol
       fout  << "      </PointData>" << std::endl;
       Pfout << "    </PPointData>" << std::endl;
-      delete [] var_nd;
     }  //end _ml_sol != NULL
 
     //------------------------------------------------------------------------------------------------
 
     fout << "    </Piece>" << std::endl;
     fout << "  </UnstructuredGrid>" << std::endl;
+    if( _encoding != VTK_BASE64 ) {
+      // all the arrays in one block write
+      fout << "  <AppendedData encoding=\"raw\">" << std::endl << "   _";
+      if( _appendedData.size() > 0 ) fout.write( &_appendedData[0], _appendedData.size() );
+      fout << std::endl << "  </AppendedData>" << std::endl;
+    }
     fout << "</VTKFile>" << std::endl;
     fout.close();
 
@@ -663,6 +521,8 @@ namespace femus {
     //free memory
     delete mysol;
 
+    if( _profiler ) _profiler->Stop( "VTK output" );
+
     //--------------------------------------------------------------------------------------------------------
     return;
   }
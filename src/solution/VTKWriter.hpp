@@ -20,6 +20,9 @@
 // includes :
 //----------------------------------------------------------------------------
 #include "Writer.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
 
 
 namespace femus {
@@ -30,6 +33,8 @@ namespace femus {
 // Forward declarations
 //------------------------------------------------------------------------------
 class MultiLevelProblem;
+class Mesh;
+class NumericVector;
 
 
 class VTKWriter : public Writer {
@@ -51,9 +56,39 @@ public:
     /** Set if to print or not to prind the debugging variables */
     void SetDebugOutput( bool value ){ _debugOutput = value;}
 
+    /** Set the encoding of the vtu data arrays: inline base64 (default), appended raw binary or appended zlib compressed */
+    void SetVtkEncoding( const VTKEncodingEnum &encoding );
+
+    /** Set if to print the coordinates and the variables as Float64 instead of Float32 */
+    void SetDoublePrecision( const bool &value ){ _doublePrecision = value;}
+
   private:
 
+    /** Print a DataArray to the vtu file, inline or in the appended section, and its PDataArray to the pvtu file */
+    void PrintDataArray( std::ofstream &fout, std::ofstream &Pfout, const char type[], const std::string &name,
+                         const unsigned &nComponents, const void* data, const unsigned &nBytes );
+
+    /** Print a real DataArray, in Float32 or Float64 */
+    void PrintDataArray( std::ofstream &fout, std::ofstream &Pfout, const std::string &name,
+                         const unsigned &nComponents, const std::vector < double > &data );
+
+    /** @returns sol itself if it is already of type index, otherwise its projection stored in mysol */
+    const NumericVector& ProjectSolution( NumericVector* mysol, NumericVector* sol, Mesh* mesh,
+                                          const unsigned &index, const unsigned &solType );
+
     bool _debugOutput;
+    bool _doublePrecision;
+    VTKEncodingEnum _encoding;
+
+    /** Projected coordinates of the last printed mesh for each order. As for the geometric cache of the Mesh,
+     * the _topology coordinates are assumed not to change, the moving mesh displacement is added at every print */
+    const Mesh* _coordinateMesh[3];
+    std::vector < double > _coordinateCache[3];
+
+    /** Work buffers, kept between the calls */
+    std::vector < char > _appendedData;
+    std::vector < char > _encodeBuffer;
+    std::vector < float > _floatBuffer;
 
     /** femus to vtk cell type map */
     static short unsigned int femusToVtkCellType[3][6];
@@ -43,6 +43,7 @@ namespace femus {
     _moving_mesh = 0;
     _graph = false;
     _surface = false;
+    _profiler = NULL;
   }
 
   Writer::Writer( MultiLevelMesh* ml_mesh ):
@@ -52,6 +53,7 @@ namespace femus {
     _moving_mesh = 0;
     _graph = false;
     _surface = false;
+    _profiler = NULL;
   }
 
   Writer::~Writer() { }
@@ -24,6 +24,7 @@
 #include <memory>
 #include "ParallelObject.hpp"
 #include "WriterEnum.hpp"
+#include "VTKEncodingEnum.hpp"
 
 namespace femus {
 
@@ -34,6 +35,7 @@ namespace femus {
   class MultiLevelSolution;
   class SparseMatrix;
   class Vector;
+  class Profiler;
 
 
   class Writer : public ParallelObject {
@@ -64,12 +66,23 @@ namespace femus {
       std::cout<<"Warning this writer type does not have debug printing"<<std::endl;
     };
 
+    virtual void SetVtkEncoding( const VTKEncodingEnum &encoding ){
+      std::cout<<"Warning this writer type does not have VTK encodings"<<std::endl;
+    };
+
+    virtual void SetDoublePrecision( const bool &value ){
+      std::cout<<"Warning this writer type does not have double precision printing"<<std::endl;
+    };
+
     void SetGraphVariable(const std::string &GraphVaraible);
     void UnsetGraphVariable(){ _graph = false;};
 
     void SetSurfaceVariables( std::vector < std::string > &surfaceVariable );
     void UnsetSurfaceVariables(){ _surface = false;};
 
+    /** Time every Write as an output phase of profiler, e.g. the one of the solved system */
+    void SetProfiler( Profiler *profiler ){ _profiler = profiler; };
+
   protected:
 
     /** a flag to move the output mesh */
@@ -93,6 +106,9 @@ namespace femus {
 
     int _gridn;
 
+    /** output timers, NULL if not set */
+    Profiler* _profiler;
+
     /** map from femus connectivity to vtk-connectivity for paraview visualization */
     static const unsigned FemusToVTKorToXDMFConn[27];
 
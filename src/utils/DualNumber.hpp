@@ -0,0 +1,348 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: DualNumber
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_utils_DualNumber_hpp__
+#define __femus_utils_DualNumber_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include <cmath>
+#include <vector>
+
+namespace femus {
+
+/**
+ * Vector forward-mode automatic differentiation: a value with its derivatives along N directions.
+ * All the derivatives are stored in the object, no tape is involved, so it can be used concurrently by
+ * several threads and the loops over the N directions vectorize. Like adept::adouble, it can be
+ * used as the type of the templated element routines and value() returns the underlying double.
+ */
+
+template < unsigned N >
+class DualNumber {
+
+public:
+
+  DualNumber() : _value(0.) {
+    for(unsigned j = 0; j < N; j++) _derivative[j] = 0.;
+  }
+
+  DualNumber(const double &value) : _value(value) {
+    for(unsigned j = 0; j < N; j++) _derivative[j] = 0.;
+  }
+
+  double value() const {
+    return _value;
+  }
+
+  double derivative(const unsigned &j) const {
+    return _derivative[j];
+  }
+
+  void SetDerivative(const unsigned &j, const double &value) {
+    _derivative[j] = value;
+  }
+
+  DualNumber &operator=(const double &value) {
+    _value = value;
+    for(unsigned j = 0; j < N; j++) _derivative[j] = 0.;
+    return *this;
+  }
+
+  DualNumber &operator+=(const DualNumber &b) {
+    _value += b._value;
+    for(unsigned j = 0; j < N; j++) _derivative[j] += b._derivative[j];
+    return *this;
+  }
+
+  DualNumber &operator-=(const DualNumber &b) {
+    _value -= b._value;
+    for(unsigned j = 0; j < N; j++) _derivative[j] -= b._derivative[j];
+    return *this;
+  }
+
+  DualNumber &operator*=(const DualNumber &b) {
+    for(unsigned j = 0; j < N; j++) _derivative[j] = _derivative[j] * b._value + _value * b._derivative[j];
+    _value *= b._value;
+    return *this;
+  }
+
+  DualNumber &operator/=(const DualNumber &b) {
+    _value /= b._value;
+    double inv = 1. / b._value;
+    for(unsigned j = 0; j < N; j++) _derivative[j] = (_derivative[j] - _value * b._derivative[j]) * inv;
+    return *this;
+  }
+
+  DualNumber &operator+=(const double &b) {
+    _value += b;
+    return *this;
+  }
+
+  DualNumber &operator-=(const double &b) {
+    _value -= b;
+    return *this;
+  }
+
+  DualNumber &operator*=(const double &b) {
+    _value *= b;
+    for(unsigned j = 0; j < N; j++) _derivative[j] *= b;
+    return *this;
+  }
+
+  DualNumber &operator/=(const double &b) {
+    return *this *= 1. / b;
+  }
+
+  /** Returns f(this) given f = value and f' = slope at the value of this */
+  DualNumber Compose(const double &value, const double &slope) const {
+    DualNumber c(value);
+    for(unsigned j = 0; j < N; j++) c._derivative[j] = slope * _derivative[j];
+    return c;
+  }
+
+  // ============== arithmetic ==========================
+
+  friend DualNumber operator+(const DualNumber &a) {
+    return a;
+  }
+
+  friend DualNumber operator-(const DualNumber &a) {
+    return a.Compose(-a._value, -1.);
+  }
+
+  friend DualNumber operator+(DualNumber a, const DualNumber &b) {
+    return a += b;
+  }
+
+  friend DualNumber operator+(DualNumber a, const double &b) {
+    return a += b;
+  }
+
+  friend DualNumber operator+(const double &a, DualNumber b) {
+    return b += a;
+  }
+
+  friend DualNumber operator-(DualNumber a, const DualNumber &b) {
+    return a -= b;
+  }
+
+  friend DualNumber operator-(DualNumber a, const double &b) {
+    return a -= b;
+  }
+
+  friend DualNumber operator-(const double &a, const DualNumber &b) {
+    return (-b) += a;
+  }
+
+  friend DualNumber operator*(DualNumber a, const DualNumber &b) {
+    return a *= b;
+  }
+
+  friend DualNumber operator*(DualNumber a, const double &b) {
+    return a *= b;
+  }
+
+  friend DualNumber operator*(const double &a, DualNumber b) {
+    return b *= a;
+  }
+
+  friend DualNumber operator/(DualNumber a, const DualNumber &b) {
+    return a /= b;
+  }
+
+  friend DualNumber operator/(DualNumber a, const double &b) {
+    return a /= b;
+  }
+
+  friend DualNumber operator/(const double &a, const DualNumber &b) {
+    double value = a / b._value;
+    return b.Compose(value, -value / b._value);
+  }
+
+  // ============== comparisons, on the values ==========================
+
+  friend bool operator<(const DualNumber &a, const DualNumber &b) {
+    return a._value < b._value;
+  }
+
+  friend bool operator<(const DualNumber &a, const double &b) {
+    return a._value < b;
+  }
+
+  friend bool operator<(const double &a, const DualNumber &b) {
+    return a < b._value;
+  }
+
+  friend bool operator>(const DualNumber &a, const DualNumber &b) {
+    return a._value > b._value;
+  }
+
+  friend bool operator>(const DualNumber &a, const double &b) {
+    return a._value > b;
+  }
+
+  friend bool operator>(const double &a, const DualNumber &b) {
+    return a > b._value;
+  }
+
+  friend bool operator<=(const DualNumber &a, const DualNumber &b) {
+    return a._value <= b._value;
+  }
+
+  friend bool operator<=(const DualNumber &a, const double &b) {
+    return a._value <= b;
+  }
+
+  friend bool operator<=(const double &a, const DualNumber &b) {
+    return a <= b._value;
+  }
+
+  friend bool operator>=(const DualNumber &a, const DualNumber &b) {
+    return a._value >= b._value;
+  }
+
+  friend bool operator>=(const DualNumber &a, const double &b) {
+    return a._value >= b;
+  }
+
+  friend bool operator>=(const double &a, const DualNumber &b) {
+    return a >= b._value;
+  }
+
+  friend bool operator==(const DualNumber &a, const DualNumber &b) {
+    return a._value == b._value;
+  }
+
+  friend bool operator==(const DualNumber &a, const double &b) {
+    return a._value == b;
+  }
+
+  friend bool operator==(const double &a, const DualNumber &b) {
+    return a == b._value;
+  }
+
+  friend bool operator!=(const DualNumber &a, const DualNumber &b) {
+    return a._value != b._value;
+  }
+
+  friend bool operator!=(const DualNumber &a, const double &b) {
+    return a._value != b;
+  }
+
+  friend bool operator!=(const double &a, const DualNumber &b) {
+    return a != b._value;
+  }
+
+  // ============== elementary functions, found by argument dependent lookup ==========================
+
+  friend DualNumber sqrt(const DualNumber &a) {
+    double value = std::sqrt(a._value);
+    return a.Compose(value, 0.5 / value);
+  }
+
+  friend DualNumber exp(const DualNumber &a) {
+    double value = std::exp(a._value);
+    return a.Compose(value, value);
+  }
+
+  friend DualNumber log(const DualNumber &a) {
+    return a.Compose(std::log(a._value), 1. / a._value);
+  }
+
+  friend DualNumber pow(const DualNumber &a, const double &p) {
+    // at a = 0 the slope is infinite for p < 1, and 0 * inf for p = 0: the directions along which a does not move
+    // keep a zero derivative instead of becoming NaN
+    double slope = (p == 0.) ? 0. : p * std::pow(a._value, p - 1.);
+    DualNumber c(std::pow(a._value, p));
+    for(unsigned j = 0; j < N; j++) c._derivative[j] = (a._derivative[j] == 0.) ? 0. : slope * a._derivative[j];
+    return c;
+  }
+
+  friend DualNumber pow(const DualNumber &a, const DualNumber &p) {
+    return exp(p * log(a));
+  }
+
+  friend DualNumber fabs(const DualNumber &a) {
+    return (a._value < 0.) ? -a : a;
+  }
+
+  friend DualNumber sin(const DualNumber &a) {
+    return a.Compose(std::sin(a._value), std::cos(a._value));
+  }
+
+  friend DualNumber cos(const DualNumber &a) {
+    return a.Compose(std::cos(a._value), -std::sin(a._value));
+  }
+
+  friend DualNumber atan(const DualNumber &a) {
+    return a.Compose(std::atan(a._value), 1. / (1. + a._value * a._value));
+  }
+
+  friend DualNumber tanh(const DualNumber &a) {
+    double value = std::tanh(a._value);
+    return a.Compose(value, 1. - value * value);
+  }
+
+private:
+
+  double _value;
+  double _derivative[N];
+};
+
+/** Dual numbers accepted by the elem_type Jacobian and JacobianSur */
+typedef DualNumber < 8 > DualNumber8;
+
+// ============== element Jacobian ==========================
+
+/**
+ * Value res and row-major Jacobian jac[i * x.size() + j] = d res[i] / d x[j] of an element residual, evaluated
+ * with ceil(x.size() / N) forward sweeps of N directions each (one if x is empty). residual(xd, resd) has to
+ * compute resd from xd, both std::vector < DualNumber < N > >, e.g. a function object with a templated
+ * operator() shared with the double and adept::adouble assemblies. jac has the layout of adept
+ * s.jacobian(&jac[0], true).
+ */
+template < unsigned N, class Residual >
+void ForwardModeJacobian(Residual &residual, const std::vector < double > &x,
+                         std::vector < double > &res, std::vector < double > &jac) {
+
+  unsigned n = x.size();
+  std::vector < DualNumber < N > > xd(x.begin(), x.end());
+  std::vector < DualNumber < N > > resd;
+
+  for(unsigned j0 = 0; j0 == 0 || j0 < n; j0 += N) {
+    unsigned nj = (n - j0 < N) ? n - j0 : N;
+    for(unsigned j = 0; j < nj; j++) xd[j0 + j].SetDerivative(j, 1.);
+
+    residual(xd, resd);
+
+    unsigned m = resd.size();
+    if(j0 == 0) {
+      res.resize(m);
+      jac.assign(m * n, 0.);
+      for(unsigned i = 0; i < m; i++) res[i] = resd[i].value();
+    }
+    for(unsigned i = 0; i < m; i++) {
+      for(unsigned j = 0; j < nj; j++) jac[i * n + j0 + j] = resd[i].derivative(j);
+    }
+
+    for(unsigned j = 0; j < nj; j++) xd[j0 + j].SetDerivative(j, 0.);
+  }
+}
+
+} //end namespace femus
+
+#endif
@@ -17,11 +17,17 @@
 // includes :
 //----------------------------------------------------------------------------
 #include <iostream>
+#include <cstdlib>
 #include "FemusInit.hpp"
 
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
 namespace femus {
 
 adept::Stack FemusInit::_adeptStack;
+std::vector < adept::Stack* > FemusInit::_threadAdeptStacks;
 
 // =======================================================
 /// This function initializes the libraries if it is parallel
@@ -31,6 +37,30 @@ FemusInit::FemusInit(
     MPI_Comm comm_world_in // communicator for MPI direct
 ) {// ======================================================
 
+  _mpiThreadInitialized = false;
+
+#if defined(HAVE_OPENMP) && defined(HAVE_MPI)
+  // hybrid MPI+threads: only the master thread calls MPI/PETSc, worker threads assemble
+  int mpiInitialized;
+  MPI_Initialized(&mpiInitialized);
+  if(!mpiInitialized) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    _mpiThreadInitialized = true;
+    if(provided < MPI_THREAD_FUNNELED) {
+      std::cout << " FemusInit(): warning, the MPI library does not support MPI_THREAD_FUNNELED" << std::endl;
+    }
+  }
+#endif
+
+#ifdef HAVE_OPENMP
+  // every MPI process gets one thread unless OMP_NUM_THREADS or SetNumberOfThreads asks for more,
+  // so that mpirun with one process per core does not oversubscribe the cores
+  if(getenv("OMP_NUM_THREADS") == NULL) {
+    omp_set_num_threads(1);
+  }
+#endif
+
 #ifdef HAVE_PETSC
 
   int ierr = PetscInitialize (&argc, &argv, NULL, NULL);    CHKERRABORT(PETSC_COMM_WORLD,ierr);
@@ -50,7 +80,11 @@ FemusInit::FemusInit(
     }
 #endif
 
-   std::cout << " FemusInit(): PETSC_COMM_WORLD initialized" << std::endl << std::endl;
+   std::cout << " FemusInit(): PETSC_COMM_WORLD initialized" << std::endl;
+#ifdef HAVE_OPENMP
+   std::cout << " FemusInit(): " << GetNumberOfThreads() << " assembly threads per process" << std::endl;
+#endif
+   std::cout << std::endl;
 
     return;
 }
@@ -58,14 +92,54 @@ FemusInit::FemusInit(
 
 FemusInit::~FemusInit() {
 
+    for(unsigned i = 0; i < _threadAdeptStacks.size(); i++) {
+      delete _threadAdeptStacks[i];
+    }
+    _threadAdeptStacks.clear();
+
 #ifdef HAVE_PETSC
     PetscFinalize();
     std::cout << std::endl << " ~FemusInit(): PETSC_COMM_WORLD ends" << std::endl;
 #endif
 
+#ifdef HAVE_MPI
+    if(_mpiThreadInitialized) MPI_Finalize();
+#endif
+
     return;
 }
 
+// =======================================================
+adept::Stack & FemusInit::GetAdeptStack() {
+
+  if(adept::active_stack() == 0) {
+    // the constructor activates the new stack in the calling thread
+    adept::Stack* stack = new adept::Stack();
+#ifdef HAVE_OPENMP
+    #pragma omp critical (femus_init_adept_stack)
+#endif
+    _threadAdeptStacks.push_back(stack);
+  }
+
+  return *adept::active_stack();
+}
+
+// =======================================================
+void FemusInit::SetNumberOfThreads(const unsigned &numberOfThreads) {
+#ifdef HAVE_OPENMP
+  omp_set_num_threads(numberOfThreads);
+#endif
+}
+
+// =======================================================
+unsigned FemusInit::GetNumberOfThreads() {
+#ifdef HAVE_OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
 
 } //end namespace femus
 
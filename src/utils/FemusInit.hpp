@@ -40,6 +40,7 @@
 // ========================================
 
 #include "adept.h"
+#include <vector>
 
 namespace femus {
 
@@ -56,6 +57,25 @@ public:
     ~FemusInit();
     
     static adept::Stack _adeptStack; 
+
+    /** Returns the adept stack active in the calling thread: the master thread gets _adeptStack,
+     * any other thread gets its own stack, created on the first call and released by the destructor */
+    static adept::Stack & GetAdeptStack();
+
+    /** Returns the number of threads used by threaded element assembly loops (1 without OpenMP) */
+    static unsigned GetNumberOfThreads();
+
+    /** Sets the number of threads of each process for the threaded element assembly loops. It is 1 by default,
+     * or OMP_NUM_THREADS if set, and it is ignored without OpenMP */
+    static void SetNumberOfThreads(const unsigned &numberOfThreads);
+
+private:
+
+    /** Adept stacks created for worker threads */
+    static std::vector < adept::Stack* > _threadAdeptStacks;
+
+    /** true if MPI has been initialized by this class with thread support */
+    bool _mpiThreadInitialized;
      
 };
 
@@ -0,0 +1,228 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: Profiler
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "Profiler.hpp"
+
+#ifdef HAVE_PETSC
+#include <petsclog.h>
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace femus {
+
+  namespace {
+
+#ifdef HAVE_PETSC
+    /** PETSc log stage of each phase name, shared by all the profilers */
+    PetscLogStage GetLogStage(const std::string &phase) {
+      static std::map < std::string, PetscLogStage > stages;
+      std::map < std::string, PetscLogStage >::iterator it = stages.find(phase);
+      if(it == stages.end()) {
+        PetscLogStage stage;
+        PetscLogStageRegister(phase.c_str(), &stage);
+        it = stages.insert(std::make_pair(phase, stage)).first;
+      }
+      return it->second;
+    }
+#endif
+
+  }
+
+  // ==============================================
+  Profiler::Profiler() {
+  }
+
+  // ==============================================
+  void Profiler::Start(const std::string &phase) {
+    std::map < std::string, Phase >::iterator it = _phases.find(phase);
+    if(it == _phases.end()) {
+      Phase newPhase;
+      newPhase.time = 0.;
+      newPhase.calls = 0;
+      it = _phases.insert(std::make_pair(phase, newPhase)).first;
+      _order.push_back(phase);
+    }
+#ifdef HAVE_PETSC
+    PetscLogStagePush(GetLogStage(phase));
+#endif
+    it->second.start = MPI_Wtime();
+  }
+
+  // ==============================================
+  double Profiler::Stop(const std::string &phase) {
+    double stop = MPI_Wtime();
+    std::map < std::string, Phase >::iterator it = _phases.find(phase);
+    if(it == _phases.end()) {
+      std::cout << "Error! Profiler phase " << phase << " has not been started" << std::endl;
+      abort();
+    }
+#ifdef HAVE_PETSC
+    PetscLogStagePop();
+#endif
+    double elapsed = stop - it->second.start;
+    it->second.time += elapsed;
+    it->second.calls++;
+    return elapsed;
+  }
+
+  // ==============================================
+  double Profiler::GetTime(const std::string &phase) const {
+    std::map < std::string, Phase >::const_iterator it = _phases.find(phase);
+    return (it != _phases.end()) ? it->second.time : 0.;
+  }
+
+  // ==============================================
+  unsigned Profiler::GetNumberOfCalls(const std::string &phase) const {
+    std::map < std::string, Phase >::const_iterator it = _phases.find(phase);
+    return (it != _phases.end()) ? it->second.calls : 0u;
+  }
+
+  // ==============================================
+  void Profiler::Clear() {
+    _phases.clear();
+    _order.clear();
+  }
+
+  // ==============================================
+  void Profiler::Reduce(std::vector < std::string > &names, std::vector < unsigned > &calls,
+                        std::vector < double > &minTime, std::vector < double > &maxTime, std::vector < double > &avgTime) const {
+
+    int iproc, nprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+    // the phases of process 0 are sent to all the others as a single newline separated string
+    std::string buffer;
+    if(iproc == 0) {
+      for(unsigned i = 0; i < _order.size(); i++) {
+        buffer += _order[i] + '\n';
+      }
+    }
+    int size = buffer.size();
+    MPI_Bcast(&size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    buffer.resize(size);
+    if(size > 0) MPI_Bcast(&buffer[0], size, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    names.resize(0);
+    for(size_t begin = 0, end = buffer.find('\n'); end != std::string::npos; begin = end + 1, end = buffer.find('\n', begin)) {
+      names.push_back(buffer.substr(begin, end - begin));
+    }
+
+    unsigned n = names.size();
+    std::vector < double > time(n);
+    calls.resize(n);
+    for(unsigned i = 0; i < n; i++) {
+      time[i] = GetTime(names[i]);
+      calls[i] = GetNumberOfCalls(names[i]);
+    }
+
+    minTime.resize(n);
+    maxTime.resize(n);
+    avgTime.resize(n);
+    if(n > 0) {
+      MPI_Allreduce(&time[0], &minTime[0], n, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+      MPI_Allreduce(&time[0], &maxTime[0], n, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(&time[0], &avgTime[0], n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    for(unsigned i = 0; i < n; i++) {
+      avgTime[i] /= nprocs;
+    }
+  }
+
+  // ==============================================
+  void Profiler::PrintSummary() const {
+
+    std::vector < std::string > names;
+    std::vector < unsigned > calls;
+    std::vector < double > minTime, maxTime, avgTime;
+    Reduce(names, calls, minTime, maxTime, avgTime);
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    if(iproc != 0) return;
+
+    std::cout << std::endl << std::left << std::setw(32) << " Phase" << std::right << std::setw(8) << "calls"
+              << std::setw(14) << "min (s)" << std::setw(14) << "max (s)" << std::setw(14) << "avg (s)" << std::endl;
+    for(unsigned i = 0; i < names.size(); i++) {
+      std::cout << " " << std::left << std::setw(31) << names[i] << std::right << std::setw(8) << calls[i]
+                << std::scientific << std::setprecision(4)
+                << std::setw(14) << minTime[i] << std::setw(14) << maxTime[i] << std::setw(14) << avgTime[i] << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+  }
+
+  // ==============================================
+  void Profiler::WriteJson(const std::string &filename) const {
+
+    std::vector < std::string > names;
+    std::vector < unsigned > calls;
+    std::vector < double > minTime, maxTime, avgTime;
+    Reduce(names, calls, minTime, maxTime, avgTime);
+
+    int iproc, nprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    if(iproc != 0) return;
+
+    std::ofstream fout(filename.c_str());
+    if(!fout.is_open()) {
+      std::cout << "Error! Cannot open the profiling file " << filename << std::endl;
+      return;
+    }
+
+    fout << std::scientific << std::setprecision(6);
+    fout << "{\n  \"nprocs\": " << nprocs << ",\n  \"phases\": [";
+    for(unsigned i = 0; i < names.size(); i++) {
+      fout << ((i == 0) ? "\n" : ",\n") << "    { \"name\": \"" << names[i] << "\", \"calls\": " << calls[i]
+           << ", \"min\": " << minTime[i] << ", \"max\": " << maxTime[i] << ", \"avg\": " << avgTime[i] << " }";
+    }
+    fout << "\n  ]\n}\n";
+    fout.close();
+  }
+
+  // ==============================================
+  void Profiler::WriteCsv(const std::string &filename) const {
+
+    std::vector < std::string > names;
+    std::vector < unsigned > calls;
+    std::vector < double > minTime, maxTime, avgTime;
+    Reduce(names, calls, minTime, maxTime, avgTime);
+
+    int iproc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &iproc);
+    if(iproc != 0) return;
+
+    std::ofstream fout(filename.c_str());
+    if(!fout.is_open()) {
+      std::cout << "Error! Cannot open the profiling file " << filename << std::endl;
+      return;
+    }
+
+    fout << std::scientific << std::setprecision(6);
+    fout << "phase,calls,min,max,avg\n";
+    for(unsigned i = 0; i < names.size(); i++) {
+      fout << names[i] << "," << calls[i] << "," << minTime[i] << "," << maxTime[i] << "," << avgTime[i] << "\n";
+    }
+    fout.close();
+  }
+
+} //end namespace femus
@@ -0,0 +1,108 @@
+/*=========================================================================
+
+ Program: FEMUS
+ Module: Profiler
+ Authors: Eugenio Aulisa, Giorgio Bornia
+
+ Copyright (c) FEMTTU
+ All rights reserved.
+
+ This software is distributed WITHOUT ANY WARRANTY; without even
+ the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#ifndef __femus_utils_Profiler_hpp__
+#define __femus_utils_Profiler_hpp__
+
+//----------------------------------------------------------------------------
+// includes :
+//----------------------------------------------------------------------------
+#include "FemusConfig.hpp"
+
+#include <mpi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace femus {
+
+/**
+ * Wall-clock timers of named solver phases. Every phase accumulates its time and its number of calls;
+ * with PETSc the phase is also pushed as a log stage, so -log_view reports the same breakdown.
+ * Phases have to be started and stopped in nested order.
+ */
+
+class Profiler {
+
+public:
+
+  /** Constructor */
+  Profiler();
+
+  /** Start the wall-clock timer of phase */
+  void Start(const std::string &phase);
+
+  /** Stop the timer of phase and return the time of this call */
+  double Stop(const std::string &phase);
+
+  /** Accumulated time of phase on this process */
+  double GetTime(const std::string &phase) const;
+
+  /** Number of calls of phase on this process */
+  unsigned GetNumberOfCalls(const std::string &phase) const;
+
+  /** Remove all the phases */
+  void Clear();
+
+  /** Print min, max and average time over the processes of every phase, on process 0 (collective) */
+  void PrintSummary() const;
+
+  /** Write the min, max and average times of every phase as a json file, on process 0 (collective) */
+  void WriteJson(const std::string &filename) const;
+
+  /** Write the min, max and average times of every phase as a csv file, on process 0 (collective) */
+  void WriteCsv(const std::string &filename) const;
+
+private:
+
+  struct Phase {
+    double time;
+    double start;
+    unsigned calls;
+  };
+
+  /** Reduce the times of the phases of process 0, in their starting order, over all the processes */
+  void Reduce(std::vector < std::string > &names, std::vector < unsigned > &calls,
+              std::vector < double > &minTime, std::vector < double > &maxTime, std::vector < double > &avgTime) const;
+
+  std::map < std::string, Phase > _phases;
+  std::vector < std::string > _order;
+};
+
+/**
+ * Times a phase of a Profiler for the lifetime of the object.
+ */
+
+class ScopedTimer {
+
+public:
+
+  ScopedTimer(Profiler &profiler, const std::string &phase) : _profiler(profiler), _phase(phase) {
+    _profiler.Start(_phase);
+  }
+
+  ~ScopedTimer() {
+    _profiler.Stop(_phase);
+  }
+
+private:
+
+  Profiler &_profiler;
+  std::string _phase;
+};
+
+} //end namespace femus
+
+#endif
@@ -0,0 +1,180 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "FemusInit.hpp"
+#include "MultiLevelMesh.hpp"
+#include "Mesh.hpp"
+#include "ElemType.hpp"
+#include "NumericVector.hpp"
+#include "DualNumber.hpp"
+
+using namespace femus;
+
+// Test for ForwardModeJacobian: on the biquadratic quadrilaterals of a distorted mesh the Jacobian of a
+// nonlinear Navier-Stokes-like velocity residual has to match the one of adept s.jacobian
+
+
+/** Element residual of the velocity u = (u, v) with the viscosity (1 + |u|^2)^(1/4), shared by the
+ * double, adept::adouble and DualNumber evaluations */
+class ElementResidual {
+
+public:
+
+  ElementResidual(const elem_type* fe, const std::vector < std::vector < double > > &x) : _fe(fe), _x(x) {}
+
+  template < class Type >
+  void operator()(const std::vector < Type > &solV, std::vector < Type > &resV) {
+
+    const unsigned dim = 2;
+    unsigned nDofs = _fe->GetNDofs();
+
+    resV.assign(dim * nDofs, Type(0.));
+
+    std::vector < double > phi;
+    std::vector < double > phi_x;
+    std::vector < double > phi_xx;
+    double weight;
+
+    for(unsigned ig = 0; ig < _fe->GetGaussPointNumber(); ig++) {
+      _fe->Jacobian(_x, ig, weight, phi, phi_x, phi_xx);
+
+      std::vector < Type > solV_gss(dim, Type(0.));
+      std::vector < std::vector < Type > > gradSolV_gss(dim, std::vector < Type > (dim, Type(0.)));
+      for(unsigned i = 0; i < nDofs; i++) {
+        for(unsigned k = 0; k < dim; k++) {
+          solV_gss[k] += phi[i] * solV[k * nDofs + i];
+          for(unsigned j = 0; j < dim; j++) {
+            gradSolV_gss[k][j] += phi_x[i * dim + j] * solV[k * nDofs + i];
+          }
+        }
+      }
+
+      Type speed2 = 1. + solV_gss[0] * solV_gss[0] + solV_gss[1] * solV_gss[1];
+      Type nu = pow(speed2, 0.25);
+
+      for(unsigned i = 0; i < nDofs; i++) {
+        for(unsigned k = 0; k < dim; k++) {
+          Type NSV = 0.;
+          for(unsigned j = 0; j < dim; j++) {
+            NSV += nu * phi_x[i * dim + j] * gradSolV_gss[k][j] + phi[i] * solV_gss[j] * gradSolV_gss[k][j];
+          }
+          resV[k * nDofs + i] -= NSV * weight;
+        }
+      }
+    }
+  }
+
+private:
+
+  const elem_type* _fe;
+  const std::vector < std::vector < double > > &_x;
+};
+
+
+/** Returns true if pow(DualNumber, double) has the expected value and derivatives at x, moving only along direction 0 */
+bool CheckPow(const double &x, const double &p, const double &value, const double &derivative) {
+  DualNumber < 8 > a(x);
+  a.SetDerivative(0, 1.);
+  DualNumber < 8 > b = pow(a, p);
+
+  bool pass = (b.value() == value && b.derivative(0) == derivative);
+  for(unsigned j = 1; j < 8; j++) {
+    pass = pass && (b.derivative(j) == 0.);
+  }
+  if(!pass) {
+    std::cout << "pow(" << x << ", " << p << ") = " << b.value() << " with derivative " << b.derivative(0)
+              << ", expected " << value << " with derivative " << derivative << std::endl;
+  }
+  return pass;
+}
+
+
+int main(int argc, char** args) {
+
+  FemusInit mpinit(argc, args, MPI_COMM_WORLD);
+
+  bool pass = true;
+
+  // pow at zero: no NaN, infinite slope only for p < 1 and only along the direction in which the base moves
+  pass = CheckPow(0., 0.5, 0., HUGE_VAL) && pass;
+  pass = CheckPow(0., 1.5, 0., 0.) && pass;
+  pass = CheckPow(0., 2., 0., 0.) && pass;
+  pass = CheckPow(0., 0., 1., 0.) && pass;
+  pass = CheckPow(4., 0.5, 2., 0.25) && pass;
+
+  MultiLevelMesh mlMsh;
+  mlMsh.ReadCoarseMesh("./input/square_quad.neu", "fifth", 1.);
+  mlMsh.RefineMesh(2, 2, NULL);
+
+  Mesh* msh = mlMsh.GetLevel(1);
+  unsigned iproc = msh->processor_id();
+
+  adept::Stack& s = FemusInit::_adeptStack;
+
+  const unsigned dim = 2;
+  const unsigned solType = 2;
+
+  std::vector < std::vector < double > > x(dim);
+  std::vector < double > solV;
+  std::vector < adept::adouble > aSolV;
+  std::vector < adept::adouble > aResV;
+  std::vector < double > jacAdept;
+  std::vector < double > resV;
+  std::vector < double > jacForward;
+
+  double maxError = 0.;
+  double maxJac = 0.;
+
+  for(int iel = msh->_elementOffset[iproc]; iel < msh->_elementOffset[iproc + 1]; iel++) {
+
+    short unsigned ielGeom = msh->GetElementType(iel);
+    unsigned nDofs = msh->GetElementDofNumber(iel, solType);
+
+    // distorted coordinates and a smooth velocity field
+    for(unsigned k = 0; k < dim; k++) x[k].resize(nDofs);
+    solV.resize(dim * nDofs);
+    for(unsigned i = 0; i < nDofs; i++) {
+      unsigned xDof = msh->GetSolutionDof(i, iel, 2);
+      double x0 = (*msh->_topology->_Sol[0])(xDof);
+      double x1 = (*msh->_topology->_Sol[1])(xDof);
+      x[0][i] = x0 + 0.05 * sin(3. * x1);
+      x[1][i] = x1 + 0.05 * sin(2. * x0);
+      solV[i] = cos(x0) * sin(2. * x1);
+      solV[nDofs + i] = x0 * x1 + 0.5;
+    }
+
+    ElementResidual residual(msh->_finiteElement[ielGeom][solType], x);
+
+    aSolV.assign(solV.begin(), solV.end());
+    s.new_recording();
+    residual(aSolV, aResV);
+    s.dependent(&aResV[0], aResV.size());
+    s.independent(&aSolV[0], aSolV.size());
+    jacAdept.resize(aResV.size() * aSolV.size());
+    s.jacobian(&jacAdept[0], true);
+    s.clear_independents();
+    s.clear_dependents();
+
+    ForwardModeJacobian < 8 > (residual, solV, resV, jacForward);
+
+    if(jacForward.size() != jacAdept.size()) {
+      std::cout << "Element " << iel << ": the Jacobian sizes differ" << std::endl;
+      exit(1);
+    }
+    for(unsigned i = 0; i < resV.size(); i++) {
+      maxError = std::max(maxError, fabs(resV[i] - aResV[i].value()));
+    }
+    for(unsigned ij = 0; ij < jacAdept.size(); ij++) {
+      maxError = std::max(maxError, fabs(jacForward[ij] - jacAdept[ij]));
+      maxJac = std::max(maxJac, fabs(jacAdept[ij]));
+    }
+  }
+
+  std::cout << "Forward-mode Jacobian max error: " << maxError << " over max entry " << maxJac << std::endl;
+
+  if(!pass || maxError > 1.e-12 * maxJac) {
+    exit(1);
+  }
+
+  return 0;
+}